@@ -0,0 +1,279 @@
+/*
+==============================================================================
+
+AlsaMidi.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "AlsaMidi.h"
+#ifdef __LINUX_ALSA__
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <gsl/gsl>
+#include <rtmidi/RtMidi.h>
+#include "Misc.h"
+
+namespace {
+   // every port we open belongs to a sequencer client with this name; RtMidi lists ports as
+   // "client:port client#:port#"
+   constexpr auto kClientName{"MIDI2LR"};
+   // a gap longer than this restarts the chain of kernel time stamps at the arrival time, so
+   // the queue clock and MidiClock can't drift apart over a long session
+   constexpr std::chrono::seconds kResync{1};
+
+   bool IsOwnPort(const std::string& port_name)
+   {
+      return port_name.rfind(std::string(kClientName) + ':', 0) == 0;
+   }
+
+   template<class T> juce::StringArray PortNames()
+   {
+      T probe{RtMidi::LINUX_ALSA, kClientName};
+      juce::StringArray names{};
+      for (unsigned i = 0, count = probe.getPortCount(); i < count; ++i)
+         if (const auto name = probe.getPortName(i); !IsOwnPort(name))
+            names.add(name);
+      return names;
+   }
+
+   // index into the filtered list to RtMidi's port number
+   template<class T> std::optional<unsigned> PortNumber(T& rt, int index)
+   {
+      for (unsigned i = 0, count = rt.getPortCount(); i < count; ++i)
+         if (!IsOwnPort(rt.getPortName(i)) && index-- == 0)
+            return i;
+      return std::nullopt;
+   }
+} // namespace
+
+rsj::AlsaMidiInput::AlsaMidiInput(juce::String name, juce::MidiInputCallback* callback)
+    : name_{std::move(name)}, callback_{callback},
+      in_{std::make_unique<RtMidiIn>(RtMidi::LINUX_ALSA, kClientName)}
+{
+}
+
+rsj::AlsaMidiInput::~AlsaMidiInput()
+{
+   try {
+      stop();
+      in_->closePort();
+   }
+   catch (const std::exception& e) {
+      rsj::LogAndAlertError(juce::String("Exception in AlsaMidiInput Destructor. ") + e.what());
+      std::terminate();
+   }
+}
+
+juce::StringArray rsj::AlsaMidiInput::getDevices()
+{
+   try {
+      return PortNames<RtMidiIn>();
+   }
+   catch (const RtMidiError& e) {
+      rsj::Log(juce::String("Unable to list ALSA input ports. ") + e.what());
+      return {};
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+rsj::AlsaMidiInput* rsj::AlsaMidiInput::openDevice(int index, juce::MidiInputCallback* callback)
+{
+   try {
+      std::unique_ptr<AlsaMidiInput> dev{new AlsaMidiInput({}, callback)};
+      const auto port = PortNumber(*dev->in_, index);
+      if (!port)
+         return nullptr;
+      dev->name_ = dev->in_->getPortName(*port);
+      dev->in_->openPort(*port, "MIDI2LR Input");
+      return dev.release();
+   }
+   catch (const RtMidiError& e) {
+      rsj::Log(juce::String("Unable to open ALSA input port. ") + e.what());
+      return nullptr;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+rsj::AlsaMidiInput* rsj::AlsaMidiInput::createNewDevice(
+    const juce::String& device_name, juce::MidiInputCallback* callback)
+{
+   try {
+      std::unique_ptr<AlsaMidiInput> dev{new AlsaMidiInput(device_name, callback)};
+      dev->in_->openVirtualPort(device_name.toStdString());
+      return dev.release();
+   }
+   catch (const RtMidiError& e) {
+      rsj::Log("Unable to create ALSA input port " + device_name + ". " + e.what());
+      return nullptr;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+void rsj::AlsaMidiInput::start()
+{
+   try {
+      last_time_ = {}; // callback thread isn't running yet
+      in_->setCallback(&AlsaMidiInput::Received, this);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::AlsaMidiInput::stop()
+{
+   try {
+      in_->cancelCallback();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+rsj::MidiTime rsj::AlsaMidiInput::MidiTimeOf(const juce::MidiMessage& message) noexcept
+{
+   return MidiTime{std::chrono::duration_cast<MidiClock::duration>(
+       std::chrono::duration<double>(message.getTimeStamp()))};
+}
+
+void rsj::AlsaMidiInput::Received(double delta, std::vector<unsigned char>* bytes, void* user)
+{
+   try {
+      // delta is the time since the previous event, taken from the kernel time stamps of the
+      // ALSA queue. Chained from the first event, which can only be stamped on arrival, they give
+      // each event's time without the callback thread's scheduling delay.
+      auto* const self = static_cast<AlsaMidiInput*>(user);
+      if (!bytes || bytes->empty())
+         return;
+      const auto now = MidiClock::now();
+      const auto elapsed = std::chrono::duration<double>(delta);
+      auto time = now;
+      if (self->last_time_ != MidiTime{} && elapsed < kResync)
+         time = std::min(
+             now, self->last_time_ + std::chrono::duration_cast<MidiClock::duration>(elapsed));
+      self->last_time_ = time;
+      const juce::MidiMessage message{bytes->data(), gsl::narrow_cast<int>(bytes->size()),
+          std::chrono::duration<double>(time.time_since_epoch()).count()};
+      self->callback_->handleIncomingMidiMessage(nullptr, message);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+rsj::AlsaMidiOutput::AlsaMidiOutput(juce::String name)
+    : name_{std::move(name)}, out_{std::make_unique<RtMidiOut>(RtMidi::LINUX_ALSA, kClientName)}
+{
+}
+
+rsj::AlsaMidiOutput::~AlsaMidiOutput()
+{
+   try {
+      out_->closePort();
+   }
+   catch (const std::exception& e) {
+      rsj::LogAndAlertError(juce::String("Exception in AlsaMidiOutput Destructor. ") + e.what());
+      std::terminate();
+   }
+}
+
+juce::StringArray rsj::AlsaMidiOutput::getDevices()
+{
+   try {
+      return PortNames<RtMidiOut>();
+   }
+   catch (const RtMidiError& e) {
+      rsj::Log(juce::String("Unable to list ALSA output ports. ") + e.what());
+      return {};
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+rsj::AlsaMidiOutput* rsj::AlsaMidiOutput::openDevice(int index)
+{
+   try {
+      std::unique_ptr<AlsaMidiOutput> dev{new AlsaMidiOutput({})};
+      const auto port = PortNumber(*dev->out_, index);
+      if (!port)
+         return nullptr;
+      dev->name_ = dev->out_->getPortName(*port);
+      dev->out_->openPort(*port, "MIDI2LR Output");
+      return dev.release();
+   }
+   catch (const RtMidiError& e) {
+      rsj::Log(juce::String("Unable to open ALSA output port. ") + e.what());
+      return nullptr;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+rsj::AlsaMidiOutput* rsj::AlsaMidiOutput::createNewDevice(const juce::String& device_name)
+{
+   try {
+      std::unique_ptr<AlsaMidiOutput> dev{new AlsaMidiOutput(device_name)};
+      dev->out_->openVirtualPort(device_name.toStdString());
+      return dev.release();
+   }
+   catch (const RtMidiError& e) {
+      rsj::Log("Unable to create ALSA output port " + device_name + ". " + e.what());
+      return nullptr;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+void rsj::AlsaMidiOutput::sendMessageNow(const juce::MidiMessage& message)
+{
+   try {
+      auto lock = std::scoped_lock(send_mutex_);
+      out_->sendMessage(message.getRawData(), gsl::narrow_cast<size_t>(message.getRawDataSize()));
+   }
+   catch (const RtMidiError& e) {
+      rsj::Log("Unable to send to ALSA output port " + name_ + ". " + e.what());
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+#endif // __LINUX_ALSA__
@@ -0,0 +1,98 @@
+#ifndef MIDI2LR_ALSAMIDI_H_INCLUDED
+#define MIDI2LR_ALSAMIDI_H_INCLUDED
+/*
+==============================================================================
+
+AlsaMidi.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+// MIDI devices on the ALSA sequencer through the vendored RtMidi. Built when __LINUX_ALSA__ is
+// defined, the same flag that turns on RtMidi's ALSA API, with rtmidi/RtMidi.cpp compiled in and
+// libasound linked. The classes have the same interface as juce::MidiInput and juce::MidiOutput
+// so MidiReceiver and MidiSender can use either. Our own ports are left out of the device lists,
+// so a virtual input is never connected to our own output.
+#ifdef __LINUX_ALSA__
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <JuceLibraryCode/JuceHeader.h>
+#include "MidiUtilities.h"
+
+class RtMidiIn;
+class RtMidiOut;
+
+namespace rsj {
+   class AlsaMidiInput {
+    public:
+      ~AlsaMidiInput();
+      AlsaMidiInput(const AlsaMidiInput& other) = delete;
+      AlsaMidiInput(AlsaMidiInput&& other) = delete;
+      AlsaMidiInput& operator=(const AlsaMidiInput& other) = delete;
+      AlsaMidiInput& operator=(AlsaMidiInput&& other) = delete;
+      [[nodiscard]] static juce::StringArray getDevices();
+      // nullptr if the port can't be opened. Caller owns the result, as with juce::MidiInput
+      [[nodiscard]] static AlsaMidiInput* openDevice(int index, juce::MidiInputCallback* callback);
+      // a port other programs can connect to
+      [[nodiscard]] static AlsaMidiInput* createNewDevice(
+          const juce::String& device_name, juce::MidiInputCallback* callback);
+      [[nodiscard]] const juce::String& getName() const noexcept
+      {
+         return name_;
+      }
+      void start();
+      void stop();
+      // messages are handed on with the ALSA queue's kernel time stamp of the event, as seconds
+      // on MidiClock, rather than the time the callback thread got to them
+      [[nodiscard]] static MidiTime MidiTimeOf(const juce::MidiMessage& message) noexcept;
+
+    private:
+      AlsaMidiInput(juce::String name, juce::MidiInputCallback* callback);
+      static void Received(double delta, std::vector<unsigned char>* bytes, void* user);
+      juce::String name_;
+      juce::MidiInputCallback* const callback_;
+      MidiTime last_time_{}; // RtMidi callback thread only once started
+      std::unique_ptr<RtMidiIn> in_;
+   };
+
+   class AlsaMidiOutput {
+    public:
+      ~AlsaMidiOutput();
+      AlsaMidiOutput(const AlsaMidiOutput& other) = delete;
+      AlsaMidiOutput(AlsaMidiOutput&& other) = delete;
+      AlsaMidiOutput& operator=(const AlsaMidiOutput& other) = delete;
+      AlsaMidiOutput& operator=(AlsaMidiOutput&& other) = delete;
+      [[nodiscard]] static juce::StringArray getDevices();
+      [[nodiscard]] static AlsaMidiOutput* openDevice(int index);
+      [[nodiscard]] static AlsaMidiOutput* createNewDevice(const juce::String& device_name);
+      [[nodiscard]] const juce::String& getName() const noexcept
+      {
+         return name_;
+      }
+      // may be called from several threads at once
+      void sendMessageNow(const juce::MidiMessage& message);
+
+    private:
+      explicit AlsaMidiOutput(juce::String name);
+      juce::String name_;
+      std::mutex send_mutex_{}; // RtMidi's ALSA encoder isn't thread safe
+      std::unique_ptr<RtMidiOut> out_;
+   };
+} // namespace rsj
+
+#endif // __LINUX_ALSA__
+#endif // MIDI2LR_ALSAMIDI_H_INCLUDED
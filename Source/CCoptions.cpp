@@ -128,7 +128,7 @@ CCoptions::CCoptions()
 
    addAndMakeVisible(applyAll = new TextButton("new button"));
    applyAll->setTooltip(TRANS("Apply these settings to all similar controls."));
-   applyAll->setExplicitFocusOrder(7);
+   applyAll->setExplicitFocusOrder(9);
    applyAll->setButtonText(TRANS("Apply to all"));
    applyAll->addListener(this);
 
@@ -139,16 +139,45 @@ CCoptions::CCoptions()
    controlID->setColour(TextEditor::textColourId, Colours::black);
    controlID->setColour(TextEditor::backgroundColourId, Colour(0x00000000));
 
+   addAndMakeVisible(hiresbutton = new ToggleButton("hires"));
+   hiresbutton->setTooltip(TRANS("Control sends a 14-bit value, its fine part on control number + "
+                                 "32. Only available for control numbers 0 to 31."));
+   hiresbutton->setExplicitFocusOrder(7);
+   hiresbutton->setButtonText(TRANS("14-bit (fine part on number + 32)"));
+   hiresbutton->addListener(this);
+
+   addAndMakeVisible(accelerationtext = new TextEditor("accelerationtext"));
+   accelerationtext->setTooltip(
+       TRANS("Largest step multiplier when the control is turned quickly. 1 turns acceleration "
+             "off, slow turns always move one step at a time."));
+   accelerationtext->setExplicitFocusOrder(8);
+   accelerationtext->setMultiLine(false);
+   accelerationtext->setReturnKeyStartsNewLine(false);
+   accelerationtext->setReadOnly(false);
+   accelerationtext->setScrollbarsShown(true);
+   accelerationtext->setCaretVisible(true);
+   accelerationtext->setPopupMenuEnabled(true);
+   accelerationtext->setText(TRANS("1"));
+
+   addAndMakeVisible(accelerationlabel = new Label("accelerationlabel", TRANS("Acceleration")));
+   accelerationlabel->setFont(Font(15.00f, Font::plain));
+   accelerationlabel->setJustificationType(Justification::centredLeft);
+   accelerationlabel->setEditable(false, false, false);
+   accelerationlabel->setColour(TextEditor::textColourId, Colours::black);
+   accelerationlabel->setColour(TextEditor::backgroundColourId, Colour(0x00000000));
+
    //[UserPreSize]
    //[/UserPreSize]
 
-   setSize(280, 350);
+   setSize(280, 440);
 
    //[Constructor] You can add your own custom stuff here..
    maxvaltext->setInputFilter(&numrestrict_, false);
    minvaltext->setInputFilter(&numrestrict_, false);
+   accelerationtext->setInputFilter(&numrestrict_, false);
    maxvaltext->addListener(this);
    minvaltext->addListener(this);
+   accelerationtext->addListener(this);
    //[/Constructor]
 }
 
@@ -168,6 +197,9 @@ CCoptions::~CCoptions()
    maxvallabel = nullptr;
    applyAll = nullptr;
    controlID = nullptr;
+   hiresbutton = nullptr;
+   accelerationtext = nullptr;
+   accelerationlabel = nullptr;
 
    //[Destructor]. You can add your own custom destruction code here..
    //[/Destructor]
@@ -201,6 +233,9 @@ void CCoptions::resized()
    maxvallabel->setBounds(16, 268, 150, 24);
    applyAll->setBounds((getWidth() / 2) - (150 / 2), (getHeight() / 2) + 141, 150, 24);
    controlID->setBounds((getWidth() / 2) - (248 / 2), 16, 248, 24);
+   hiresbutton->setBounds(16, 300, 240, 24);
+   accelerationtext->setBounds(200, 332, 56, 24);
+   accelerationlabel->setBounds(16, 332, 150, 24);
    //[UserResized] Add your own custom resize handling here..
    //[/UserResized]
 }
@@ -216,6 +251,8 @@ void CCoptions::buttonClicked(Button* button_that_was_clicked)
       minvallabel->setVisible(false);
       maxvallabel->setText(TRANS("Resolution"), juce::dontSendNotification);
       minvaltext->setText("0", juce::dontSendNotification);
+      accelerationtext->setVisible(true);
+      accelerationlabel->setVisible(true);
       controls_model_->SetCcMethod(bound_channel_, bound_number_, rsj::CCmethod::kTwosComplement);
       //[/UserButtonCode_twosbutton]
    }
@@ -224,6 +261,8 @@ void CCoptions::buttonClicked(Button* button_that_was_clicked)
       minvaltext->setVisible(true);
       minvallabel->setVisible(true);
       maxvallabel->setText(TRANS("Maximum value"), juce::dontSendNotification);
+      accelerationtext->setVisible(false);
+      accelerationlabel->setVisible(false);
       controls_model_->SetCcMethod(bound_channel_, bound_number_, rsj::CCmethod::kAbsolute);
       //[/UserButtonCode_absbutton]
    }
@@ -233,6 +272,8 @@ void CCoptions::buttonClicked(Button* button_that_was_clicked)
       minvallabel->setVisible(false);
       maxvallabel->setText(TRANS("Resolution"), juce::dontSendNotification);
       minvaltext->setText("0", juce::dontSendNotification);
+      accelerationtext->setVisible(true);
+      accelerationlabel->setVisible(true);
       controls_model_->SetCcMethod(bound_channel_, bound_number_, rsj::CCmethod::kBinaryOffset);
 
       //[/UserButtonCode_binbutton]
@@ -243,9 +284,21 @@ void CCoptions::buttonClicked(Button* button_that_was_clicked)
       minvallabel->setVisible(false);
       maxvallabel->setText(TRANS("Resolution"), juce::dontSendNotification);
       minvaltext->setText("0", juce::dontSendNotification);
+      accelerationtext->setVisible(true);
+      accelerationlabel->setVisible(true);
       controls_model_->SetCcMethod(bound_channel_, bound_number_, rsj::CCmethod::kSignMagnitude);
       //[/UserButtonCode_signbutton]
    }
+   else if (button_that_was_clicked == hiresbutton) {
+      //[UserButtonCode_hiresbutton] -- add your button handler code here..
+      controls_model_->SetCc14Bit(
+          bound_channel_, bound_number_, hiresbutton->getToggleState()); // resets the range
+      minvaltext->setText(juce::String(controls_model_->GetCcMin(bound_channel_, bound_number_)),
+          juce::dontSendNotification);
+      maxvaltext->setText(juce::String(controls_model_->GetCcMax(bound_channel_, bound_number_)),
+          juce::dontSendNotification);
+      //[/UserButtonCode_hiresbutton]
+   }
    else if (button_that_was_clicked == applyAll) {
       //[UserButtonCode_applyAll] -- add your button handler code here..
       rsj::CCmethod ccm;
@@ -263,7 +316,8 @@ void CCoptions::buttonClicked(Button* button_that_was_clicked)
       }
       controls_model_->SetCcAll(bound_channel_, bound_number_,
           gsl::narrow_cast<short>(minvaltext->getText().getIntValue()),
-          gsl::narrow_cast<short>(maxvaltext->getText().getIntValue()), ccm);
+          gsl::narrow_cast<short>(maxvaltext->getText().getIntValue()), ccm,
+          gsl::narrow_cast<short>(accelerationtext->getText().getIntValue()));
       //[/UserButtonCode_applyAll]
    }
 
@@ -280,6 +334,11 @@ void CCoptions::textEditorFocusLost(TextEditor& t)
       controls_model_->SetCcMin(bound_channel_, bound_number_, val);
    else if (nam == "maxvaltext")
       controls_model_->SetCcMax(bound_channel_, bound_number_, val);
+   else if (nam == "accelerationtext") {
+      controls_model_->SetCcAcceleration(bound_channel_, bound_number_, val);
+      t.setText(juce::String(controls_model_->GetCcAcceleration(bound_channel_, bound_number_)),
+          juce::dontSendNotification); // show the value after limiting to the allowed range
+   }
 }
 
 void CCoptions::BindToControl(size_t channel, short number)
@@ -289,10 +348,16 @@ void CCoptions::BindToControl(size_t channel, short number)
    controlID->setText("channel " + juce::String(gsl::narrow_cast<unsigned>(channel + 1))
                           + " number " + juce::String(number),
        juce::dontSendNotification);
+   hiresbutton->setEnabled(number < 32);
+   hiresbutton->setToggleState(
+       controls_model_->IsCc14Bit(bound_channel_, bound_number_), juce::dontSendNotification);
    minvaltext->setText(juce::String(controls_model_->GetCcMin(bound_channel_, bound_number_)),
        juce::dontSendNotification);
    maxvaltext->setText(juce::String(controls_model_->GetCcMax(bound_channel_, bound_number_)),
        juce::dontSendNotification);
+   accelerationtext->setText(
+       juce::String(controls_model_->GetCcAcceleration(bound_channel_, bound_number_)),
+       juce::dontSendNotification);
    switch (controls_model_->GetCcMethod(bound_channel_, bound_number_)) {
    case rsj::CCmethod::kAbsolute:
       absbutton->setToggleState(true, juce::sendNotification);
@@ -323,7 +388,7 @@ BEGIN_JUCER_METADATA
                  parentClasses="public Component, private TextEditor::Listener"
                  constructorParams="" variableInitialisers="" snapPixels="8" snapActive="1"
                  snapShown="1" overlayOpacity="0.330" fixedSize="1" initialWidth="280"
-                 initialHeight="350">
+                 initialHeight="440">
   <BACKGROUND backgroundColour="ffffffff"/>
   <GROUPCOMPONENT name="CCmethod" id="3dee10ca9db3e476" memberName="groupComponent"
                   virtualName="" explicitFocusOrder="0" pos="16 60 240 157" title="CC Message Type"/>
@@ -362,7 +427,7 @@ BEGIN_JUCER_METADATA
          editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
          fontsize="15" bold="0" italic="0" justification="33"/>
   <TEXTBUTTON name="new button" id="836af06f251dc94d" memberName="applyAll"
-              virtualName="" explicitFocusOrder="7" pos="0Cc 141C 150 24" tooltip="Apply these settings to all similar controls."
+              virtualName="" explicitFocusOrder="9" pos="0Cc 141C 150 24" tooltip="Apply these settings to all similar controls."
               buttonText="Apply to all" connectedEdges="0" needsCallback="1"
               radioGroupId="0"/>
   <LABEL name="channel 0 number 0" id="aa2312920c3b6ed" memberName="controlID"
@@ -370,6 +435,19 @@ BEGIN_JUCER_METADATA
          edBkgCol="0" labelText="Channel 0 Number 0" editableSingleClick="0"
          editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
          fontsize="15" bold="0" italic="0" justification="36"/>
+  <TOGGLEBUTTON name="hires" id="5b0e1f7c9a3d2e64" memberName="hiresbutton"
+                virtualName="" explicitFocusOrder="7" pos="16 300 240 24" tooltip="Control sends a 14-bit value, its fine part on control number + 32. Only available for control numbers 0 to 31."
+                buttonText="14-bit (fine part on number + 32)" connectedEdges="0"
+                needsCallback="1" radioGroupId="0" state="0"/>
+  <TEXTEDITOR name="accelerationtext" id="7d41c2e8b05f9a13" memberName="accelerationtext"
+              virtualName="" explicitFocusOrder="8" pos="200 332 56 24" tooltip="Largest step multiplier when the control is turned quickly. 1 turns acceleration off, slow turns always move one step at a time."
+              initialText="1" multiline="0" retKeyStartsLine="0" readonly="0"
+              scrollbars="1" caret="1" popupmenu="1"/>
+  <LABEL name="accelerationlabel" id="c3f8a6d2e1b74590" memberName="accelerationlabel"
+         virtualName="" explicitFocusOrder="0" pos="16 332 150 24" edTextCol="ff000000"
+         edBkgCol="0" labelText="Acceleration" editableSingleClick="0"
+         editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
+         fontsize="15" bold="0" italic="0" justification="33"/>
 </JUCER_COMPONENT>
 
 END_JUCER_METADATA
@@ -102,6 +102,9 @@ class CCoptions final : public juce::Component,
    juce::ScopedPointer<juce::Label> maxvallabel;
    juce::ScopedPointer<juce::TextButton> applyAll;
    juce::ScopedPointer<juce::Label> controlID;
+   juce::ScopedPointer<juce::ToggleButton> hiresbutton;
+   juce::ScopedPointer<juce::TextEditor> accelerationtext;
+   juce::ScopedPointer<juce::Label> accelerationlabel;
 
    //==============================================================================
    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CCoptions)
@@ -21,6 +21,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "CommandMenu.h"
 
 #include <exception>
+#include <vector>
 
 #include <gsl/gsl>
 #include "CCoptions.h"
@@ -77,6 +78,9 @@ void CommandMenu::clicked(const juce::ModifierKeys& modifiers)
                 nullptr, juce::Colour::fromRGB(0xFF, 0xFF, 0xFF), true);
             break;
          }
+         case rsj::MsgIdEnum::kNote:
+            AddGestureRow();
+            break;
          default:
              /* do nothing for other types of controllers */;
          }
@@ -132,4 +136,56 @@ void CommandMenu::clicked(const juce::ModifierKeys& modifiers)
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
       throw;
    }
-}
\ No newline at end of file
+}
+
+void CommandMenu::AddGestureRow()
+{
+   try {
+      const auto note = gsl::narrow_cast<short>(message_.data);
+      if (note > 0x7F)
+         return;
+      const rsj::MidiMessageId long_press{
+          message_.channel, note, rsj::MsgIdEnum::kLongPress, message_.device};
+      const rsj::MidiMessageId double_tap{
+          message_.channel, note, rsj::MsgIdEnum::kDoubleTap, message_.device};
+      juce::PopupMenu menu;
+      menu.addItem(1, juce::translate("Add long press row"),
+          !profile_.MessageExistsInMap(long_press));
+      menu.addItem(2, juce::translate("Add double tap row"),
+          !profile_.MessageExistsInMap(double_tap));
+      // chords with the other notes of this channel and device already in the profile
+      std::vector<rsj::MidiMessageId> chords{};
+      juce::PopupMenu chord_menu;
+      for (size_t row = 0, rows = profile_.Size(); row < rows; ++row) {
+         const auto other = profile_.GetMessageForNumber(row);
+         if (other.msg_id_type != rsj::MsgIdEnum::kNote || other.channel != message_.channel
+             || other.device != message_.device || other.data == note || other.data > 0x7F)
+            continue;
+         chords.emplace_back(message_.channel,
+             rsj::ChordNumber(note, gsl::narrow_cast<short>(other.data)), rsj::MsgIdEnum::kChord,
+             message_.device);
+         chord_menu.addItem(gsl::narrow_cast<int>(chords.size()) + 2,
+             juce::translate("Note") + " " + juce::String(other.data),
+             !profile_.MessageExistsInMap(chords.back()));
+      }
+      menu.addSubMenu(juce::translate("Add chord row with"), chord_menu, !chords.empty());
+      switch (const auto result = menu.show(); result) {
+      case 0:
+         return;
+      case 1:
+         profile_.AddRowUnmapped(long_press);
+         break;
+      case 2:
+         profile_.AddRowUnmapped(double_tap);
+         break;
+      default:
+         profile_.AddRowUnmapped(chords.at(gsl::narrow_cast<size_t>(result) - 3));
+      }
+      if (auto* const table = findParentComponentOfClass<juce::TableListBox>())
+         table->updateContent();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
@@ -38,6 +38,9 @@ class CommandMenu final : public juce::TextButton {
 
  private:
    void clicked(const juce::ModifierKeys& modifiers) override;
+   // offers rows for this note's long press, double tap and chords with other notes in the
+   // profile, see GestureFilter
+   void AddGestureRow();
 
    Profile& profile_;
    const CommandSet& command_set_;
@@ -26,6 +26,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "CommandMenu.h"
 #include "Misc.h"
+#include "Osc.h"
 
 CommandTableModel::CommandTableModel(const CommandSet& command_set, Profile& profile) noexcept
     : command_set_{command_set}, profile_{profile}
@@ -70,9 +71,8 @@ void CommandTableModel::paintCell(
          }
          else {
             std::ostringstream format_str;
-            switch (
-                const auto cmd = profile_.GetMessageForNumber(gsl::narrow_cast<size_t>(row_number));
-                cmd.msg_id_type) {
+            const auto cmd = profile_.GetMessageForNumber(gsl::narrow_cast<size_t>(row_number));
+            switch (cmd.msg_id_type) {
             case rsj::MsgIdEnum::kNote:
                format_str << cmd.channel << " | Note : " << cmd.data;
                break;
@@ -82,7 +82,25 @@ void CommandTableModel::paintCell(
             case rsj::MsgIdEnum::kPitchBend:
                format_str << cmd.channel << " | Pitch Bend";
                break;
+            case rsj::MsgIdEnum::kRpn:
+               format_str << cmd.channel << " | RPN: " << cmd.data;
+               break;
+            case rsj::MsgIdEnum::kOsc:
+               format_str << "OSC: " << rsj::OscAddress(cmd.data);
+               break;
+            case rsj::MsgIdEnum::kLongPress:
+               format_str << cmd.channel << " | Long press: " << cmd.data;
+               break;
+            case rsj::MsgIdEnum::kDoubleTap:
+               format_str << cmd.channel << " | Double tap: " << cmd.data;
+               break;
+            case rsj::MsgIdEnum::kChord:
+               format_str << cmd.channel << " | Chord: " << (cmd.data >> 7) << " + "
+                          << (cmd.data & 0x7F);
+               break;
             }
+            if (cmd.device != rsj::kAnyDevice)
+               format_str << " | " << profile_.DeviceLabel(cmd.device);
             g.drawText(format_str.str(), 0, 0, width, height, juce::Justification::centredLeft);
          }
       }
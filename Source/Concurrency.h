@@ -20,35 +20,123 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 ==============================================================================
 */
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
-#include <emmintrin.h>
+#include <functional>
 #include <mutex>
 #include <optional>
+#include <thread>
 #include <type_traits>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(_M_ARM)
+#include <intrin.h>
+#endif
+
+#include <gsl/gsl>
 
 namespace rsj {
-   class SpinLock {
+   // one spin-wait hint to the CPU: lets the other hyperthread run and saves power
+   inline void CpuRelax() noexcept
+   {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+      _mm_pause();
+#elif defined(_M_ARM64) || defined(_M_ARM)
+      __yield();
+#elif defined(__aarch64__) || defined(__arm__)
+      __asm__ __volatile__("yield");
+#else
+      std::atomic_signal_fence(std::memory_order_seq_cst); // no hint, just don't optimize away
+#endif
+   }
+
+   struct SpinLockStats {
+      std::uint64_t acquisitions{0};
+      std::uint64_t contended{0}; // acquisitions that found the lock taken
+      std::uint64_t spins{0};     // CpuRelax calls while waiting
+      std::uint64_t yields{0};    // time slices given up while waiting
+   };
+
+   namespace detail {
+      template<bool Stats> class SpinLockCounters {
+       protected:
+         void Count(std::uint64_t, std::uint64_t, std::uint64_t) noexcept {}
+      };
+      template<> class SpinLockCounters<true> {
+       public:
+         [[nodiscard]] SpinLockStats stats() const noexcept
+         {
+            return {acquisitions_.load(std::memory_order_relaxed),
+                contended_.load(std::memory_order_relaxed), spins_.load(std::memory_order_relaxed),
+                yields_.load(std::memory_order_relaxed)};
+         }
+
+       protected:
+         void Count(std::uint64_t rounds, std::uint64_t spins, std::uint64_t yields) noexcept
+         {
+            acquisitions_.fetch_add(1, std::memory_order_relaxed);
+            if (rounds) {
+               contended_.fetch_add(1, std::memory_order_relaxed);
+               spins_.fetch_add(spins, std::memory_order_relaxed);
+               yields_.fetch_add(yields, std::memory_order_relaxed);
+            }
+         }
+
+       private:
+         std::atomic<std::uint64_t> acquisitions_{0};
+         std::atomic<std::uint64_t> contended_{0};
+         std::atomic<std::uint64_t> spins_{0};
+         std::atomic<std::uint64_t> yields_{0};
+      };
+   } // namespace detail
+
+   // Test and test-and-set lock for critical sections of a few instructions. A waiter looks at
+   // the flag with exponential backoff, 1, 2, 4 ... kMaxPauses CpuRelax between looks, and after
+   // kSpinRounds looks gives up its time slice before each one, so it doesn't burn a core while
+   // the holder is preempted. Stats = true keeps counts for stats(), at the cost of atomic adds
+   // on every acquisition.
+   template<bool Stats = false> class BasicSpinLock : public detail::SpinLockCounters<Stats> {
     public:
-      SpinLock() noexcept = default;
-      ~SpinLock() = default;
-      SpinLock(const SpinLock& other) = delete;
-      SpinLock(SpinLock&& other) = delete;
-      SpinLock& operator=(const SpinLock& other) = delete;
-      SpinLock& operator=(SpinLock&& other) = delete;
+      BasicSpinLock() noexcept = default;
+      ~BasicSpinLock() = default;
+      BasicSpinLock(const BasicSpinLock& other) = delete;
+      BasicSpinLock(BasicSpinLock&& other) = delete;
+      BasicSpinLock& operator=(const BasicSpinLock& other) = delete;
+      BasicSpinLock& operator=(BasicSpinLock&& other) = delete;
       void lock() noexcept
       {
-         do { // avoid cache invalidation if lock appears to be unavailable
-            while (flag_.load(std::memory_order_relaxed))
-               _mm_pause(); // spin without expensive exchange
-         } while (flag_.exchange(true, std::memory_order_acquire));
+         std::uint64_t rounds{0};
+         std::uint64_t spins{0};
+         std::uint64_t yields{0};
+         unsigned pauses{1};
+         // avoid cache invalidation if lock appears to be unavailable
+         while (flag_.load(std::memory_order_relaxed)
+                || flag_.exchange(true, std::memory_order_acquire)) {
+            if (++rounds <= kSpinRounds) {
+               for (auto i = 0u; i < pauses; ++i)
+                  CpuRelax(); // spin without expensive exchange
+               spins += pauses;
+               pauses = std::min(pauses * 2, kMaxPauses);
+            }
+            else {
+               std::this_thread::yield();
+               ++yields;
+            }
+         }
+         this->Count(rounds, spins, yields);
       }
       bool try_lock() noexcept
       { // avoid cache invalidation if lock appears to be unavailable
-         if (flag_.load(std::memory_order_relaxed))
+         if (flag_.load(std::memory_order_relaxed)
+             || flag_.exchange(true, std::memory_order_acquire))
             return false;
-         return !flag_.exchange(true, std::memory_order_acquire); // try to acquire lock
+         this->Count(0, 0, 0);
+         return true;
       }
       void unlock() noexcept
       {
@@ -56,10 +144,221 @@ namespace rsj {
       }
 
     private:
+      static constexpr unsigned kMaxPauses{64};
+      static constexpr std::uint64_t kSpinRounds{16}; // about 700 pauses, a few microseconds
       std::atomic<bool> flag_{false};
    };
+   using SpinLock = BasicSpinLock<>;
+
+   // Bounded single-producer/single-consumer ring. push and pop are wait-free and never allocate,
+   // so it is safe to call try_push from a near-real-time callback. Exactly one thread may push
+   // and exactly one (possibly different) thread may pop. Capacity must be a power of two.
+   template<typename T, std::size_t Capacity> class SpscRing {
+      static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+          "SpscRing capacity must be a power of two");
+      static_assert(std::is_nothrow_copy_assignable_v<T>
+                        && std::is_nothrow_default_constructible_v<T>,
+          "SpscRing elements must be nothrow default constructible and copy assignable");
+
+    public:
+      using value_type = T;
+      using size_type = std::size_t;
+      SpscRing() noexcept = default;
+      ~SpscRing() = default;
+      SpscRing(const SpscRing& other) = delete;
+      SpscRing(SpscRing&& other) = delete;
+      SpscRing& operator=(const SpscRing& other) = delete;
+      SpscRing& operator=(SpscRing&& other) = delete;
+      // producer side. returns false (and drops value) if the ring is full
+      [[nodiscard]] bool try_push(const T& value) noexcept
+      {
+         const auto tail = tail_.load(std::memory_order_relaxed);
+         if (tail - head_cache_ == Capacity) { // looks full, refresh consumer position
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == Capacity)
+               return false;
+         }
+         buffer_[tail & kMask] = value;
+         tail_.store(tail + 1, std::memory_order_release);
+         return true;
+      }
+      // consumer side
+      [[nodiscard]] std::optional<T> try_pop() noexcept
+      {
+         const auto head = head_.load(std::memory_order_relaxed);
+         if (head == tail_cache_) { // looks empty, refresh producer position
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+               return std::nullopt;
+         }
+         T rc{buffer_[head & kMask]};
+         head_.store(head + 1, std::memory_order_release);
+         return rc;
+      }
+      // may be called from either side; result is a snapshot
+      [[nodiscard]] bool empty() const noexcept
+      {
+         return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+      }
+      [[nodiscard]] static constexpr size_type capacity() noexcept
+      {
+         return Capacity;
+      }
+
+    private:
+      static constexpr size_type kMask{Capacity - 1};
+      static constexpr size_type kCacheLine{64};
+      // consumer-owned line
+      alignas(kCacheLine) std::atomic<size_type> head_{0};
+      size_type tail_cache_{0};
+      // producer-owned line
+      alignas(kCacheLine) std::atomic<size_type> tail_{0};
+      size_type head_cache_{0};
+      alignas(kCacheLine) std::array<T, Capacity> buffer_{};
+   };
+
+   // Bounded multi-producer/multi-consumer ring of fixed slots (Vyukov's design): each slot
+   // carries a sequence number telling a producer it's free and a consumer it's filled, so
+   // try_push and try_pop never lock and only contend on a compare-exchange of the shared
+   // position. Neither waits nor allocates; pair with Doorbell to sleep while empty. Capacity
+   // must be a power of two.
+   template<typename T, std::size_t Capacity> class MpmcRing {
+      static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+          "MpmcRing capacity must be a power of two");
+      static_assert(std::is_default_constructible_v<T> && std::is_nothrow_move_constructible_v<T>
+                        && std::is_nothrow_move_assignable_v<T>,
+          "MpmcRing elements must be default constructible and nothrow movable");
+
+    public:
+      using value_type = T;
+      using size_type = std::size_t;
+      MpmcRing() noexcept(std::is_nothrow_default_constructible_v<T>)
+      {
+         for (size_type i = 0; i < Capacity; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      ~MpmcRing() = default;
+      MpmcRing(const MpmcRing& other) = delete;
+      MpmcRing(MpmcRing&& other) = delete;
+      MpmcRing& operator=(const MpmcRing& other) = delete;
+      MpmcRing& operator=(MpmcRing&& other) = delete;
+      // returns false, and leaves value alone, if the ring is full
+      [[nodiscard]] bool try_push(T&& value) noexcept
+      {
+         auto position = tail_.load(std::memory_order_relaxed);
+         while (true) {
+            auto& cell = cells_[position & kMask];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto lag = static_cast<std::ptrdiff_t>(sequence - position);
+            if (lag == 0) { // free, claim it
+               if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                  cell.value = std::move(value);
+                  cell.sequence.store(position + 1, std::memory_order_release);
+                  return true;
+               }
+            }
+            else if (lag < 0) // still holds the value from a lap ago
+               return false;
+            else // another producer got there first
+               position = tail_.load(std::memory_order_relaxed);
+         }
+      }
+      [[nodiscard]] std::optional<T> try_pop() noexcept
+      {
+         auto position = head_.load(std::memory_order_relaxed);
+         while (true) {
+            auto& cell = cells_[position & kMask];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto lag = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+            if (lag == 0) { // filled, claim it
+               if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                  std::optional<T> rc{std::move(cell.value)};
+                  cell.sequence.store(position + Capacity, std::memory_order_release);
+                  return rc;
+               }
+            }
+            else if (lag < 0) // not filled yet
+               return std::nullopt;
+            else // another consumer got there first
+               position = head_.load(std::memory_order_relaxed);
+         }
+      }
+      // whether try_pop would have found nothing; a snapshot
+      [[nodiscard]] bool empty() const noexcept
+      {
+         const auto position = head_.load(std::memory_order_relaxed);
+         return cells_[position & kMask].sequence.load(std::memory_order_acquire) != position + 1;
+      }
+      [[nodiscard]] static constexpr size_type capacity() noexcept
+      {
+         return Capacity;
+      }
+
+    private:
+      static constexpr size_type kMask{Capacity - 1};
+      static constexpr size_type kCacheLine{64};
+      struct Cell {
+         std::atomic<size_type> sequence{0};
+         T value{};
+      };
+      alignas(kCacheLine) std::atomic<size_type> head_{0};
+      alignas(kCacheLine) std::atomic<size_type> tail_{0};
+      alignas(kCacheLine) std::array<Cell, Capacity> cells_{};
+   };
+
+   // Lets a single consumer of lock-free queues sleep while they're empty. Producers call Ring
+   // after publishing and only touch the mutex when the consumer is actually asleep, so a busy
+   // consumer costs them one fence and one load. The consumer announces it is going to sleep
+   // before its last look at the queues, so a Ring after publishing can't be missed.
+   class Doorbell {
+    public:
+      Doorbell() noexcept = default;
+      ~Doorbell() = default;
+      Doorbell(const Doorbell& other) = delete;
+      Doorbell(Doorbell&& other) = delete;
+      Doorbell& operator=(const Doorbell& other) = delete;
+      Doorbell& operator=(Doorbell&& other) = delete;
+      // consumer: returns once ready() is true. ready must only read what producers publish
+      // before ringing
+      template<class Predicate> void Wait(Predicate ready)
+      {
+         if (ready())
+            return;
+         auto lock{std::unique_lock(mutex_)};
+         sleeping_.store(true, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in Ring
+         condition_.wait(lock, ready);
+         sleeping_.store(false, std::memory_order_relaxed);
+      }
+      void Ring()
+      {
+         std::atomic_thread_fence(std::memory_order_seq_cst); // publication before the look
+         if (sleeping_.load(std::memory_order_relaxed)) {
+            { // consumer is between its last look and the wait, or waiting
+               auto lock{std::scoped_lock(mutex_)};
+            }
+            condition_.notify_one();
+         }
+      }
+
+    private:
+      std::atomic<bool> sleeping_{false};
+      std::mutex mutex_{};
+      std::condition_variable condition_{};
+   };
+
+   // what a push does when a bounded BlockingQueue is full
+   enum class Overflow {
+      kBlock,      // wait for a pop
+      kDropOldest, // discard the front element to make room
+      kDropNewest, // discard the value being pushed
+      kCoalesce    // replace the newest queued element with the same key, else wait for a pop
+   };
 
-   // all but blocking pops use scoped_lock. blocking pops use unique_lock
+   // all but blocking pops use scoped_lock. blocking pops and blocking pushes use unique_lock.
+   // Unbounded unless constructed with a capacity; a bounded queue keeps its capacity and policy
+   // through assignment and swap, only the elements move. After close, pushes are ignored and
+   // blocking pops return what is left, then nothing, instead of waiting.
    template<typename T, class Container = std::deque<T>> class BlockingQueue {
     public:
       using container_type = Container;
@@ -70,6 +369,7 @@ namespace rsj {
       static_assert(std::is_same_v<T, value_type>, "container adaptors require consistent types");
       // Constructors: see https://en.cppreference.com/w/cpp/container/queue/queue
       // These are in same order and number as in cppreference
+      using SameKey = std::function<bool(const T& queued, const T& pushed)>;
       /*1*/ BlockingQueue() noexcept(std::is_nothrow_default_constructible_v<Container>){};
       /*2*/ explicit BlockingQueue(const Container& cont) noexcept(
           std::is_nothrow_copy_constructible_v<Container>)
@@ -85,12 +385,14 @@ namespace rsj {
       {
          auto lock{std::scoped_lock(other.mutex_)};
          queue_ = other.queue_;
+         bounds_ = other.bounds_;
       }
       /*5*/ BlockingQueue(BlockingQueue&& other) noexcept(
           std::is_nothrow_move_constructible_v<BlockingQueue>)
       {
          auto lock{std::scoped_lock(other.mutex_)};
          queue_ = std::move(other.queue_);
+         bounds_ = std::move(other.bounds_);
       }
       /*6*/ template<class Alloc, class = std::enable_if_t<std::uses_allocator_v<Container, Alloc>>>
       explicit BlockingQueue(const Alloc& alloc) noexcept(
@@ -113,6 +415,7 @@ namespace rsj {
       {
          auto lock{std::scoped_lock(other.mutex_)};
          queue_ = other.queue_;
+         bounds_ = other.bounds_;
       }
       /*10*/ template<class Alloc,
           class = std::enable_if_t<std::uses_allocator_v<Container, Alloc>>>
@@ -122,6 +425,16 @@ namespace rsj {
       {
          auto lock{std::scoped_lock(other.mutex_)};
          queue_ = std::move(other.queue_);
+         bounds_ = std::move(other.bounds_);
+      }
+      // bounded: holds at most capacity elements, a push to a full queue does as overflow says.
+      // same_key is required for kCoalesce and decides whether a pushed value supersedes a
+      // queued one
+      BlockingQueue(size_type capacity, Overflow overflow, SameKey same_key = {})
+          : bounds_{capacity, overflow, std::move(same_key)}
+      {
+         Expects(capacity > 0);
+         Expects(overflow != Overflow::kCoalesce || bounds_.same_key);
       }
       // operator=
       BlockingQueue& operator=(const BlockingQueue& other)
@@ -129,8 +442,10 @@ namespace rsj {
          {
             auto lock{std::scoped_lock(mutex_, other.mutex_)};
             queue_ = other.queue_;
+            high_water_ = std::max(high_water_, queue_.size());
          }
          condition_.notify_all();
+         not_full_.notify_all();
          return *this;
       }
       BlockingQueue& operator=(BlockingQueue&& other) noexcept(
@@ -139,8 +454,10 @@ namespace rsj {
          {
             auto lock{std::scoped_lock(mutex_, other.mutex_)};
             queue_ = std::move(other.queue_);
+            high_water_ = std::max(high_water_, queue_.size());
          }
          condition_.notify_all();
+         not_full_.notify_all();
          return *this;
       }
       // destructor
@@ -157,69 +474,155 @@ namespace rsj {
          return queue_.size();
       }
       void push(const T& value)
+      {
+         push(T(value));
+      }
+      void push(T&& value)
       {
          {
-            auto lock{std::scoped_lock(mutex_)};
-            queue_.push_back(value);
+            auto lock{std::unique_lock(mutex_)};
+            if (closed_ || MakeRoom(lock, value, true) != Room::kAppend)
+               return;
+            queue_.push_back(std::move(value));
+            high_water_ = std::max(high_water_, queue_.size());
          }
          condition_.notify_one();
       }
-      void push(T&& value)
+      // as push, but false instead of waiting for room, value left as it was
+      [[nodiscard]] bool try_push(T&& value)
       {
          {
-            auto lock{std::scoped_lock(mutex_)};
-            queue_.push_back(std::move(value));
+            auto lock{std::unique_lock(mutex_)};
+            if (closed_)
+               return true;
+            switch (MakeRoom(lock, value, false)) {
+            case Room::kFull:
+               return false;
+            case Room::kDone:
+               return true;
+            case Room::kAppend:
+               queue_.push_back(std::move(value));
+               high_water_ = std::max(high_water_, queue_.size());
+            }
          }
          condition_.notify_one();
+         return true;
       }
       template<class... Args> void emplace(Args&&... args)
       {
+         if (bounds_.capacity) { // the value is needed to decide where it goes
+            push(T(std::forward<Args>(args)...));
+            return;
+         }
          {
             auto lock{std::scoped_lock(mutex_)};
+            if (closed_)
+               return;
             queue_.emplace_back(std::forward<Args>(args)...);
+            high_water_ = std::max(high_water_, queue_.size());
          }
          condition_.notify_one();
       }
-      T pop()
+      // nullopt once closed and empty
+      [[nodiscard]] std::optional<T> pop()
       {
          auto lock{std::unique_lock(mutex_)};
          condition_.wait(lock, [this]() noexcept(noexcept(std::declval<Container>().empty())) {
-            return !queue_.empty();
+            return closed_ || !queue_.empty();
          });
-         T rc{std::move(queue_.front())};
+         if (queue_.empty())
+            return std::nullopt;
+         std::optional<T> rc{std::move(queue_.front())};
          queue_.pop_front();
+         lock.unlock();
+         not_full_.notify_one();
          return rc;
       }
       [[nodiscard]] std::optional<T> try_pop()
       {
-         auto lock{std::scoped_lock(mutex_)};
-         if (queue_.empty())
-            return std::nullopt;
-         T rc{std::move(queue_.front())};
-         queue_.pop_front();
+         std::optional<T> rc{};
+         {
+            auto lock{std::scoped_lock(mutex_)};
+            if (queue_.empty())
+               return std::nullopt;
+            rc.emplace(std::move(queue_.front()));
+            queue_.pop_front();
+         }
+         not_full_.notify_one();
          return rc;
       }
+      // batch pops take the lock once for the whole batch. pop_all and try_pop_all swap the
+      // internal container with out (after clearing out), so out's storage is reused by the queue
+      // false once closed and empty
+      bool pop_all(Container& out)
+      {
+         out.clear();
+         auto lock{std::unique_lock(mutex_)};
+         condition_.wait(lock, [this]() noexcept(noexcept(std::declval<Container>().empty())) {
+            return closed_ || !queue_.empty();
+         });
+         queue_.swap(out);
+         lock.unlock();
+         not_full_.notify_all();
+         return !out.empty();
+      }
+      bool try_pop_all(Container& out)
+      {
+         out.clear();
+         {
+            auto lock{std::scoped_lock(mutex_)};
+            queue_.swap(out);
+         }
+         not_full_.notify_all();
+         return !out.empty();
+      }
+      // moves up to out.size() elements into the front of out, returns number moved, 0 once
+      // closed and empty
+      size_type pop_batch(gsl::span<T> out)
+      {
+         auto lock{std::unique_lock(mutex_)};
+         condition_.wait(lock, [this]() noexcept(noexcept(std::declval<Container>().empty())) {
+            return closed_ || !queue_.empty();
+         });
+         const auto count{std::min(queue_.size(), gsl::narrow_cast<size_type>(out.size()))};
+         std::move(queue_.begin(), queue_.begin() + count, out.begin());
+         queue_.erase(queue_.begin(), queue_.begin() + count);
+         lock.unlock();
+         not_full_.notify_all();
+         return count;
+      }
       void swap(BlockingQueue& other) noexcept(std::is_nothrow_swappable_v<Container>)
       {
          {
             auto lock{std::scoped_lock(mutex_, other.mutex_)};
             queue_.swap(other.queue_);
+            high_water_ = std::max(high_water_, queue_.size());
+            other.high_water_ = std::max(other.high_water_, other.queue_.size());
          }
          condition_.notify_all();
          other.condition_.notify_all();
+         not_full_.notify_all();
+         other.not_full_.notify_all();
       }
       void clear() noexcept(noexcept(std::declval<Container>().clear()))
       {
-         auto lock{std::scoped_lock(mutex_)};
-         queue_.clear();
+         {
+            auto lock{std::scoped_lock(mutex_)};
+            queue_.clear();
+         }
+         not_full_.notify_all();
       }
 
       [[nodiscard]] auto clear_count() noexcept(noexcept(std::declval<Container>().clear())
                                                 && noexcept(std::declval<Container>().size()))
       {
-         auto lock{std::scoped_lock(mutex_)};
-         auto ret = queue_.size();
-         queue_.clear();
+         size_type ret;
+         {
+            auto lock{std::scoped_lock(mutex_)};
+            ret = queue_.size();
+            queue_.clear();
+         }
+         not_full_.notify_all();
          return ret;
       }
       auto clear_count_push(const T& value)
@@ -232,6 +635,7 @@ namespace rsj {
             queue_.push_back(value);
          }
          condition_.notify_one();
+         not_full_.notify_all();
          return ret;
       }
       auto clear_count_push(T&& value)
@@ -244,6 +648,7 @@ namespace rsj {
             queue_.push_back(std::move(value));
          }
          condition_.notify_one();
+         not_full_.notify_all();
          return ret;
       }
       template<class... Args> auto clear_count_emplace(Args&&... args)
@@ -256,12 +661,81 @@ namespace rsj {
             queue_.emplace_back(std::forward<Args>(args)...);
          }
          condition_.notify_one();
+         not_full_.notify_all();
          return ret;
       }
 
+      void close()
+      {
+         {
+            auto lock{std::scoped_lock(mutex_)};
+            closed_ = true;
+         }
+         condition_.notify_all();
+         not_full_.notify_all();
+      }
+      // most elements queued at once since construction
+      [[nodiscard]] size_type high_water() const
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         return high_water_;
+      }
+      // values lost to overflow, including queued values replaced by coalescing
+      [[nodiscard]] std::uint64_t dropped() const
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         return dropped_;
+      }
+
     private:
+      struct Bounds {
+         size_type capacity{0}; // 0 is unbounded
+         Overflow overflow{Overflow::kBlock};
+         SameKey same_key{};
+      };
+      enum class Room {
+         kAppend, // append value
+         kDone,   // value has been dealt with and isn't to be appended
+         kFull    // only when not waiting: a blocking push would wait
+      };
+      // applies the overflow policy with the lock held
+      Room MakeRoom(std::unique_lock<std::mutex>& lock, T& value, bool wait)
+      {
+         if (!bounds_.capacity || queue_.size() < bounds_.capacity)
+            return Room::kAppend;
+         switch (bounds_.overflow) {
+         case Overflow::kDropOldest:
+            queue_.pop_front();
+            ++dropped_;
+            return Room::kAppend;
+         case Overflow::kDropNewest:
+            ++dropped_;
+            return Room::kDone;
+         case Overflow::kCoalesce:
+            if (const auto it = std::find_if(queue_.rbegin(), queue_.rend(),
+                    [&](const T& queued) { return bounds_.same_key(queued, value); });
+                it != queue_.rend()) {
+               *it = std::move(value);
+               ++dropped_;
+               return Room::kDone;
+            }
+            [[fallthrough]];
+         case Overflow::kBlock:
+            if (!wait)
+               return Room::kFull;
+            not_full_.wait(
+                lock, [this] { return closed_ || queue_.size() < bounds_.capacity; });
+            return closed_ ? Room::kDone : Room::kAppend;
+         }
+         return Room::kAppend;
+      }
       Container queue_{};
+      Bounds bounds_{};
+      size_type high_water_{0};
+      std::uint64_t dropped_{0};
+      bool closed_{false};
       mutable std::condition_variable condition_{};
+      mutable std::condition_variable not_full_{};
       mutable std::mutex mutex_{};
    };
 } // namespace rsj
@@ -21,29 +21,66 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "ControlsModel.h"
 
 #include <algorithm>
+#include <chrono>
 #include <mutex>
+#include <utility>
 
 #include "MidiUtilities.h"
 #include "Misc.h"
 
-double ChannelModel::OffsetResult(short diff, size_t controlnumber)
+namespace {
+   // relative controls: steps further apart than kSlowStep are never accelerated, steps
+   // kFastStep or closer get the control's full acceleration
+   constexpr std::chrono::microseconds kSlowStep{100'000};
+   constexpr std::chrono::microseconds kFastStep{5'000};
+} // namespace
+
+short ChannelModel::Accelerate(
+    short diff, size_t controlnumber, CurrentValues& current, rsj::MidiTime time)
+{
+   try {
+      const auto acceleration = cc_acceleration_.at(controlnumber);
+      if (acceleration <= 1 || time == rsj::MidiTime{})
+         return diff;
+      auto& last = current.LastStep(controlnumber);
+      const auto interval = time - last;
+      last = time;
+      if (interval >= kSlowStep)
+         return diff;
+      // quadratic in speed, so moderate turns stay close to full precision
+      const auto speed = std::clamp(static_cast<double>((kSlowStep - interval).count())
+                                        / static_cast<double>((kSlowStep - kFastStep).count()),
+          0.0, 1.0);
+      const auto factor = 1.0 + (acceleration - 1) * speed * speed;
+      constexpr int kLimit{kMaxNrpn};
+      return gsl::narrow_cast<short>(std::clamp(juce::roundToInt(diff * factor), -kLimit, kLimit));
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+double ChannelModel::OffsetResult(
+    short diff, size_t controlnumber, short device, rsj::MidiTime time)
 {
    try {
       Expects(cc_high_.at(controlnumber) > 0); // CCLow will always be 0 for offset controls
       Expects(diff <= kMaxNrpn && diff >= -kMaxNrpn);
       Expects(controlnumber <= kMaxNrpn);
       auto lock = std::scoped_lock(current_v_mtx_);
-      current_v_.at(controlnumber) += diff;
-      if (current_v_.at(controlnumber) < 0) { // fix currentV
-         current_v_.at(controlnumber) = 0;
+      auto& current_values = CurrentI(device);
+      auto& current = current_values.cc.at(controlnumber);
+      current += Accelerate(diff, controlnumber, current_values, time);
+      if (current < 0) { // fix currentV
+         current = 0;
          return 0.0;
       }
-      if (current_v_.at(controlnumber) > cc_high_.at(controlnumber)) { // fix currentV
-         current_v_.at(controlnumber) = cc_high_.at(controlnumber);
+      if (current > cc_high_.at(controlnumber)) { // fix currentV
+         current = cc_high_.at(controlnumber);
          return 1.0;
       }
-      return static_cast<double>(current_v_.at(controlnumber))
-             / static_cast<double>(cc_high_.at(controlnumber));
+      return static_cast<double>(current) / static_cast<double>(cc_high_.at(controlnumber));
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -53,7 +90,8 @@ double ChannelModel::OffsetResult(short diff, size_t controlnumber)
 
 #pragma warning(push)
 #pragma warning(disable : 26451) // see TODO below
-double ChannelModel::ControllerToPlugin(short controltype, size_t controlnumber, short value)
+double ChannelModel::ControllerToPlugin(short controltype, size_t controlnumber, short value,
+    short device, rsj::MidiTime time, double fraction)
 {
    try {
       Expects(
@@ -65,45 +103,61 @@ double ChannelModel::ControllerToPlugin(short controltype, size_t controlnumber,
           controltype == rsj::kPwFlag ? value >= pitch_wheel_min_ && value <= pitch_wheel_max_ : 1);
       // note that the value is not msb,lsb, but rather the calculated value. Since lsb is only 7
       // bits, high bits are shifted one right when placed into short.
+      const auto position = [value, fraction](short high) noexcept {
+         return std::min(value + fraction, static_cast<double>(high));
+      };
       switch (controltype) {
-      case rsj::kPwFlag:
-         pitch_wheel_current_.store(value, std::memory_order_release);
+      case rsj::kPwFlag: {
+         auto lock = std::scoped_lock(current_v_mtx_);
+         CurrentI(device).pitch_wheel = value;
+      }
          // TODO(C26451): short mixed with double: can it overflow?
-         return static_cast<double>(value - pitch_wheel_min_)
+         return (position(pitch_wheel_max_) - pitch_wheel_min_)
                 / static_cast<double>(pitch_wheel_max_ - pitch_wheel_min_);
       case rsj::kCcFlag:
          switch (cc_method_.at(controlnumber)) {
          case rsj::CCmethod::kAbsolute: {
             auto lock = std::scoped_lock(current_v_mtx_);
-            current_v_.at(controlnumber) = value;
+            CurrentI(device).cc.at(controlnumber) = value;
          }
             // TODO(C26451): short mixed with double: can it overflow?
-            return static_cast<double>(value - cc_low_.at(controlnumber))
+            return (position(cc_high_.at(controlnumber)) - cc_low_.at(controlnumber))
                    / static_cast<double>(cc_high_.at(controlnumber) - cc_low_.at(controlnumber));
          case rsj::CCmethod::kBinaryOffset:
-            if (IsNRPN_(controlnumber))
-               return OffsetResult(value - kBit14, controlnumber);
-            return OffsetResult(value - kBit7, controlnumber);
+            if (Is14Bit_(controlnumber))
+               return OffsetResult(value - kBit14, controlnumber, device, time);
+            return OffsetResult(value - kBit7, controlnumber, device, time);
          case rsj::CCmethod::kSignMagnitude:
-            if (IsNRPN_(controlnumber))
-               return OffsetResult(value & kBit14 ? -(value & kLow13Bits) : value, controlnumber);
-            return OffsetResult(value & kBit7 ? -(value & kLow6Bits) : value, controlnumber);
+            if (Is14Bit_(controlnumber))
+               return OffsetResult(
+                   value & kBit14 ? -(value & kLow13Bits) : value, controlnumber, device, time);
+            return OffsetResult(
+                value & kBit7 ? -(value & kLow6Bits) : value, controlnumber, device, time);
          case rsj::CCmethod::
              kTwosComplement: // see
                               // https://en.wikipedia.org/wiki/Signed_number_representations#Two.27s_complement
-            if (IsNRPN_(controlnumber)) // flip twos comp and subtract--independent of processor
+            if (Is14Bit_(controlnumber)) // flip twos comp and subtract--independent of processor
                                         // architecture
                return OffsetResult(
-                   value & kBit14 ? -((value ^ kMaxNrpn) + 1) : value, controlnumber);
-            return OffsetResult(value & kBit7 ? -((value ^ kMaxMidi) + 1) : value, controlnumber);
+                   value & kBit14 ? -((value ^ kMaxNrpn) + 1) : value, controlnumber, device, time);
+            return OffsetResult(
+                value & kBit7 ? -((value ^ kMaxMidi) + 1) : value, controlnumber, device, time);
          default:
             Ensures(!"Should be unreachable code in ControllerToPlugin--unknown CCmethod");
             // ReSharper disable once CppUnreachableCode
             return 0.0;
          }
-      case rsj::kNoteOnFlag:
-         return static_cast<double>(value)
-                / static_cast<double>((IsNRPN_(controlnumber) ? kMaxNrpn : kMaxMidi));
+      case rsj::kRpnFlag: {
+         {
+            auto lock = std::scoped_lock(current_v_mtx_);
+            CurrentI(device).rpn.at(controlnumber) = value;
+         }
+         return position(kMaxNrpn) / static_cast<double>(kMaxNrpn);
+      }
+      case rsj::kNoteOnFlag: {
+         const auto high = IsNRPN_(controlnumber) ? kMaxNrpn : kMaxMidi;
+         return position(high) / static_cast<double>(high);
+      }
       case rsj::kNoteOffFlag:
          return 0.0;
       default:
@@ -121,22 +175,30 @@ double ChannelModel::ControllerToPlugin(short controltype, size_t controlnumber,
 
 // Note: rounding up on set to center (adding remainder of %2) to center the control's LED when
 // centered
-short ChannelModel::SetToCenter(short controltype, size_t controlnumber)
+short ChannelModel::SetToCenter(short controltype, size_t controlnumber, short device)
 {
    try {
       short retval{0};
       switch (controltype) {
-      case rsj::kPwFlag:
+      case rsj::kPwFlag: {
          retval = CenterPw();
-         pitch_wheel_current_.store(retval, std::memory_order_release);
+         auto lock = std::scoped_lock(current_v_mtx_);
+         CurrentI(device).pitch_wheel = retval;
          break;
+      }
       case rsj::kCcFlag:
          if (cc_method_.at(controlnumber) == rsj::CCmethod::kAbsolute) {
             auto lock = std::scoped_lock(current_v_mtx_);
             retval = CenterCc(controlnumber);
-            current_v_.at(controlnumber) = retval;
+            CurrentI(device).cc.at(controlnumber) = retval;
          }
          break;
+      case rsj::kRpnFlag: {
+         retval = kMaxNrpnHalf + kMaxNrpn % 2;
+         auto lock = std::scoped_lock(current_v_mtx_);
+         CurrentI(device).rpn.at(controlnumber) = retval;
+         break;
+      }
       default:
           /* */;
       }
@@ -148,7 +210,8 @@ short ChannelModel::SetToCenter(short controltype, size_t controlnumber)
    }
 }
 
-short ChannelModel::MeasureChange(short controltype, size_t controlnumber, short value)
+short ChannelModel::MeasureChange(
+    short controltype, size_t controlnumber, short value, short device)
 {
    try {
       Expects(
@@ -162,28 +225,27 @@ short ChannelModel::MeasureChange(short controltype, size_t controlnumber, short
       // bits, high bits are shifted one right when placed into short.
       switch (controltype) {
       case rsj::kPwFlag: {
-         return value - pitch_wheel_current_.exchange(value);
+         auto lock = std::scoped_lock(current_v_mtx_);
+         return value - std::exchange(CurrentI(device).pitch_wheel, value);
       }
       case rsj::kCcFlag:
          switch (cc_method_.at(controlnumber)) {
          case rsj::CCmethod::kAbsolute: {
             auto lock = std::scoped_lock(current_v_mtx_);
-            const short diff = value - current_v_.at(controlnumber);
-            current_v_.at(controlnumber) = value;
-            return diff;
+            return value - std::exchange(CurrentI(device).cc.at(controlnumber), value);
          }
          case rsj::CCmethod::kBinaryOffset:
-            if (IsNRPN_(controlnumber))
+            if (Is14Bit_(controlnumber))
                return value - kBit14;
             return value - kBit7;
          case rsj::CCmethod::kSignMagnitude:
-            if (IsNRPN_(controlnumber))
+            if (Is14Bit_(controlnumber))
                return value & kBit14 ? -(value & kLow13Bits) : value;
             return value & kBit7 ? -(value & kLow6Bits) : value;
          case rsj::CCmethod::
              kTwosComplement: // see
                               // https://en.wikipedia.org/wiki/Signed_number_representations#Two.27s_complement
-            if (IsNRPN_(controlnumber)) // flip twos comp and subtract--independent of processor
+            if (Is14Bit_(controlnumber)) // flip twos comp and subtract--independent of processor
                                         // architecture
                return value & kBit14 ? -((value ^ kMaxNrpn) + 1) : value;
             return value & kBit7 ? -((value ^ kMaxMidi) + 1) : value;
@@ -192,6 +254,10 @@ short ChannelModel::MeasureChange(short controltype, size_t controlnumber, short
             // ReSharper disable once CppUnreachableCode
             return short{0};
          }
+      case rsj::kRpnFlag: {
+         auto lock = std::scoped_lock(current_v_mtx_);
+         return value - std::exchange(CurrentI(device).rpn.at(controlnumber), value);
+      }
       case rsj::kNoteOnFlag:
       case rsj::kNoteOffFlag:
          return short{0};
@@ -209,7 +275,8 @@ short ChannelModel::MeasureChange(short controltype, size_t controlnumber, short
 
 #pragma warning(push)
 #pragma warning(disable : 26451) // see TODO below
-short ChannelModel::PluginToController(short controltype, size_t controlnumber, double value)
+short ChannelModel::PluginToController(
+    short controltype, size_t controlnumber, double value, short device)
 {
    try {
       Expects(controlnumber <= kMaxNrpn);
@@ -221,7 +288,8 @@ short ChannelModel::PluginToController(short controltype, size_t controlnumber,
              gsl::narrow_cast<short>(juce::roundToInt(value * (pitch_wheel_max_ - pitch_wheel_min_))
                                      + pitch_wheel_min_),
              pitch_wheel_min_, pitch_wheel_max_);
-         pitch_wheel_current_.store(newv, std::memory_order_release);
+         auto lock = std::scoped_lock(current_v_mtx_);
+         ForEachCurrentI(device, [newv](CurrentValues& current) { current.pitch_wheel = newv; });
          return newv;
       }
       case rsj::kCcFlag: {
@@ -233,7 +301,20 @@ short ChannelModel::PluginToController(short controltype, size_t controlnumber,
              cc_low_.at(controlnumber), cc_high_.at(controlnumber));
          {
             auto lock = std::scoped_lock(current_v_mtx_);
-            current_v_.at(controlnumber) = newv;
+            ForEachCurrentI(device, [newv, controlnumber](CurrentValues& current) {
+               current.cc.at(controlnumber) = newv;
+            });
+         }
+         return newv;
+      }
+      case rsj::kRpnFlag: {
+         const auto newv = std::clamp(
+             gsl::narrow_cast<short>(juce::roundToInt(value * kMaxNrpn)), short{0}, kMaxNrpn);
+         {
+            auto lock = std::scoped_lock(current_v_mtx_);
+            ForEachCurrentI(device, [newv, controlnumber](CurrentValues& current) {
+               current.rpn.at(controlnumber) = newv;
+            });
          }
          return newv;
       }
@@ -266,15 +347,32 @@ void ChannelModel::SetCc(size_t controlnumber, short min, short max, rsj::CCmeth
    }
 }
 
-void ChannelModel::SetCcAll(size_t controlnumber, short min, short max, rsj::CCmethod controltype)
+void ChannelModel::SetCcAll(
+    size_t controlnumber, short min, short max, rsj::CCmethod controltype, short acceleration)
 {
    try {
       if (IsNRPN_(controlnumber))
-         for (short a = kMaxMidi + 1; a <= kMaxNrpn; ++a)
+         for (short a = kMaxMidi + 1; a <= kMaxNrpn; ++a) {
             SetCc(a, min, max, controltype);
+            SetCcAcceleration(a, acceleration);
+         }
       else
-         for (short a = 0; a <= kMaxMidi; ++a)
+         for (short a = 0; a <= kMaxMidi; ++a) {
             SetCc(a, min, max, controltype);
+            SetCcAcceleration(a, acceleration);
+         }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void ChannelModel::SetCcAcceleration(size_t controlnumber, short value)
+{
+   try {
+      Expects(controlnumber <= kMaxNrpn);
+      cc_acceleration_.at(controlnumber) = std::clamp(value, short{1}, kMaxAcceleration);
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -291,13 +389,15 @@ void ChannelModel::SetCcMax(size_t controlnumber, short value)
       if (cc_method_.at(controlnumber) != rsj::CCmethod::kAbsolute)
          cc_high_.at(controlnumber) = value < 0 ? 1000 : value;
       else {
-         const auto max = IsNRPN_(controlnumber) ? kMaxNrpn : kMaxMidi;
+         const auto max = Is14Bit_(controlnumber) ? kMaxNrpn : kMaxMidi;
          cc_high_.at(controlnumber) =
              value <= cc_low_.at(controlnumber) || value > max ? max : value;
       }
       // lock may not be needed. this function called in non-multithreaded manner
       auto lock = std::scoped_lock(current_v_mtx_);
-      current_v_.at(controlnumber) = CenterCc(controlnumber);
+      ForEachCurrentI(rsj::kAnyDevice, [this, controlnumber](CurrentValues& current) {
+         current.cc.at(controlnumber) = CenterCc(controlnumber);
+      });
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -315,7 +415,25 @@ void ChannelModel::SetCcMin(size_t controlnumber, short value)
          cc_low_.at(controlnumber) = value < 0 || value >= cc_high_.at(controlnumber) ? 0 : value;
       // lock may not be needed. this function called in non-multithreaded manner
       auto lock = std::scoped_lock(current_v_mtx_);
-      current_v_.at(controlnumber) = CenterCc(controlnumber);
+      ForEachCurrentI(rsj::kAnyDevice, [this, controlnumber](CurrentValues& current) {
+         current.cc.at(controlnumber) = CenterCc(controlnumber);
+      });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void ChannelModel::SetCc14Bit(size_t controlnumber, bool value)
+{
+   try {
+      Expects(controlnumber < kHiResCcs);
+      if (IsCc14Bit(controlnumber) == value)
+         return;
+      cc_14bit_.at(controlnumber).store(value, std::memory_order_relaxed);
+      // the old limits belong to the other range, start over from the full range
+      SetCc(controlnumber, 0, value ? kMaxNrpn : kMaxMidi, cc_method_.at(controlnumber));
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -326,27 +444,38 @@ void ChannelModel::SetCcMin(size_t controlnumber, short value)
 void ChannelModel::SetPwMax(short value) noexcept
 {
    pitch_wheel_max_ = value > kMaxNrpn || value <= pitch_wheel_min_ ? kMaxNrpn : value;
-   pitch_wheel_current_.store(CenterPw(), std::memory_order_relaxed);
+   auto lock = std::scoped_lock(current_v_mtx_);
+   ForEachCurrentI(
+       rsj::kAnyDevice, [this](CurrentValues& current) { current.pitch_wheel = CenterPw(); });
 }
 
 void ChannelModel::SetPwMin(short value) noexcept
 {
    pitch_wheel_min_ = value < 0 || value >= pitch_wheel_max_ ? 0 : value;
-   pitch_wheel_current_.store(CenterPw(), std::memory_order_relaxed);
+   auto lock = std::scoped_lock(current_v_mtx_);
+   ForEachCurrentI(
+       rsj::kAnyDevice, [this](CurrentValues& current) { current.pitch_wheel = CenterPw(); });
 }
 
 void ChannelModel::ActiveToSaved() const
 {
    try {
       settings_to_save_.clear();
+      cc_14bit_to_save_.clear();
+      for (short i = 0; i < gsl::narrow_cast<short>(kHiResCcs); ++i)
+         if (IsCc14Bit(i))
+            cc_14bit_to_save_.push_back(i);
       for (short i = 0; i <= kMaxMidi; ++i)
-         if (cc_method_.at(i) != rsj::CCmethod::kAbsolute || cc_high_.at(i) != kMaxMidi
-             || cc_low_.at(i) != 0)
-            settings_to_save_.emplace_back(i, cc_low_.at(i), cc_high_.at(i), cc_method_.at(i));
+         if (cc_method_.at(i) != rsj::CCmethod::kAbsolute
+             || cc_high_.at(i) != (IsCc14Bit(i) ? kMaxNrpn : kMaxMidi) || cc_low_.at(i) != 0
+             || cc_acceleration_.at(i) != 1)
+            settings_to_save_.emplace_back(
+                i, cc_low_.at(i), cc_high_.at(i), cc_method_.at(i), cc_acceleration_.at(i));
       for (short i = kMaxMidi + 1; i <= kMaxNrpn; ++i)
          if (cc_method_.at(i) != rsj::CCmethod::kAbsolute || cc_high_.at(i) != kMaxNrpn
-             || cc_low_.at(i) != 0)
-            settings_to_save_.emplace_back(i, cc_low_.at(i), cc_high_.at(i), cc_method_.at(i));
+             || cc_low_.at(i) != 0 || cc_acceleration_.at(i) != 1)
+            settings_to_save_.emplace_back(
+                i, cc_low_.at(i), cc_high_.at(i), cc_method_.at(i), cc_acceleration_.at(i));
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -361,13 +490,14 @@ void ChannelModel::CcDefaults()
       cc_low_.fill(0);
       cc_high_.fill(0x3FFF); // XCode throws linker error when use ChannelModel::kMaxNRPN here
       cc_method_.fill(rsj::CCmethod::kAbsolute);
+      cc_acceleration_.fill(1);
+      for (size_t a = 0; a <= kMaxMidi; ++a)
+         if (!IsCc14Bit(a)) // 14-bit pairs keep the NRPN defaults
+            cc_high_.at(a) = kMaxMidi;
       // lock may not be needed. this function called in non-multithreaded manner
       auto lock = std::scoped_lock(current_v_mtx_);
-      current_v_.fill(short{8191});
-      for (size_t a = 0; a <= kMaxMidi; ++a) {
-         cc_high_.at(a) = kMaxMidi;
-         current_v_.at(a) = kMaxMidiHalf;
-      }
+      ForEachCurrentI(
+          rsj::kAnyDevice, [this](CurrentValues& current) { CenterCurrent(current); });
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -378,9 +508,80 @@ void ChannelModel::CcDefaults()
 void ChannelModel::SavedToActive()
 {
    try {
+      for (auto& flag : cc_14bit_)
+         flag.store(false, std::memory_order_relaxed);
+      for (const auto number : cc_14bit_to_save_)
+         if (number >= 0 && number < gsl::narrow_cast<short>(kHiResCcs))
+            cc_14bit_.at(gsl::narrow_cast<size_t>(number)).store(true, std::memory_order_relaxed);
       CcDefaults();
-      for (const auto& set : settings_to_save_)
+      for (const auto& set : settings_to_save_) {
          SetCc(set.number, set.low, set.high, set.method);
+         SetCcAcceleration(set.number, set.acceleration);
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void ChannelModel::OpenDevice(short device)
+{
+   try {
+      const auto slot = gsl::narrow_cast<size_t>(device);
+      {
+         auto lock = std::scoped_lock(current_v_mtx_);
+         if (const auto& current = current_v_.at(slot)) { // slot reused, forget the old device
+            CenterCurrent(*current);
+            return;
+         }
+      }
+      // allocated outside the lock. Should CurrentI's fallback fill the slot meanwhile, these
+      // centred positions replace its, as they would have anyway
+      auto values = std::make_unique<CurrentValues>();
+      CenterCurrent(*values);
+      auto spare = std::make_unique<CurrentValues>();
+      auto lock = std::scoped_lock(current_v_mtx_);
+      current_v_.at(slot) = std::move(values);
+      if (!spare_current_)
+         spare_current_ = std::move(spare);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+ChannelModel::CurrentValues& ChannelModel::CurrentI(short device)
+{
+   try {
+      auto& current = current_v_.at(gsl::narrow_cast<size_t>(device));
+      if (!current) { // device wasn't opened first, e.g. feedback for an empty slot's row
+         current = spare_current_ ? std::move(spare_current_) : std::make_unique<CurrentValues>();
+         CenterCurrent(*current);
+      }
+      return *current;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+rsj::MidiTime& ChannelModel::CurrentValues::LastStep(size_t controlnumber)
+{
+   try {
+      if (controlnumber <= kMaxMidi)
+         return cc_step.at(controlnumber);
+      auto oldest = nrpn_step.begin();
+      for (auto it = nrpn_step.begin(); it != nrpn_step.end(); ++it) {
+         if (it->first == controlnumber)
+            return it->second;
+         if (it->second < oldest->second)
+            oldest = it;
+      }
+      *oldest = {controlnumber, rsj::MidiTime{}}; // reads as a slow step
+      return oldest->second;
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -388,10 +589,19 @@ void ChannelModel::SavedToActive()
    }
 }
 
+void ChannelModel::CenterCurrent(CurrentValues& current) const noexcept
+{
+   for (size_t a = 0; a < kMaxControls; ++a)
+      current.cc.at(a) = CenterCc(a);
+   current.rpn.fill(0);
+   current.pitch_wheel = CenterPw();
+}
+
 ChannelModel::ChannelModel()
 {
    try {
       CcDefaults();
+      spare_current_ = std::make_unique<CurrentValues>();
       // load settings
    }
    catch (const std::exception& e) {
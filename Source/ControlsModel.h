@@ -23,6 +23,8 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <array>
 #include <atomic>
 #include <exception>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include <cereal/access.hpp>
@@ -42,10 +44,11 @@ namespace rsj {
       short low;
       short high;
       rsj::CCmethod method;
+      short acceleration; // largest step multiplier for relative controls, 1 is none
       // ReSharper disable once CppNonExplicitConvertingConstructor
       SettingsStruct(short n = 0, short l = 0, short h = 0x7F,
-          rsj::CCmethod m = rsj::CCmethod::kAbsolute) noexcept
-          : number{n}, low{l}, high{h}, method{m}
+          rsj::CCmethod m = rsj::CCmethod::kAbsolute, short a = 1) noexcept
+          : number{n}, low{l}, high{h}, method{m}, acceleration{a}
       {
       }
 
@@ -58,6 +61,9 @@ namespace rsj {
          case 1:
             archive(number, high, low, method);
             break;
+         case 2:
+            archive(number, high, low, method, acceleration);
+            break;
          default:
             rsj::LogAndAlertError("Wrong archive version for SettingsStruct. Version is "
                                   + juce::String(version) + '.');
@@ -71,7 +77,8 @@ namespace rsj {
       {
          try {
             switch (version) {
-            case 1: {
+            case 1:
+            case 2: {
                std::string methodstr{"undefined"};
                switch (method) {
                case CCmethod::kAbsolute:
@@ -90,6 +97,8 @@ namespace rsj {
                }
                archive(cereal::make_nvp("CC", number), CEREAL_NVP(high), CEREAL_NVP(low),
                    cereal::make_nvp("method", methodstr));
+               if (version >= 2)
+                  archive(CEREAL_NVP(acceleration));
                switch (methodstr.front()) {
                case 'B':
                   method = CCmethod::kBinaryOffset;
@@ -130,6 +139,8 @@ class ChannelModel {
    static constexpr short kMaxNrpn = 0x3FFF;
    static constexpr short kMaxNrpnHalf = kMaxNrpn / 2;
    static constexpr size_t kMaxControls = 0x4000;
+   static constexpr size_t kHiResCcs = 32; // CC 0-31 may pair with an LSB on CC 32-63
+   static constexpr short kMaxAcceleration = 64;
 
  public:
    ChannelModel();
@@ -139,9 +150,18 @@ class ChannelModel {
    ChannelModel& operator=(const ChannelModel&) = delete;
    ChannelModel(ChannelModel&&) = delete; // can't move atomics
    ChannelModel& operator=(ChannelModel&&) = delete;
-   double ControllerToPlugin(short controltype, size_t controlnumber, short value);
-   short MeasureChange(short controltype, size_t controlnumber, short value);
-   short SetToCenter(short controltype, size_t controlnumber);
+   // device is the input slot the value belongs to. Each device keeps its own control positions,
+   // the ranges and methods are shared.
+   // time is the message's arrival, used to accelerate relative controls turned quickly.
+   // fraction is the part of a MIDI 2.0 value below value's resolution; absolute controls add it
+   // to value, never going past the top of the control's range
+   double ControllerToPlugin(short controltype, size_t controlnumber, short value, short device,
+       rsj::MidiTime time = {}, double fraction = 0.0);
+   short MeasureChange(short controltype, size_t controlnumber, short value, short device);
+   // gives a device that has just been given a slot centred positions, allocating them the first
+   // time so the dispatch thread doesn't. Message thread only
+   void OpenDevice(short device);
+   short SetToCenter(short controltype, size_t controlnumber, short device);
    [[nodiscard]] rsj::CCmethod GetCcMethod(size_t controlnumber) const
    {
       try {
@@ -152,6 +172,16 @@ class ChannelModel {
          throw;
       }
    }
+   [[nodiscard]] short GetCcAcceleration(size_t controlnumber) const
+   {
+      try {
+         return cc_acceleration_.at(controlnumber);
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
    [[nodiscard]] short GetCcMax(size_t controlnumber) const
    {
       try {
@@ -180,9 +210,14 @@ class ChannelModel {
    {
       return pitch_wheel_min_;
    }
-   short PluginToController(short controltype, size_t controlnumber, double value);
+   // device kAnyDevice updates the positions of every device
+   short PluginToController(short controltype, size_t controlnumber, double value, short device);
    void SetCc(size_t controlnumber, short min, short max, rsj::CCmethod controltype);
-   void SetCcAll(size_t controlnumber, short min, short max, rsj::CCmethod controltype);
+   void SetCcAll(size_t controlnumber, short min, short max, rsj::CCmethod controltype,
+       short acceleration);
+   // relative controls only: turned quickly, each step is multiplied by up to value (1 to
+   // kMaxAcceleration, 1 turns acceleration off); turned slowly, steps are unchanged
+   void SetCcAcceleration(size_t controlnumber, short value);
    void SetCcMax(size_t controlnumber, short value);
    void SetCcMethod(size_t controlnumber, rsj::CCmethod value)
    {
@@ -195,6 +230,13 @@ class ChannelModel {
       }
    }
    void SetCcMin(size_t controlnumber, short value);
+   // 14-bit controls read their value from an MSB/LSB pair and use the same 0-16383 range as NRPN
+   [[nodiscard]] bool IsCc14Bit(size_t controlnumber) const noexcept
+   {
+      return controlnumber < kHiResCcs
+             && cc_14bit_[controlnumber].load(std::memory_order_relaxed);
+   }
+   void SetCc14Bit(size_t controlnumber, bool value);
    void SetPwMax(short value) noexcept;
    void SetPwMin(short value) noexcept;
 
@@ -217,16 +259,51 @@ class ChannelModel {
       Expects(controlnumber <= kMaxNrpn);
       return controlnumber > kMaxMidi;
    }
-   double OffsetResult(short diff, size_t controlnumber);
+   // NRPN or 14-bit CC pair: value has 14 bits
+   [[nodiscard]] bool Is14Bit_(size_t controlnumber) const noexcept(kNdebug)
+   {
+      return IsNRPN_(controlnumber) || IsCc14Bit(controlnumber);
+   }
+   // positions as last received or sent, for each device opened since the app started.
+   // Allocated by OpenDevice, they are only accessed under current_v_mtx_.
+   struct CurrentValues {
+      std::array<short, kMaxControls> cc{};
+      std::array<short, kMaxControls> rpn{}; // RPNs are absolute over the full 14-bit range
+      short pitch_wheel{0};
+      // last step of accelerated relative controls: CCs by number, the few accelerated
+      // NRPN-numbered ones in a small table whose oldest entry is reused when it is full
+      std::array<rsj::MidiTime, kMaxMidi + 1> cc_step{};
+      std::array<std::pair<size_t, rsj::MidiTime>, 16> nrpn_step{};
+      rsj::MidiTime& LastStep(size_t controlnumber);
+   };
+   CurrentValues& CurrentI(short device);
+   template<class F> void ForEachCurrentI(short device, F&& f)
+   {
+      if (device != rsj::kAnyDevice) {
+         f(CurrentI(device));
+         return;
+      }
+      for (auto& current : current_v_)
+         if (current)
+            f(*current);
+   }
+   void CenterCurrent(CurrentValues& current) const noexcept;
+   short Accelerate(short diff, size_t controlnumber, CurrentValues& current, rsj::MidiTime time);
+   double OffsetResult(short diff, size_t controlnumber, short device, rsj::MidiTime time);
    mutable rsj::SpinLock current_v_mtx_;
    mutable std::vector<rsj::SettingsStruct> settings_to_save_{};
+   mutable std::vector<short> cc_14bit_to_save_{};
    short pitch_wheel_max_{kMaxNrpn};
    short pitch_wheel_min_{0};
-   std::atomic<short> pitch_wheel_current_{0};
    std::array<rsj::CCmethod, kMaxControls> cc_method_{};
    std::array<short, kMaxControls> cc_high_{};
    std::array<short, kMaxControls> cc_low_{};
-   std::array<short, kMaxControls> current_v_{};
+   std::array<short, kMaxControls> cc_acceleration_{};
+   std::array<std::unique_ptr<CurrentValues>, rsj::kMaxInputDevices> current_v_{};
+   // taken by CurrentI's fallback so it need not allocate under the lock; OpenDevice refills it
+   std::unique_ptr<CurrentValues> spare_current_{};
+   // read by the MIDI input callbacks
+   std::array<std::atomic<bool>, kHiResCcs> cc_14bit_{};
    // ReSharper disable CppConstParameterInDeclaration
    template<class Archive> void load(Archive& archive, uint32_t const version);
    template<class Archive> void save(Archive& archive, uint32_t const version) const;
@@ -249,7 +326,8 @@ class ControlsModel {
    {
       try {
          return all_controls_.at(mm.channel)
-             .ControllerToPlugin(mm.message_type_byte, mm.number, mm.value);
+             .ControllerToPlugin(
+                 mm.message_type_byte, mm.number, mm.value, mm.device, mm.time, mm.fraction);
       }
       catch (const std::exception& e) {
          rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -261,7 +339,7 @@ class ControlsModel {
    {
       try {
          return all_controls_.at(mm.channel)
-             .MeasureChange(mm.message_type_byte, mm.number, mm.value);
+             .MeasureChange(mm.message_type_byte, mm.number, mm.value, mm.device);
       }
       catch (const std::exception& e) {
          rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -271,7 +349,8 @@ class ControlsModel {
    short SetToCenter(const rsj::MidiMessage& mm)
    {
       try {
-         return all_controls_.at(mm.channel).SetToCenter(mm.message_type_byte, mm.number);
+         return all_controls_.at(mm.channel)
+             .SetToCenter(mm.message_type_byte, mm.number, mm.device);
       }
       catch (const std::exception& e) {
          rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -290,6 +369,17 @@ class ControlsModel {
       }
    }
 
+   [[nodiscard]] short GetCcAcceleration(size_t channel, short controlnumber) const
+   {
+      try {
+         return all_controls_.at(channel).GetCcAcceleration(controlnumber);
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+
    [[nodiscard]] short GetCcMax(size_t channel, short controlnumber) const
    {
       try {
@@ -334,10 +424,12 @@ class ControlsModel {
       }
    }
 
-   short PluginToController(short controltype, size_t channel, short controlnumber, double value)
+   short PluginToController(short controltype, size_t channel, short controlnumber, double value,
+       short device = rsj::kAnyDevice)
    {
       try {
-         return all_controls_.at(channel).PluginToController(controltype, controlnumber, value);
+         return all_controls_.at(channel).PluginToController(
+             controltype, controlnumber, value, device);
       }
       catch (const std::exception& e) {
          rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -345,10 +437,11 @@ class ControlsModel {
       }
    }
 
-   short MeasureChange(short controltype, size_t channel, short controlnumber, short value)
+   short MeasureChange(
+       short controltype, size_t channel, short controlnumber, short value, short device)
    {
       try {
-         return all_controls_.at(channel).MeasureChange(controltype, controlnumber, value);
+         return all_controls_.at(channel).MeasureChange(controltype, controlnumber, value, device);
       }
       catch (const std::exception& e) {
          rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -366,11 +459,11 @@ class ControlsModel {
          throw;
       }
    }
-   void SetCcAll(
-       size_t channel, short controlnumber, short min, short max, rsj::CCmethod controltype)
+   void SetCcAll(size_t channel, short controlnumber, short min, short max,
+       rsj::CCmethod controltype, short acceleration)
    {
       try {
-         all_controls_.at(channel).SetCcAll(controlnumber, min, max, controltype);
+         all_controls_.at(channel).SetCcAll(controlnumber, min, max, controltype, acceleration);
       }
       catch (const std::exception& e) {
          rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -400,6 +493,17 @@ class ControlsModel {
       }
    }
 
+   void SetCcAcceleration(size_t channel, short controlnumber, short value)
+   {
+      try {
+         all_controls_.at(channel).SetCcAcceleration(controlnumber, value);
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+
    void SetCcMin(size_t channel, short controlnumber, short value)
    {
       try {
@@ -411,6 +515,42 @@ class ControlsModel {
       }
    }
 
+   // safe to call from the MIDI input callbacks
+   [[nodiscard]] bool IsCc14Bit(size_t channel, short controlnumber) const
+   {
+      try {
+         return all_controls_.at(channel).IsCc14Bit(controlnumber);
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+
+   // see ChannelModel::OpenDevice
+   void OpenDevice(short device)
+   {
+      try {
+         for (auto& channel : all_controls_)
+            channel.OpenDevice(device);
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+
+   void SetCc14Bit(size_t channel, short controlnumber, bool value)
+   {
+      try {
+         all_controls_.at(channel).SetCc14Bit(controlnumber, value);
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+
    void SetPwMax(size_t channel, short value)
    {
       try {
@@ -459,6 +599,12 @@ template<class Archive> void ChannelModel::load(Archive& archive, uint32_t const
              cereal::make_nvp("PWmin", pitch_wheel_min_));
          SavedToActive();
          break;
+      case 4:
+         archive(settings_to_save_, cereal::make_nvp("PWmax", pitch_wheel_max_),
+             cereal::make_nvp("PWmin", pitch_wheel_min_),
+             cereal::make_nvp("CC14bit", cc_14bit_to_save_));
+         SavedToActive();
+         break;
       default:
          rsj::LogAndAlertError(
              "Wrong archive version for ChannelModel. Version is " + juce::String(version) + '.');
@@ -486,6 +632,12 @@ template<class Archive> void ChannelModel::save(Archive& archive, uint32_t const
          archive(settings_to_save_, cereal::make_nvp("PWmax", pitch_wheel_max_),
              cereal::make_nvp("PWmin", pitch_wheel_min_));
          break;
+      case 4:
+         ActiveToSaved();
+         archive(settings_to_save_, cereal::make_nvp("PWmax", pitch_wheel_max_),
+             cereal::make_nvp("PWmin", pitch_wheel_min_),
+             cereal::make_nvp("CC14bit", cc_14bit_to_save_));
+         break;
       default:
          rsj::LogAndAlertError(
              "Wrong archive version specified for saving ChannelModel. Version is "
@@ -499,8 +651,8 @@ template<class Archive> void ChannelModel::save(Archive& archive, uint32_t const
 }
 #pragma warning(push)
 #pragma warning(disable : 26440 26444)
-CEREAL_CLASS_VERSION(ChannelModel, 3)
+CEREAL_CLASS_VERSION(ChannelModel, 4)
 CEREAL_CLASS_VERSION(ControlsModel, 1)
-CEREAL_CLASS_VERSION(rsj::SettingsStruct, 1)
+CEREAL_CLASS_VERSION(rsj::SettingsStruct, 2)
 #pragma warning(pop)
 #endif
\ No newline at end of file
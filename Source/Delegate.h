@@ -0,0 +1,103 @@
+#ifndef MIDI2LR_DELEGATE_H_INCLUDED
+#define MIDI2LR_DELEGATE_H_INCLUDED
+/*
+==============================================================================
+
+Delegate.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+namespace rsj {
+   // Object pointer plus a per-member-function stub. The member function is a template argument,
+   // so the stub calls it directly (and can inline it); unlike std::function + std::bind there is
+   // no heap allocation and no type erasure beyond one function pointer.
+   template<typename Signature> class Delegate;
+
+   template<typename R, typename... Args> class Delegate<R(Args...)> {
+    public:
+      constexpr Delegate() noexcept = default;
+      template<auto MemFn, class T>[[nodiscard]] static Delegate Bind(T* object) noexcept
+      {
+         Delegate d;
+         d.object_ = object;
+         d.stub_ = &Stub<T, MemFn>;
+         return d;
+      }
+      R operator()(Args... args) const
+      {
+         return stub_(object_, std::forward<Args>(args)...);
+      }
+      explicit operator bool() const noexcept
+      {
+         return stub_ != nullptr;
+      }
+
+    private:
+      template<class T, auto MemFn> static R Stub(void* object, Args... args)
+      {
+         return (static_cast<T*>(object)->*MemFn)(std::forward<Args>(args)...);
+      }
+      void* object_{nullptr};
+      R (*stub_)(void*, Args...){nullptr};
+   };
+
+   // Fixed-capacity list of delegates. Listeners may be added while another thread is calling
+   // them, e.g. MainContentComponent::Init adds one after MidiReceiver::Start: each delegate is
+   // stored before the count that publishes it, so no locking is done. Add from one thread only;
+   // listeners are never removed.
+   template<typename Signature, std::size_t Capacity = 4> class ListenerRegistry {
+    public:
+      using delegate_type = Delegate<Signature>;
+      template<auto MemFn, class T> void Add(T* object)
+      {
+         if (!object) // only store non-empty listeners
+            return;
+         const auto size = size_.load(std::memory_order_relaxed);
+         if (size == Capacity)
+            throw std::length_error("ListenerRegistry capacity exceeded");
+         listeners_.at(size) = delegate_type::template Bind<MemFn>(object);
+         size_.store(size + 1, std::memory_order_release);
+      }
+      [[nodiscard]] auto begin() const noexcept
+      {
+         return listeners_.cbegin();
+      }
+      // a listener added after this is read is skipped, not half seen
+      [[nodiscard]] auto end() const noexcept
+      {
+         return listeners_.cbegin() + size_.load(std::memory_order_acquire);
+      }
+      [[nodiscard]] bool empty() const noexcept
+      {
+         return size_.load(std::memory_order_acquire) == 0;
+      }
+      [[nodiscard]] std::size_t size() const noexcept
+      {
+         return size_.load(std::memory_order_acquire);
+      }
+
+    private:
+      std::array<delegate_type, Capacity> listeners_{};
+      std::atomic<std::size_t> size_{0};
+   };
+} // namespace rsj
+#endif
@@ -0,0 +1,361 @@
+/*
+==============================================================================
+
+Executor.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "Executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include "WinDef.h"
+#undef NOKERNEL
+#include <Windows.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <semaphore.h>
+#endif
+
+#include <gsl/gsl>
+#include "Misc.h"
+
+struct rsj::WorkerState {
+   std::string name;
+   std::atomic<bool> stop{false};
+   std::atomic<bool> done{false};
+   std::function<void()> wake;
+   std::mutex mutex{}; // for WaitFor
+   std::condition_variable condition{};
+   std::mutex join_mutex{}; // so only one caller joins
+   std::thread thread{};
+};
+
+struct rsj::SemaphoreState {
+#ifdef _WIN32
+   HANDLE semaphore{nullptr};
+#elif defined(__APPLE__)
+   dispatch_semaphore_t semaphore{nullptr};
+#else
+   sem_t semaphore{};
+#endif
+};
+
+namespace {
+   // juce::Thread priorities, 0 to 10 with 5 normal. Above normal is SCHED_RR on POSIX systems
+   constexpr int kElevatedPriority{8};
+   constexpr int kRealtimePriority{10};
+   constexpr int kAffinityBits{32}; // juce::Thread takes a 32-bit mask
+
+   void SetUpThisThread(const rsj::ThreadOptions& options)
+   {
+      juce::Thread::setCurrentThreadName(options.name);
+      if (options.cpu >= 0 && options.cpu < kAffinityBits)
+         juce::Thread::setCurrentThreadAffinityMask(1u << options.cpu);
+      switch (options.priority) {
+      case rsj::ThreadPriority::kNormal:
+         break;
+      case rsj::ThreadPriority::kRealtime:
+         if (juce::Thread::setCurrentThreadPriority(kRealtimePriority))
+            break;
+         [[fallthrough]];
+      case rsj::ThreadPriority::kElevated:
+         if (!juce::Thread::setCurrentThreadPriority(kElevatedPriority))
+            rsj::Log("Thread " + juce::String(options.name) + " left at normal priority");
+         break;
+      }
+   }
+} // namespace
+
+rsj::Semaphore::Semaphore() : state_{std::make_unique<SemaphoreState>()}
+{
+#ifdef _WIN32
+   state_->semaphore = CreateSemaphoreW(nullptr, 0, MAXLONG, nullptr);
+   if (!state_->semaphore)
+#elif defined(__APPLE__)
+   state_->semaphore = dispatch_semaphore_create(0);
+   if (!state_->semaphore)
+#else
+   if (sem_init(&state_->semaphore, 0, 0) != 0)
+#endif
+      throw std::runtime_error("Unable to create a semaphore");
+}
+
+rsj::Semaphore::~Semaphore()
+{
+#ifdef _WIN32
+   CloseHandle(state_->semaphore);
+#elif defined(__APPLE__)
+   dispatch_release(state_->semaphore);
+#else
+   sem_destroy(&state_->semaphore);
+#endif
+}
+
+void rsj::Semaphore::Release() noexcept
+{
+#ifdef _WIN32
+   ReleaseSemaphore(state_->semaphore, 1, nullptr);
+#elif defined(__APPLE__)
+   dispatch_semaphore_signal(state_->semaphore);
+#else
+   sem_post(&state_->semaphore);
+#endif
+}
+
+void rsj::Semaphore::Acquire()
+{
+   try {
+#ifdef _WIN32
+      WaitForSingleObject(state_->semaphore, INFINITE);
+#elif defined(__APPLE__)
+      dispatch_semaphore_wait(state_->semaphore, DISPATCH_TIME_FOREVER);
+#else
+      while (sem_wait(&state_->semaphore) != 0 && errno == EINTR)
+         continue;
+#endif
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool rsj::Semaphore::AcquireUntil(std::chrono::steady_clock::time_point deadline)
+{
+   try {
+      const auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          deadline - std::chrono::steady_clock::now());
+#ifdef _WIN32
+      const auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+      return WaitForSingleObject(
+                 state_->semaphore, gsl::narrow_cast<DWORD>(std::max<decltype(ms)>(ms, 0)))
+             == WAIT_OBJECT_0;
+#elif defined(__APPLE__)
+      return dispatch_semaphore_wait(state_->semaphore,
+                 dispatch_time(DISPATCH_TIME_NOW,
+                     std::max<std::chrono::nanoseconds::rep>(remaining.count(), 0)))
+             == 0;
+#else
+      // sem_timedwait only takes CLOCK_REALTIME, so the steady deadline is carried over to it
+      timespec until{};
+      clock_gettime(CLOCK_REALTIME, &until);
+      const auto ns = std::max<std::chrono::nanoseconds::rep>(remaining.count(), 0) + until.tv_nsec;
+      until.tv_sec += gsl::narrow_cast<time_t>(ns / 1'000'000'000);
+      until.tv_nsec = gsl::narrow_cast<long>(ns % 1'000'000'000);
+      while (sem_timedwait(&state_->semaphore, &until) != 0)
+         if (errno != EINTR)
+            return false;
+      return true;
+#endif
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool rsj::StopToken::StopRequested() const noexcept
+{
+   return state_.stop.load(std::memory_order_acquire);
+}
+
+bool rsj::StopToken::WaitFor(std::chrono::milliseconds duration) const
+{
+   try {
+      auto lock{std::unique_lock(state_.mutex)};
+      return !state_.condition.wait_for(lock, duration, [this] { return StopRequested(); });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+#pragma warning(push)
+#pragma warning(disable : 26447)
+rsj::Worker::~Worker()
+{
+   try {
+      Stop();
+   }
+   catch (const std::exception& e) {
+      rsj::LogAndAlertError(juce::String("Exception in Worker Destructor. ") + e.what());
+      std::terminate();
+   }
+}
+#pragma warning(pop)
+
+rsj::Worker& rsj::Worker::operator=(Worker&& other)
+{
+   try {
+      if (this != &other) {
+         Stop();
+         executor_ = std::exchange(other.executor_, nullptr);
+         state_ = std::move(other.state_);
+      }
+      return *this;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::Worker::RequestStop()
+{
+   try {
+      if (!state_)
+         return;
+      {
+         auto lock{std::scoped_lock(state_->mutex)};
+         state_->stop.store(true, std::memory_order_release);
+      }
+      state_->condition.notify_all();
+      if (state_->wake)
+         state_->wake();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::Worker::Stop()
+{
+   try {
+      if (!state_)
+         return;
+      RequestStop();
+      Executor::Stop(*state_);
+      executor_->Forget(*state_);
+      state_.reset();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool rsj::Worker::Running() const noexcept
+{
+   return state_ && !state_->done.load(std::memory_order_acquire);
+}
+
+#pragma warning(push)
+#pragma warning(disable : 26447)
+rsj::Executor::~Executor()
+{
+   try {
+      StopAll();
+   }
+   catch (const std::exception& e) {
+      rsj::LogAndAlertError(juce::String("Exception in Executor Destructor. ") + e.what());
+      std::terminate();
+   }
+}
+#pragma warning(pop)
+
+rsj::Worker rsj::Executor::Spawn(ThreadOptions options,
+    std::function<void(const StopToken&)> body, std::function<void()> wake)
+{
+   try {
+      auto state = std::make_shared<WorkerState>();
+      state->name = options.name;
+      state->wake = std::move(wake);
+      {
+         auto lock{std::scoped_lock(state->join_mutex)};
+         state->thread = std::thread([state, options = std::move(options), body = std::move(body)] {
+            SetUpThisThread(options);
+            try {
+               body(StopToken{*state});
+            }
+            catch (...) { // already logged where it was thrown
+               rsj::Log("Thread " + juce::String(options.name) + " ended by an exception");
+            }
+            state->done.store(true, std::memory_order_release);
+         });
+      }
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         workers_.push_back(state);
+      }
+      return Worker{*this, std::move(state)};
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::Executor::StopAll()
+{
+   try {
+      std::vector<std::shared_ptr<WorkerState>> running{};
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         running.swap(workers_);
+      }
+      for (auto it = running.rbegin(); it != running.rend(); ++it) {
+         auto& state = **it;
+         if (!state.done.load(std::memory_order_acquire))
+            rsj::Log("Stopping thread " + juce::String(state.name) + " left running");
+         Worker{*this, *it}.Stop();
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::Executor::Stop(WorkerState& state)
+{
+   try {
+      // the lock makes a second caller wait until the first has joined
+      auto lock{std::scoped_lock(state.join_mutex)};
+      if (state.thread.joinable())
+         state.thread.join();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj::Executor", __func__, e);
+      throw;
+   }
+}
+
+void rsj::Executor::Forget(const WorkerState& state)
+{
+   try {
+      auto lock{std::scoped_lock(mutex_)};
+      workers_.erase(std::remove_if(workers_.begin(), workers_.end(),
+                         [&state](const auto& w) { return w.get() == &state; }),
+          workers_.end());
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
@@ -0,0 +1,133 @@
+#ifndef MIDI2LR_EXECUTOR_H_INCLUDED
+#define MIDI2LR_EXECUTOR_H_INCLUDED
+/*
+==============================================================================
+
+Executor.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The threads of the MIDI to Lightroom pipeline. Each is started by the one Executor, which names
+// it, sets its priority and, if asked, the core it runs on, and stops whatever is still running
+// when it's destroyed. A thread's body is handed a StopToken and returns once it sees a stop
+// request; a body blocked on its own condition variable or socket is woken by the wake function
+// given to Spawn, which is called after the request is made.
+namespace rsj {
+   enum class ThreadPriority {
+      kNormal,
+      kElevated, // above other threads of the program, where the OS allows it
+      kRealtime  // real-time scheduling where the OS allows it, else kElevated
+   };
+
+   struct ThreadOptions {
+      std::string name;
+      ThreadPriority priority{ThreadPriority::kNormal};
+      int cpu{-1}; // the only core the thread may run on, -1 leaves it to the OS
+   };
+
+   struct WorkerState;
+
+   class StopToken {
+    public:
+      explicit StopToken(WorkerState& state) noexcept : state_{state} {}
+      [[nodiscard]] bool StopRequested() const noexcept;
+      // sleeps for duration or until a stop request. false if stopped
+      bool WaitFor(std::chrono::milliseconds duration) const;
+
+    private:
+      WorkerState& state_;
+   };
+
+   struct SemaphoreState;
+
+   // a count one thread sleeps on until others add to it. Release is the OS semaphore's post and
+   // never takes a lock, so a device callback may call it
+   class Semaphore {
+    public:
+      Semaphore();
+      ~Semaphore();
+      Semaphore(const Semaphore& other) = delete;
+      Semaphore(Semaphore&& other) = delete;
+      Semaphore& operator=(const Semaphore& other) = delete;
+      Semaphore& operator=(Semaphore&& other) = delete;
+      void Release() noexcept;
+      void Acquire();
+      // false if deadline passed first, leaving the count alone
+      bool AcquireUntil(std::chrono::steady_clock::time_point deadline);
+
+    private:
+      std::unique_ptr<SemaphoreState> state_;
+   };
+
+   class Executor;
+
+   // one thread started by Executor::Spawn. Destroying or reassigning it stops the thread, so a
+   // body may use the members of the object that holds its Worker
+   class Worker {
+    public:
+      Worker() noexcept = default;
+      ~Worker();
+      Worker(const Worker& other) = delete;
+      Worker(Worker&& other) noexcept = default;
+      Worker& operator=(const Worker& other) = delete;
+      Worker& operator=(Worker&& other);
+      // doesn't wait for the thread to return
+      void RequestStop();
+      // requests a stop and joins the thread. Not from the thread itself
+      void Stop();
+      // started and its body hasn't returned
+      [[nodiscard]] bool Running() const noexcept;
+
+    private:
+      friend class Executor;
+      Worker(Executor& executor, std::shared_ptr<WorkerState> state) noexcept
+          : executor_{&executor}, state_{std::move(state)}
+      {
+      }
+      Executor* executor_{nullptr};
+      std::shared_ptr<WorkerState> state_{};
+   };
+
+   class Executor {
+    public:
+      Executor() = default;
+      ~Executor();
+      Executor(const Executor& other) = delete;
+      Executor(Executor&& other) = delete;
+      Executor& operator=(const Executor& other) = delete;
+      Executor& operator=(Executor&& other) = delete;
+      [[nodiscard]] Worker Spawn(ThreadOptions options,
+          std::function<void(const StopToken&)> body, std::function<void()> wake = {});
+      // stops every thread still running, newest first, and joins them
+      void StopAll();
+
+    private:
+      friend class Worker;
+      static void Stop(WorkerState& state);
+      void Forget(const WorkerState& state);
+      std::mutex mutex_{};
+      std::vector<std::shared_ptr<WorkerState>> workers_{};
+   };
+} // namespace rsj
+
+#endif // MIDI2LR_EXECUTOR_H_INCLUDED
@@ -0,0 +1,196 @@
+/*
+==============================================================================
+
+GestureFilter.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "GestureFilter.h"
+
+#include <exception>
+
+#include <gsl/gsl>
+#include "Misc.h"
+
+namespace {
+   constexpr short kGestureValue{0x7F}; // gestures are sent as a full press
+
+   [[nodiscard]] rsj::MidiMessage Gesture(
+       short type, const rsj::MidiMessage& press, short number, rsj::MidiTime time) noexcept
+   {
+      rsj::MidiMessage gesture{type, press.channel, number, kGestureValue, time};
+      gesture.device = press.device;
+      return gesture;
+   }
+} // namespace
+
+void GestureFilter::Process(std::vector<rsj::MidiMessage>& messages, const Profile* profile)
+{
+   try {
+      out_.clear();
+      for (const auto& message : messages) {
+         Expire(message.time, out_);
+         if (message.message_type_byte == rsj::kNoteOnFlag && message.value > 0)
+            Press(message, profile, out_);
+         else if (message.message_type_byte == rsj::kNoteOnFlag
+                  || message.message_type_byte == rsj::kNoteOffFlag)
+            Release(message, out_);
+         else
+            out_.push_back(message);
+      }
+      messages.swap(out_);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void GestureFilter::Expire(rsj::MidiTime now, std::vector<rsj::MidiMessage>& out)
+{
+   try {
+      timers_.Advance(now, [this, now, &out](Timer&& timer) {
+         const auto found = buttons_.find(timer.key);
+         if (found == buttons_.end() || found->second.generation != timer.generation)
+            return;
+         auto& button = found->second;
+         if (button.stage == Stage::kReleased) { // no second tap
+            out.push_back(button.press);
+            buttons_.erase(found);
+            return;
+         }
+         if (button.stage != Stage::kHeld)
+            return;
+         // still held after the chord window, or for a long press
+         button.gestures.chord_partners.reset();
+         if (button.gestures.long_press && now - button.press.time >= kLongPress) {
+            out.push_back(
+                Gesture(rsj::kLongPressFlag, button.press, button.press.number, now));
+            button.stage = Stage::kDone;
+         }
+         else if (button.gestures.long_press)
+            Schedule(timer.key, button, button.press.time + kLongPress);
+         else if (!button.gestures.double_tap) {
+            out.push_back(button.press);
+            button.stage = Stage::kDone;
+         }
+         // a double tap candidate waits for its release
+      });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void GestureFilter::Press(
+    const rsj::MidiMessage& message, const Profile* profile, std::vector<rsj::MidiMessage>& out)
+{
+   try {
+      const auto key = KeyOf(message, message.number);
+      if (const auto found = buttons_.find(key); found != buttons_.end()) {
+         auto& button = found->second;
+         if (button.stage == Stage::kReleased) {
+            out.push_back(
+                Gesture(rsj::kDoubleTapFlag, button.press, message.number, message.time));
+            button.stage = Stage::kDone;
+            button.generation = 0;
+            return;
+         }
+         // pressed again without a release in between, the note off was lost
+         if (button.stage == Stage::kHeld)
+            out.push_back(button.press);
+         buttons_.erase(found);
+      }
+      if (!profile || message.number > 0x7F) {
+         out.push_back(message);
+         return;
+      }
+      const auto gestures = profile->GesturesFor(
+          {message.channel + 1, message.number, rsj::MsgIdEnum::kNote, message.device});
+      if (!gestures.Any()) {
+         out.push_back(message);
+         return;
+      }
+      for (short partner = 0; partner <= 0x7F; ++partner) {
+         if (!gestures.chord_partners.test(gsl::narrow_cast<size_t>(partner)))
+            continue;
+         const auto other = buttons_.find(KeyOf(message, partner));
+         if (other == buttons_.end() || other->second.stage != Stage::kHeld
+             || !other->second.gestures.chord_partners.test(
+                 gsl::narrow_cast<size_t>(message.number))
+             || message.time - other->second.press.time > kChord)
+            continue;
+         out.push_back(Gesture(rsj::kChordFlag, message,
+             rsj::ChordNumber(message.number, partner), message.time));
+         other->second.stage = Stage::kDone;
+         other->second.generation = 0;
+         buttons_[key] = {gestures, message, Stage::kDone};
+         return;
+      }
+      auto& button = buttons_[key];
+      button = {gestures, message, Stage::kHeld};
+      if (gestures.chord_partners.any())
+         Schedule(key, button, message.time + kChord);
+      else if (gestures.long_press)
+         Schedule(key, button, message.time + kLongPress);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void GestureFilter::Release(const rsj::MidiMessage& message, std::vector<rsj::MidiMessage>& out)
+{
+   try {
+      const auto found = buttons_.find(KeyOf(message, message.number));
+      if (found == buttons_.end()) {
+         if (message.message_type_byte == rsj::kNoteOnFlag) // as before gestures were added
+            out.push_back(message);
+         return;
+      }
+      auto& button = found->second;
+      if (button.stage == Stage::kHeld && button.gestures.double_tap) {
+         button.stage = Stage::kReleased;
+         Schedule(found->first, button, message.time + kDoubleTap);
+         return;
+      }
+      if (button.stage == Stage::kHeld) // short press
+         out.push_back(button.press);
+      if (button.stage != Stage::kReleased)
+         buttons_.erase(found);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void GestureFilter::Schedule(int key, Button& button, rsj::MidiTime due)
+{
+   try {
+      // numbered across buttons, so a stale timer can't match a button that replaced its own
+      button.generation = ++last_generation_;
+      if (button.generation == 0) // wrapped
+         button.generation = ++last_generation_;
+      timers_.Schedule(due, {key, button.generation});
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
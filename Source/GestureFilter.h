@@ -0,0 +1,86 @@
+#ifndef MIDI2LR_GESTUREFILTER_H_INCLUDED
+#define MIDI2LR_GESTUREFILTER_H_INCLUDED
+/*
+==============================================================================
+
+GestureFilter.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <chrono>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "MidiUtilities.h"
+#include "Profile.h"
+#include "TimerWheel.h"
+
+class GestureFilter {
+   // Turns presses of MIDI note buttons into long presses, double taps and two-note chords, so
+   // one button can carry several commands. Only a note with a gesture mapped in the profile is
+   // held back, and only for as long as it takes to tell its gestures apart:
+   //    long press: held for kLongPress. Released sooner, the press is sent on release.
+   //    double tap: pressed again within kDoubleTap of being released. Otherwise the press is
+   //       sent when kDoubleTap runs out.
+   //    chord: pressed within kChord of the other note of a mapped chord, on the same channel
+   //       and device. Otherwise the press goes on as above, or is sent when kChord runs out.
+   // A press that became a gesture is not sent, nor is either press of a chord. Note offs are
+   // used up here; a note on with velocity 0 still goes on for notes that aren't held back. All
+   // pending gestures share one timer wheel, so the only thread involved is the caller's, and
+   // Process and Expire must be called from the same thread: MidiReceiver's dispatch thread.
+ public:
+   static constexpr std::chrono::milliseconds kLongPress{500};
+   static constexpr std::chrono::milliseconds kDoubleTap{300};
+   static constexpr std::chrono::milliseconds kChord{50};
+   // replaces messages with what should be dispatched in their place, after handling any timers
+   // that ran out before each message. profile nullptr passes presses straight on.
+   void Process(std::vector<rsj::MidiMessage>& messages, const Profile* profile);
+   // appends the presses and gestures whose time ran out by now
+   void Expire(rsj::MidiTime now, std::vector<rsj::MidiMessage>& out);
+   // when Expire should next be called, nullopt if nothing is pending
+   [[nodiscard]] std::optional<rsj::MidiTime> NextDue() const
+   {
+      return timers_.NextDue();
+   }
+
+ private:
+   enum class Stage { kHeld, kReleased, kDone };
+   struct Button {
+      Profile::NoteGestures gestures{};
+      rsj::MidiMessage press{}; // sent if no gesture comes of it
+      Stage stage{Stage::kHeld};
+      unsigned generation{0}; // of its pending timer, 0 if none
+   };
+   struct Timer {
+      int key;
+      unsigned generation;
+   };
+   [[nodiscard]] static int KeyOf(const rsj::MidiMessage& message, short note) noexcept
+   {
+      return message.device << 11 | message.channel << 7 | note;
+   }
+   void Press(const rsj::MidiMessage& message, const Profile* profile,
+       std::vector<rsj::MidiMessage>& out);
+   void Release(const rsj::MidiMessage& message, std::vector<rsj::MidiMessage>& out);
+   void Schedule(int key, Button& button, rsj::MidiTime due);
+   unsigned last_generation_{0};
+   std::unordered_map<int, Button> buttons_{}; // buttons held back or waiting for release
+   rsj::TimerWheel<Timer> timers_{};
+   std::vector<rsj::MidiMessage> out_{};
+};
+
+#endif // MIDI2LR_GESTUREFILTER_H_INCLUDED
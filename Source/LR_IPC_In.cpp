@@ -22,6 +22,8 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <deque>
 #include <exception>
 #include <string_view>
 
@@ -35,22 +37,34 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "SendKeys.h"
 
 namespace {
-   constexpr auto kHost = "127.0.0.1";
-   constexpr auto kTerminate{"MBxegp3VXilFy0"};
    constexpr int kBufferSize = 1024;
-   constexpr int kConnectTryTime = 100;
-   constexpr int kEmptyWait = 100;
    constexpr int kLrInPort = 58764;
-   constexpr int kNotConnectedWait = 333;
-   constexpr int kReadyWait = 1000;
-   constexpr int kStopWait = 1000;
-   constexpr int kConnectTimer = 1000;
+   // lines waiting for ProcessLine. When full, a parameter value replaces the queued value for
+   // the same parameter; anything else stays unread in the socket until ProcessLine makes room
+   constexpr std::size_t kLineCapacity{4096};
+
+   [[nodiscard]] std::string_view CommandOf(std::string_view line) noexcept
+   {
+      line.remove_prefix(std::min(line.find_first_not_of(" \t\n"), line.size()));
+      return line.substr(0, line.find_first_of(" \t\n"));
+   }
+
+   bool SameParameter(const std::string& queued, const std::string& pushed)
+   {
+      const auto command = CommandOf(pushed);
+      return command != "SwitchProfile" && command != "SendKey"
+             && command != "TerminateApplication" && command == CommandOf(queued);
+   }
 } // namespace
 
 LrIpcIn::LrIpcIn(ControlsModel& c_model, ProfileManager& profile_manager, Profile& profile,
-    std::shared_ptr<MidiSender> midi_sender)
-    : juce::Thread{"LR_IPC_IN"}, profile_{profile}, controls_model_{c_model},
-      profile_manager_{profile_manager}, midi_sender_{std::move(midi_sender)}
+    std::shared_ptr<MidiSender> midi_sender, rsj::Executor& executor, rsj::Reactor& reactor)
+    : line_{kLineCapacity, rsj::Overflow::kCoalesce, SameParameter}, profile_{profile},
+      controls_model_{c_model}, profile_manager_{profile_manager},
+      midi_sender_{std::move(midi_sender)}, executor_{executor},
+      socket_{reactor, kLrInPort,
+          {[this] { partial_line_.clear(); }, [this](juce::StreamingSocket& s) { return Read(s); },
+              {}, [this] { return QueueLines() || WantRoom(); }}}
 {
 }
 
@@ -59,16 +73,12 @@ LrIpcIn::LrIpcIn(ControlsModel& c_model, ProfileManager& profile_manager, Profil
 LrIpcIn::~LrIpcIn()
 {
    try {
-      {
-         auto lock = std::scoped_lock(timer_mutex_);
-         timer_off_ = true;
-         juce::Timer::stopTimer();
-      }
-      if (!juce::Thread::stopThread(kStopWait))
-         rsj::Log("stopThread failed in LrIpcIn destructor");
-      if (const auto m = line_.clear_count_emplace(kTerminate))
+      socket_.Stop();
+      process_worker_.Stop(); // closes line_
+      if (const auto m = line_.clear_count())
          rsj::Log(juce::String(m) + " left in queue in LrIpcIn destructor");
-      socket_.close();
+      rsj::Log("LrIpcIn queue high water " + juce::String(line_.high_water()) + ", replaced "
+               + juce::String(line_.dropped()));
    }
    catch (...) {
       rsj::LogAndAlertError("Exception thrown in LrIpcIn destructor.");
@@ -80,9 +90,9 @@ LrIpcIn::~LrIpcIn()
 void LrIpcIn::Start()
 {
    try {
-      // start the timer
-      juce::Timer::startTimer(kConnectTimer);
-      process_line_future_ = std::async(std::launch::async, &LrIpcIn::ProcessLine, this);
+      process_worker_ = executor_.Spawn({"LR_IPC_IN lines", rsj::ThreadPriority::kElevated},
+          [this](const rsj::StopToken& stop) { ProcessLine(stop); }, [this] { line_.close(); });
+      socket_.Start();
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -93,8 +103,7 @@ void LrIpcIn::Start()
 void LrIpcIn::PleaseStopThread()
 {
    try {
-      juce::Thread::signalThreadShouldExit();
-      juce::Thread::notify();
+      socket_.Stop();
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -102,72 +111,25 @@ void LrIpcIn::PleaseStopThread()
    }
 }
 
-void LrIpcIn::run()
+bool LrIpcIn::Read(juce::StreamingSocket& socket)
 {
    try {
-      auto _ = gsl::finally([this] {
-         auto lock = std::scoped_lock(timer_mutex_);
-         timer_off_ = true;
-         juce::Timer::stopTimer();
-      });
-      while (!juce::Thread::threadShouldExit()) {
-         std::array<char, kBufferSize> line{}; // zero filled by {} initialization
-         // if not connected, executes a wait 333 then goes back to while. if connected, tries to
-         // read a line, checks thread status and connection status before each read attempt.
-         // Doesn't terminate thread if disconnected, as currently don't have graceful way to
-         // restart thread.
-         if (!socket_.isConnected()) {
-            // ReSharper disable once CppExpressionWithoutSideEffects
-            juce::Thread::wait(kNotConnectedWait);
-         } // end if (is not connected)
-         else {
-            line.fill(0); // zero out buffer
-            auto size_read = 0;
-            // parse input until we have a line, then process that line, quit if connection lost
-            while ((size_read == 0 || line.at(gsl::narrow_cast<size_t>(size_read) - 1) != '\n')
-                   && socket_.isConnected()) {
-               if (juce::Thread::threadShouldExit())
-                  return; // after final action
-               const auto wait_status = socket_.waitUntilReady(true, kReadyWait);
-               switch (wait_status) {
-               case -1:
-#pragma warning(suppress : 26438)
-                  goto dumpLine; // read line failed, break out of switch and while
-               case 0:
-                  // ReSharper disable once CppExpressionWithoutSideEffects
-                  juce::Thread::wait(kEmptyWait);
-                  break; // try again to read until char shows up
-               case 1:
-                  switch (socket_.read(&line.at(size_read), 1, false)) {
-                  case -1:
-#pragma warning(suppress : 26438)
-                     goto dumpLine; // read error
-                  case 1:
-                     size_read++;
-                     break;
-                  case 0:
-                     // waitUntilReady returns 1 but read will is 0: it's an indication of a broken
-                     // socket.
-                     juce::JUCEApplication::getInstance()->systemRequestedQuit();
-                     break;
-                  default:
-                     Ensures(!"Unexpected value for read status");
-                  }
-                  break;
-               default:
-                  Ensures(!"Unexpected value for wait_status");
-               }
-            } // end while !\n and is connected
-            // if lose connection, line may not be terminated
-            {
-               std::string param{line.data()};
-               if (param.back() == '\n') {
-                  line_.push(std::move(param));
-               }
-            } // scope param
-         dumpLine: /* empty statement */;
-         } // end else (is connected)
-      }    // while not threadshouldexit, finally handles exit code
+      std::array<char, kBufferSize> buffer{};
+      const auto size_read = socket.read(buffer.data(), kBufferSize, false);
+      if (size_read == 0) {
+         // the socket was ready but had nothing: the plugin closed it, so Lightroom is gone
+         juce::JUCEApplication::getInstance()->systemRequestedQuit();
+         return false;
+      }
+      if (size_read < 0)
+         return false; // read failed, reconnect
+      partial_line_.append(buffer.data(), gsl::narrow_cast<size_t>(size_read));
+      if (!QueueLines()) { // never wait here: the reactor serves the other sockets too
+         socket_.PauseReading();
+         if (WantRoom())
+            socket_.ResumeReading();
+      }
+      return true;
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -175,17 +137,31 @@ void LrIpcIn::run()
    }
 }
 
-void LrIpcIn::timerCallback()
+bool LrIpcIn::QueueLines()
 {
    try {
-      auto lock = std::scoped_lock(timer_mutex_);
-      if (!timer_off_ && !socket_.isConnected() && !juce::Thread::threadShouldExit()) {
-         if (socket_.connect(kHost, kLrInPort, kConnectTryTime))
-            if (!thread_started_) {
-               juce::Thread::startThread(); // avoid starting thread during shutdown
-               thread_started_ = true;
-            }
+      // lines keep their \n
+      for (auto end = partial_line_.find('\n'); end != std::string::npos;
+           end = partial_line_.find('\n')) {
+         if (!line_.try_push(partial_line_.substr(0, end + 1)))
+            return false;
+         partial_line_.erase(0, end + 1);
       }
+      return true;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool LrIpcIn::WantRoom()
+{
+   try {
+      // set before trying again: either the try finds room or line_ is full and its next pop,
+      // which ProcessLine follows by reading the flag, is yet to come
+      room_wanted_.store(true);
+      return QueueLines();
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -202,101 +178,122 @@ namespace {
    }
 } // namespace
 
-void LrIpcIn::ProcessLine()
+void LrIpcIn::ProcessLine(const rsj::StopToken& stop)
 {
    using namespace std::literals::string_literals;
    try {
       const static std::unordered_map<std::string, int> kCmds = {
           {"SwitchProfile"s, 1}, {"SendKey"s, 2}, {"TerminateApplication"s, 3}};
-      do {
-         // process input into [parameter] [Value]
-         std::string line_copy{line_.pop()};
-         if (line_copy == kTerminate)
-            return;
-         std::string_view v{line_copy};
-         Trim(v);
-         auto value_string{v.substr(v.find_first_of(" \t\n") + 1)};
-         value_string.remove_prefix(
-             std::min(value_string.find_first_not_of(" \t\n"), value_string.size()));
-         const auto command{std::string(
-             v.substr(0, v.find_first_of(" \t\n")))}; // use this a lot, so convert to string once
-
-         switch (kCmds.count(command) ? kCmds.at(command) : 0) {
-         case 1: // SwitchProfile
-            profile_manager_.SwitchToProfile(std::string(value_string));
-            break;
-         case 2: // SendKey
-         {
-            const auto modifiers = std::stoi(std::string(value_string));
-            // trim twice on purpose: first digit, then space, as key may be digit
+      std::deque<std::string> lines{};
+      // everything queued, one lock acquisition
+      while (!stop.StopRequested() && line_.pop_all(lines)) {
+         if (room_wanted_.exchange(false))
+            socket_.ResumeReading();
+         for (const auto& line_copy : lines) {
+            // process input into [parameter] [Value]
+            std::string_view v{line_copy};
+            Trim(v);
+            auto value_string{v.substr(v.find_first_of(" \t\n") + 1)};
             value_string.remove_prefix(
-                std::min(value_string.find_first_not_of("0123456789"), value_string.size()));
-            value_string.remove_prefix(1); // one space between number and character
-            if (value_string.empty()) {
-               rsj::LogAndAlertError(
-                   "SendKey couldn't identify keystroke. Message from plugin was \""
-                   + juce::String(rsj::ReplaceInvisibleChars(line_copy)) + "\".");
+                std::min(value_string.find_first_not_of(" \t\n"), value_string.size()));
+            // use this a lot, so convert to string once
+            const auto command{std::string(v.substr(0, v.find_first_of(" \t\n")))};
+
+            switch (kCmds.count(command) ? kCmds.at(command) : 0) {
+            case 1: // SwitchProfile
+               profile_manager_.SwitchToProfile(std::string(value_string));
+               break;
+            case 2: // SendKey
+            {
+               const auto modifiers = std::stoi(std::string(value_string));
+               // trim twice on purpose: first digit, then space, as key may be digit
+               value_string.remove_prefix(
+                   std::min(value_string.find_first_not_of("0123456789"), value_string.size()));
+               value_string.remove_prefix(1); // one space between number and character
+               if (value_string.empty()) {
+                  rsj::LogAndAlertError(
+                      "SendKey couldn't identify keystroke. Message from plugin was \""
+                      + juce::String(rsj::ReplaceInvisibleChars(line_copy)) + "\".");
+                  break;
+               }
+               rsj::ActiveModifiers am;
+               if (modifiers & 0x1)
+                  am.alt_opt = true;
+               if (modifiers & 0x2)
+                  am.control = true;
+               if (modifiers & 0x4)
+                  am.shift = true;
+               if (modifiers & 0x8)
+                  am.command = true;
+               rsj::SendKeyDownUp(std::string(value_string), am);
                break;
             }
-            rsj::ActiveModifiers am;
-            if (modifiers & 0x1)
-               am.alt_opt = true;
-            if (modifiers & 0x2)
-               am.control = true;
-            if (modifiers & 0x4)
-               am.shift = true;
-            if (modifiers & 0x8)
-               am.command = true;
-            rsj::SendKeyDownUp(std::string(value_string), am);
-            break;
-         }
-         case 3: // TerminateApplication
-            juce::JUCEApplication::getInstance()->systemRequestedQuit();
-            return;
-         case 0:
-            // send associated messages to MIDI OUT devices
-            if (midi_sender_) {
-               const auto original_value = std::stod(std::string(value_string));
-               for (const auto& msg : profile_.GetMessagesForCommand(command)) {
-                  short msgtype{0};
-                  switch (msg.msg_id_type) {
-                  case rsj::MsgIdEnum::kNote:
-                     msgtype = rsj::kNoteOnFlag;
-                     break;
-                  case rsj::MsgIdEnum::kCc:
-                     msgtype = rsj::kCcFlag;
-                     break;
-                  case rsj::MsgIdEnum::kPitchBend:
-                     msgtype = rsj::kPwFlag;
-                  }
-                  const auto value = controls_model_.PluginToController(msgtype,
-                      gsl::narrow_cast<size_t>(msg.channel - 1), gsl::narrow_cast<short>(msg.data),
-                      original_value);
-                  if (midi_sender_) {
-                     switch (msgtype) {
-                     case rsj::kNoteOnFlag:
-                        midi_sender_->SendNoteOn(msg.channel, msg.data, value);
+            case 3: // TerminateApplication
+               juce::JUCEApplication::getInstance()->systemRequestedQuit();
+               return;
+            case 0:
+               // send associated messages to MIDI OUT devices
+               if (midi_sender_) {
+                  const auto original_value = std::stod(std::string(value_string));
+                  for (const auto& msg : profile_.GetMessagesForCommand(command)) {
+                     if (msg.device >= gsl::narrow_cast<int>(rsj::kMaxInputDevices))
+                        continue; // the row's device isn't open, it has no control positions
+                     short msgtype{0};
+                     switch (msg.msg_id_type) {
+                     case rsj::MsgIdEnum::kNote:
+                        msgtype = rsj::kNoteOnFlag;
                         break;
-                     case rsj::kCcFlag:
-                        if (controls_model_.GetCcMethod(gsl::narrow_cast<size_t>(msg.channel - 1),
-                                gsl::narrow_cast<short>(msg.data))
-                            == rsj::CCmethod::kAbsolute)
-                           midi_sender_->SendCc(msg.channel, msg.data, value);
+                     case rsj::MsgIdEnum::kCc:
+                        msgtype = rsj::kCcFlag;
                         break;
-                     case rsj::kPwFlag:
-                        midi_sender_->SendPitchWheel(msg.channel, value);
+                     case rsj::MsgIdEnum::kPitchBend:
+                        msgtype = rsj::kPwFlag;
                         break;
-                     default:
-                        Ensures(!"Unexpected result for msgtype");
+                     case rsj::MsgIdEnum::kRpn:
+                        msgtype = rsj::kRpnFlag;
+                        break;
+                     case rsj::MsgIdEnum::kOsc:
+                     case rsj::MsgIdEnum::kLongPress:
+                     case rsj::MsgIdEnum::kDoubleTap:
+                     case rsj::MsgIdEnum::kChord:
+                        continue; // no control of its own to send feedback to
+                     }
+                     const auto value = controls_model_.PluginToController(msgtype,
+                         gsl::narrow_cast<size_t>(msg.channel - 1),
+                         gsl::narrow_cast<short>(msg.data), original_value,
+                         gsl::narrow_cast<short>(msg.device));
+                     if (midi_sender_) {
+                        switch (msgtype) {
+                        case rsj::kNoteOnFlag:
+                           midi_sender_->SendNoteOn(msg.channel, msg.data, value);
+                           break;
+                        case rsj::kCcFlag: {
+                           const auto channel = gsl::narrow_cast<size_t>(msg.channel - 1);
+                           const auto number = gsl::narrow_cast<short>(msg.data);
+                           if (controls_model_.GetCcMethod(channel, number)
+                               == rsj::CCmethod::kAbsolute)
+                              midi_sender_->SendCc(msg.channel, msg.data, value,
+                                  controls_model_.IsCc14Bit(channel, number));
+                           break;
+                        }
+                        case rsj::kPwFlag:
+                           midi_sender_->SendPitchWheel(msg.channel, value);
+                           break;
+                        case rsj::kRpnFlag:
+                           midi_sender_->SendRpn(msg.channel, msg.data, value);
+                           break;
+                        default:
+                           Ensures(!"Unexpected result for msgtype");
+                        }
                      }
                   }
                }
+               break;
+            default:
+               Ensures(!"Unexpected result for cmds");
             }
-            break;
-         default:
-            Ensures(!"Unexpected result for cmds");
          }
-      } while (true);
+      }
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
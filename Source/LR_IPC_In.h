@@ -20,49 +20,55 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
-#include <future>
+#include <atomic>
 #include <memory>
-#include <mutex>
 #include <string>
 
 #include "Concurrency.h"
+#include "Executor.h"
+#include "Reactor.h"
 #include <JuceLibraryCode/JuceHeader.h>
 class ControlsModel;
 class MidiSender;
 class Profile;
 class ProfileManager;
 
-class LrIpcIn final : juce::Timer, juce::Thread {
+class LrIpcIn final {
  public:
    LrIpcIn(ControlsModel& c_model, ProfileManager& profile_manager, Profile& profile,
-       std::shared_ptr<MidiSender> midi_sender);
+       std::shared_ptr<MidiSender> midi_sender, rsj::Executor& executor, rsj::Reactor& reactor);
    ~LrIpcIn();
    LrIpcIn(const LrIpcIn& other) = delete;
    LrIpcIn(LrIpcIn&& other) = delete;
    LrIpcIn& operator=(const LrIpcIn& other) = delete;
    LrIpcIn& operator=(LrIpcIn&& other) = delete;
    void Start();
-   // signal exit to thread
+   // stop reading from the plugin
    void PleaseStopThread();
 
  private:
-   juce::StreamingSocket socket_{};
-   // Thread interface
-   void run() override;
-   // Timer callback
-   void timerCallback() override;
+   // reactor thread: splits what the socket has into lines for ProcessLine
+   bool Read(juce::StreamingSocket& socket);
+   // reactor thread: moves the complete lines in partial_line_ to line_, false if line_ filled
+   // up first
+   bool QueueLines();
+   // reactor thread, reading paused: has ProcessLine resume reading once it has made room, then
+   // tries again in case it already has
+   bool WantRoom();
    // process a line received from the socket
-   void ProcessLine();
+   void ProcessLine(const rsj::StopToken& stop);
    rsj::BlockingQueue<std::string> line_;
-   std::future<void> process_line_future_;
+   std::string partial_line_{}; // reactor thread only
+   std::atomic<bool> room_wanted_{false};
 
-   bool thread_started_{false};
-   bool timer_off_{false};
    Profile& profile_;
    ControlsModel& controls_model_; //
-   mutable std::mutex timer_mutex_;
    ProfileManager& profile_manager_;
    std::shared_ptr<MidiSender> midi_sender_{nullptr};
+   rsj::Executor& executor_;
+   // last, so they stop before the members they use go
+   rsj::ClientSocket socket_;
+   rsj::Worker process_worker_{};
 };
 
 #endif // LR_IPC_IN_H_INCLUDED
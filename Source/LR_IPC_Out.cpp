@@ -21,7 +21,9 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "LR_IPC_Out.h"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdio>
 #include <exception>
 #include <string>
 #include <unordered_map>
@@ -39,23 +41,54 @@ using Clock = std::chrono::high_resolution_clock;
 using TimePoint = Clock::time_point;
 
 namespace {
-   constexpr auto kHost{"127.0.0.1"};
-   constexpr auto kTerminate{"!!!@#$%^"};
-   constexpr int kConnectTimer{1000};
-   constexpr int kConnectTryTime{100};
    constexpr int kDelay{8}; // in between recurrent actions
    constexpr int kLrOutPort{58763};
    constexpr int kMinRecenterTimer{250}; // give controller enough of a refractory period before
                                          // resetting it
    constexpr int kRecenterTimer{std::max(kMinRecenterTimer,
        kDelay + kDelay / 2)}; // don't change, change kDelay and kMinRecenterTimer
+
+   // std::to_string keeps six decimals, enough for 14-bit values but not for MIDI 2.0 values
+   // with a fraction, which get ten
+   std::string ValueToString(double value, bool wide)
+   {
+      if (!wide)
+         return std::to_string(value);
+      std::array<char, 32> buffer{};
+      const auto length = std::snprintf(buffer.data(), buffer.size(), "%.10f", value);
+      return std::string(buffer.data(), gsl::narrow_cast<size_t>(std::max(length, 0)));
+   }
+
+   // controls that send a stream of values while moved, as opposed to buttons
+   bool IsContinuous(const rsj::MidiMessage& mm) noexcept
+   {
+      switch (mm.message_type_byte) {
+      case rsj::kCcFlag:
+      case rsj::kPwFlag:
+      case rsj::kRpnFlag:
+      case rsj::kOscFlag:
+         return true;
+      default:
+         return false;
+      }
+   }
 } // namespace
 
 LrIpcOut::LrIpcOut(ControlsModel& c_model, const Profile& profile,
-    std::shared_ptr<MidiSender> midi_sender, MidiReceiver& midi_receiver) noexcept
-    : profile_{profile}, controls_model_{c_model}, midi_sender_{std::move(midi_sender)}
+    std::shared_ptr<MidiSender> midi_sender, MidiReceiver& midi_receiver,
+    rsj::Executor& executor, rsj::Reactor& reactor) noexcept
+    : profile_{profile}, controls_model_{c_model}, executor_{executor},
+      midi_sender_{std::move(midi_sender)},
+      socket_{reactor, kLrOutPort,
+          {[this] { ConnectionChanged(true); },
+              [](juce::StreamingSocket& s) {
+                 // the plugin never writes here, so readable means closed
+                 std::array<char, 64> discard{};
+                 return s.read(discard.data(), gsl::narrow_cast<int>(discard.size()), false) > 0;
+              },
+              [this] { ConnectionChanged(false); }, {}}}
 {
-   midi_receiver.AddCallback(this, &LrIpcOut::MidiCmdCallback);
+   midi_receiver.AddCallback<&LrIpcOut::MidiCmdCallback>(this);
 }
 
 #pragma warning(push)
@@ -63,10 +96,17 @@ LrIpcOut::LrIpcOut(ControlsModel& c_model, const Profile& profile,
 LrIpcOut::~LrIpcOut()
 {
    try {
-      if (const auto m = command_.clear_count_emplace(kTerminate))
+      send_out_worker_.Stop(); // closes command_
+      if (const auto m = command_.Discard())
          rsj::Log(juce::String(m) + " left in queue in LrIpcOut destructor");
-      connect_timer_.Stop();
-      juce::InterprocessConnection::disconnect();
+      if (end_to_end_latency_.Count()) {
+         rsj::Log("MIDI input to command queued latency " + to_queue_latency_.Summary());
+         rsj::Log("Command queue " + command_.Summary());
+         rsj::Log("Socket write duration " + write_latency_.Summary());
+         rsj::Log("MIDI input to socket write latency " + end_to_end_latency_.Summary());
+      }
+      socket_.Stop();
+      juce::AsyncUpdater::cancelPendingUpdate();
    }
    catch (...) {
       rsj::LogAndAlertError("Exception in LrIpcOut destructor.");
@@ -78,8 +118,9 @@ LrIpcOut::~LrIpcOut()
 void LrIpcOut::Start()
 {
    try {
-      connect_timer_.Start();
-      send_out_future_ = std::async(std::launch::async, &LrIpcOut::SendOut, this);
+      socket_.Start();
+      send_out_worker_ = executor_.Spawn({"LR_IPC_OUT", rsj::ThreadPriority::kElevated},
+          [this](const rsj::StopToken&) { SendOut(); }, [this] { command_.Close(); });
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -87,7 +128,19 @@ void LrIpcOut::Start()
    }
 }
 
-void LrIpcOut::MidiCmdCallback(rsj::MidiMessage mm)
+void LrIpcOut::MidiCmdCallback(gsl::span<const rsj::MidiEvent> events)
+{
+   try {
+      for (const auto& event : events)
+         ProcessMessage(event);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void LrIpcOut::ProcessMessage(const rsj::MidiEvent& event)
 {
    struct RepeatMessage {
       std::string cw;
@@ -95,7 +148,6 @@ void LrIpcOut::MidiCmdCallback(rsj::MidiMessage mm)
    };
    using namespace std::string_literals;
    try {
-      const rsj::MidiMessageId message{mm};
       static const std::unordered_map<std::string, RepeatMessage> kCmdUpDown{
           {"ChangeBrushSize"s, {"BrushSizeLarger 1\n"s, "BrushSizeSmaller 1\n"s}},
           {"ChangeCurrentSlider"s, {"SliderIncrease 1\n"s, "SliderDecrease 1\n"s}},
@@ -113,35 +165,35 @@ void LrIpcOut::MidiCmdCallback(rsj::MidiMessage mm)
           {"ZoomInOut"s, {"ZoomInSmallStep 1\n"s, "ZoomOutSmallStep 1\n"s}},
           {"ZoomOutIn"s, {"ZoomOutSmallStep 1\n"s, "ZoomInSmallStep 1\n"s}},
       };
-      if (!profile_.MessageExistsInMap(message))
+      if (!event.IsMapped()) // not in profile or "Unmapped"
          return;
-      const auto command_to_send = profile_.GetCommandForMessage(message);
-      if (command_to_send == "PrevPro"s || command_to_send == "NextPro"s
-          || command_to_send == "Unmapped"s)
+      const auto& command_to_send = profile_.GetCommandForIndex(event.command);
+      if (command_to_send == "PrevPro"s || command_to_send == "NextPro"s)
          return; // handled by ProfileManager
+      const auto& mm = event.message;
       // if it is a repeated command, change command_to_send appropriately
       if (const auto a = kCmdUpDown.find(command_to_send); a != kCmdUpDown.end()) {
          static TimePoint nextresponse{};
          if (const auto now = Clock::now(); nextresponse < now) {
             nextresponse = now + std::chrono::milliseconds(kDelay);
-            if (mm.message_type_byte == rsj::kPwFlag
+            if (mm.message_type_byte == rsj::kPwFlag || mm.message_type_byte == rsj::kRpnFlag
                 || (mm.message_type_byte == rsj::kCcFlag
                        && controls_model_.GetCcMethod(mm.channel, mm.number)
                               == rsj::CCmethod::kAbsolute)) {
                recenter_.SetMidiMessage(mm);
             }
-            const auto change = controls_model_.MeasureChange(mm);
-            if (change == 0)
-               return;      // don't send any signal
-            if (change > 0) // turned clockwise
-               SendCommand(a->second.cw);
+            if (event.delta == 0)
+               return;           // don't send any signal
+            if (event.delta > 0) // turned clockwise
+               SendCommand(a->second.cw, mm.time);
             else // turned counterclockwise
-               SendCommand(a->second.ccw);
+               SendCommand(a->second.ccw, mm.time);
          }
       }
       else { // not repeated command
-         const auto computed_value = controls_model_.ControllerToPlugin(mm);
-         SendCommand(command_to_send + ' ' + std::to_string(computed_value) + '\n');
+         SendCommand(
+             command_to_send + ' ' + ValueToString(event.value, mm.fraction != 0.0) + '\n',
+             mm.time, IsContinuous(mm) ? Priority::kContinuous : Priority::kDiscrete);
       }
    }
    catch (const std::exception& e) {
@@ -150,12 +202,14 @@ void LrIpcOut::MidiCmdCallback(rsj::MidiMessage mm)
    }
 }
 
-void LrIpcOut::SendCommand(std::string&& command)
+void LrIpcOut::SendCommand(std::string&& command, rsj::MidiTime origin, Priority priority)
 {
    try {
       if (sending_stopped_)
          return;
-      command_.push(std::move(command));
+      if (origin != rsj::MidiTime{})
+         to_queue_latency_.Record(origin, rsj::MidiClock::now());
+      command_.Push({std::move(command), origin}, priority);
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -163,12 +217,14 @@ void LrIpcOut::SendCommand(std::string&& command)
    }
 }
 
-void LrIpcOut::SendCommand(const std::string& command)
+void LrIpcOut::SendCommand(const std::string& command, rsj::MidiTime origin, Priority priority)
 {
    try {
       if (sending_stopped_)
          return;
-      command_.push(command);
+      if (origin != rsj::MidiTime{})
+         to_queue_latency_.Record(origin, rsj::MidiClock::now());
+      command_.Push({command, origin}, priority);
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -180,7 +236,7 @@ void LrIpcOut::Stop()
 {
    try {
       sending_stopped_ = true;
-      const auto connected = isConnected();
+      const auto connected = socket_.IsConnected();
       for (const auto& cb : callbacks_)
          cb(connected, true);
    }
@@ -195,7 +251,7 @@ void LrIpcOut::Restart()
    try {
       using namespace std::string_literals;
       sending_stopped_ = false;
-      const auto connected = isConnected();
+      const auto connected = socket_.IsConnected();
       for (const auto& cb : callbacks_)
          cb(connected, false);
       // resync controls
@@ -207,12 +263,11 @@ void LrIpcOut::Restart()
    }
 }
 
-void LrIpcOut::connectionMade()
+void LrIpcOut::ConnectionChanged(bool connected)
 {
    try {
-      for (const auto& cb : callbacks_)
-         cb(true, sending_stopped_);
-      rsj::Log("Connected to Lightroom plugin");
+      rsj::Log(connected ? "Connected to Lightroom plugin" : "Disconnected from Lightroom plugin");
+      juce::AsyncUpdater::triggerAsyncUpdate();
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -220,12 +275,13 @@ void LrIpcOut::connectionMade()
    }
 }
 
-void LrIpcOut::connectionLost()
+void LrIpcOut::handleAsyncUpdate()
 {
    try {
+      // the state now, so a quick drop and reconnect may show only the end result
+      const auto connected = socket_.IsConnected();
       for (const auto& cb : callbacks_)
-         cb(false, sending_stopped_);
-      rsj::Log("Disconnected from Lightroom plugin");
+         cb(connected, sending_stopped_);
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -233,23 +289,27 @@ void LrIpcOut::connectionLost()
    }
 }
 
-void LrIpcOut::messageReceived(const juce::MemoryBlock& /*msg*/) noexcept {}
-
 void LrIpcOut::SendOut()
 {
    try {
-      do {
-         auto command_copy = command_.pop();
-         if (command_copy == kTerminate)
-            return;
+      // one command at a time, so a press queued while a backlog of fader values is written
+      // goes out next
+      while (auto queued = command_.Pop()) {
+         auto& [command_copy, origin, queued_at] = *queued;
          // check if there is a connection
-         if (juce::InterprocessConnection::isConnected()) {
+         if (socket_.IsConnected()) {
             if (command_copy.back() != '\n') // should be terminated with \n
                command_copy += '\n';
-            juce::InterprocessConnection::getSocket()->write(
-                command_copy.c_str(), gsl::narrow_cast<int>(command_copy.length()));
+            const auto write_start = rsj::MidiClock::now();
+            const auto length = gsl::narrow_cast<int>(command_copy.length());
+            if (socket_.Write(command_copy.c_str(), length) < 0)
+               continue; // lost since the check
+            const auto written = rsj::MidiClock::now();
+            write_latency_.Record(write_start, written);
+            if (origin != rsj::MidiTime{})
+               end_to_end_latency_.Record(origin, written);
          }
-      } while (true);
+      }
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -257,12 +317,17 @@ void LrIpcOut::SendOut()
    }
 }
 
-void LrIpcOut::ConnectTimer::Start()
+void LrIpcOut::CommandQueue::Push(QueuedCommand&& command, Priority priority)
 {
    try {
-      auto lock = std::scoped_lock(connect_mutex_);
-      juce::Timer::startTimer(kConnectTimer);
-      timer_off_ = false;
+      if (closed_.load(std::memory_order_relaxed))
+         return;
+      const auto lane = static_cast<std::size_t>(priority);
+      if (!rings_.at(lane).try_push(std::move(command))) {
+         ring_full_.at(lane).fetch_add(1, std::memory_order_relaxed);
+         return;
+      }
+      doorbell_.Ring();
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -270,12 +335,42 @@ void LrIpcOut::ConnectTimer::Start()
    }
 }
 
-void LrIpcOut::ConnectTimer::Stop()
+void LrIpcOut::CommandQueue::Drain()
 {
    try {
-      auto lock = std::scoped_lock(connect_mutex_);
-      juce::Timer::stopTimer();
-      timer_off_ = true;
+      const auto parameter = [](const std::string& c) { return c.substr(0, c.find(' ')); };
+      for (std::size_t lane = 0; lane < kPriorities; ++lane) {
+         auto& queue = lanes_.at(lane);
+         // at most a ring's worth, so producers outrunning us can't keep us here
+         for (std::size_t i = 0; i < kRingSize; ++i) {
+            auto command = rings_.at(lane).try_pop();
+            if (!command)
+               break;
+            if (lane == static_cast<std::size_t>(Priority::kContinuous)) {
+               // a value still waiting is stale once a newer one for its parameter arrives. This
+               // is where a slow plugin's backlog builds, and coalescing keeps this FIFO to one
+               // entry per parameter, so the search is short
+               const auto it = std::find_if(queue.rbegin(), queue.rend(),
+                   [&, name = parameter(command->command)](const QueuedCommand& queued) {
+                      return parameter(queued.command) == name;
+                   });
+               if (it != queue.rend()) { // keeps its place in line and its queued time
+                  it->command = std::move(command->command);
+                  it->origin = command->origin;
+                  ++coalesced_;
+                  continue;
+               }
+            }
+            if (queue.size() >= kCapacity) {
+               ++dropped_.at(lane);
+               if (lane == static_cast<std::size_t>(Priority::kDiscrete))
+                  continue;
+               queue.pop_front();
+            }
+            queue.push_back(std::move(*command));
+         }
+         max_depth_.at(lane) = std::max(max_depth_.at(lane), queue.size());
+      }
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -283,12 +378,80 @@ void LrIpcOut::ConnectTimer::Stop()
    }
 }
 
-void LrIpcOut::ConnectTimer::timerCallback()
+std::optional<LrIpcOut::QueuedCommand> LrIpcOut::CommandQueue::Pop()
 {
    try {
-      auto lock = std::scoped_lock(connect_mutex_);
-      if (!timer_off_ && !owner_.juce::InterprocessConnection::isConnected())
-         owner_.juce::InterprocessConnection::connectToSocket(kHost, kLrOutPort, kConnectTryTime);
+      auto& discrete = lanes_.at(static_cast<std::size_t>(Priority::kDiscrete));
+      auto& continuous = lanes_.at(static_cast<std::size_t>(Priority::kContinuous));
+      Drain();
+      doorbell_.Wait([&] {
+         return closed_.load(std::memory_order_relaxed) || !discrete.empty() || !continuous.empty()
+                || !rings_.front().empty() || !rings_.back().empty();
+      });
+      if (closed_.load(std::memory_order_relaxed))
+         return std::nullopt;
+      Drain();
+      const auto now = rsj::MidiClock::now();
+      auto lane = Priority::kDiscrete;
+      if (discrete.empty())
+         lane = Priority::kContinuous;
+      else if (!continuous.empty() && !aged_last_ && now - continuous.front().queued >= kAgingLimit)
+         lane = Priority::kContinuous;
+      aged_last_ = lane == Priority::kContinuous && !discrete.empty();
+      auto& queue = lanes_.at(static_cast<std::size_t>(lane));
+      std::optional<QueuedCommand> result{std::move(queue.front())};
+      queue.pop_front();
+      wait_.at(static_cast<std::size_t>(lane)).Record(result->queued, now);
+      return result;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void LrIpcOut::CommandQueue::Close()
+{
+   try {
+      closed_.store(true, std::memory_order_relaxed);
+      doorbell_.Ring();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+std::size_t LrIpcOut::CommandQueue::Discard()
+{
+   try {
+      std::size_t dropped{0};
+      for (std::size_t lane = 0; lane < kPriorities; ++lane) {
+         dropped += lanes_.at(lane).size();
+         lanes_.at(lane).clear();
+         while (rings_.at(lane).try_pop())
+            ++dropped;
+      }
+      return dropped;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+std::string LrIpcOut::CommandQueue::Summary() const
+{
+   try {
+      const auto line = [this](Priority priority) {
+         const auto lane = static_cast<std::size_t>(priority);
+         return wait_.at(lane).Summary() + " max depth " + std::to_string(max_depth_.at(lane))
+                + " dropped "
+                + std::to_string(
+                    dropped_.at(lane) + ring_full_.at(lane).load(std::memory_order_relaxed));
+      };
+      return "wait discrete " + line(Priority::kDiscrete) + "; continuous "
+             + line(Priority::kContinuous) + " coalesced " + std::to_string(coalesced_);
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -326,7 +489,12 @@ void LrIpcOut::Recenter::timerCallback()
          break;
       }
       case rsj::kCcFlag: {
-         owner_.midi_sender_->SendCc(local_mm.channel + 1, local_mm.number, center);
+         owner_.midi_sender_->SendCc(local_mm.channel + 1, local_mm.number, center,
+             owner_.controls_model_.IsCc14Bit(local_mm.channel, local_mm.number));
+         break;
+      }
+      case rsj::kRpnFlag: {
+         owner_.midi_sender_->SendRpn(local_mm.channel + 1, local_mm.number, center);
          break;
       }
       default:
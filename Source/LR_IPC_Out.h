@@ -20,15 +20,26 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
-#include <functional>
-#include <future>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <gsl/gsl>
 #include <JuceLibraryCode/JuceHeader.h>
 #include "Concurrency.h"
+#include "Delegate.h"
+#include "Executor.h"
+#include "LatencyHistogram.h"
 #include "MidiUtilities.h"
+#include "Reactor.h"
 class ControlsModel;
 class MidiReceiver;
 class MidiSender;
@@ -37,10 +48,10 @@ class Profile;
 #define _In_
 #endif
 
-class LrIpcOut final : juce::InterprocessConnection {
+class LrIpcOut final : juce::AsyncUpdater {
  public:
    LrIpcOut(ControlsModel& c_model, const Profile& profile, std::shared_ptr<MidiSender> midi_sender,
-       MidiReceiver& midi_receiver) noexcept;
+       MidiReceiver& midi_receiver, rsj::Executor& executor, rsj::Reactor& reactor) noexcept;
    ~LrIpcOut();
    LrIpcOut(const LrIpcOut& other) = delete;
    LrIpcOut(LrIpcOut&& other) = delete;
@@ -48,48 +59,104 @@ class LrIpcOut final : juce::InterprocessConnection {
    LrIpcOut& operator=(LrIpcOut&& other) = delete;
    void Start();
 
-   template<class T> void AddCallback(_In_ T* const object, _In_ void (T::*const mf)(bool, bool))
+   // usage: AddCallback<&Listener::Method>(this), Method(bool connected, bool blocked)
+   template<auto MemFn, class T> void AddCallback(_In_ T* const object)
    {
-      using namespace std::placeholders;
-      if (object && mf) // only store non-empty functions
-         callbacks_.emplace_back(std::bind(mf, object, _1, _2));
+      callbacks_.Add<MemFn>(object);
    }
 
-   // sends a command to the plugin
-   void SendCommand(std::string&& command);
-   void SendCommand(const std::string& command);
+   // discrete commands (button presses, encoder steps, anything not caused by MIDI) are written
+   // ahead of continuous ones (fader and knob values), so a press isn't stuck behind a sweep
+   enum class Priority : std::size_t { kDiscrete, kContinuous };
+
+   // sends a command to the plugin. origin is the arrival time of the MIDI message that caused
+   // the command, if any, and is used only for latency statistics
+   void SendCommand(
+       std::string&& command, rsj::MidiTime origin = {}, Priority priority = Priority::kDiscrete);
+   void SendCommand(const std::string& command, rsj::MidiTime origin = {},
+       Priority priority = Priority::kDiscrete);
 
    void Stop();
    void Restart();
 
  private:
-   void connectionLost() override;
-   void connectionMade() override;
-   void messageReceived(const juce::MemoryBlock& msg) noexcept override;
-   void MidiCmdCallback(rsj::MidiMessage);
+   // reactor thread, logs the change and has handleAsyncUpdate tell the listeners
+   void ConnectionChanged(bool connected);
+   // message thread
+   void handleAsyncUpdate() override;
+   void MidiCmdCallback(gsl::span<const rsj::MidiEvent> events);
+   void ProcessMessage(const rsj::MidiEvent& event);
    void SendOut();
 
+   struct QueuedCommand {
+      QueuedCommand() = default; // an empty ring slot
+      QueuedCommand(std::string cmd, rsj::MidiTime from = {})
+          : command{std::move(cmd)}, origin{from}, queued{rsj::MidiClock::now()}
+      {
+      }
+      std::string command;
+      rsj::MidiTime origin; // default when not caused by MIDI input
+      rsj::MidiTime queued;
+   };
+
+   // one FIFO per priority. Pop takes the oldest discrete command first, unless the oldest
+   // continuous one has waited kAgingLimit, then the two alternate until it catches up, so a
+   // steady stream of presses can't hold a fader back for good nor the reverse.
+   // Producers only touch a lock-free ring per priority and ring the doorbell; Pop, on the one
+   // SendOut thread, moves the rings into its own FIFOs before each choice, so only it sees the
+   // FIFOs and pays for coalescing. A command is dropped if its ring is full, which takes a
+   // socket write blocked for a whole ring of commands. A continuous command always replaces a
+   // value still queued for the same parameter, in that value's place in line. Each FIFO holds
+   // kCapacity commands: once full, a discrete command is dropped and a continuous one with
+   // nothing to replace pushes out the oldest.
+   class CommandQueue {
+    public:
+      // any thread, never waits
+      void Push(QueuedCommand&& command, Priority priority);
+      // SendOut thread only. waits for a command, nullopt once closed
+      [[nodiscard]] std::optional<QueuedCommand> Pop();
+      // wakes Pop for good
+      void Close();
+      // the rest only once Pop's thread is done. Discard empties the queue and returns the
+      // number of commands dropped, Summary gives queue wait, highest depth and drops for each
+      // priority, for the log
+      std::size_t Discard();
+      [[nodiscard]] std::string Summary() const;
+
+    private:
+      void Drain();
+      static constexpr std::size_t kPriorities{2};
+      static constexpr auto kAgingLimit{std::chrono::milliseconds(50)};
+      static constexpr std::size_t kCapacity{4096};
+      static constexpr std::size_t kRingSize{1024};
+      // shared
+      std::array<rsj::MpmcRing<QueuedCommand, kRingSize>, kPriorities> rings_{};
+      std::array<std::atomic<std::uint64_t>, kPriorities> ring_full_{};
+      std::atomic<bool> closed_{false};
+      rsj::Doorbell doorbell_{};
+      // Pop's
+      std::array<std::deque<QueuedCommand>, kPriorities> lanes_{};
+      std::array<std::size_t, kPriorities> max_depth_{};
+      std::array<std::uint64_t, kPriorities> dropped_{};
+      std::uint64_t coalesced_{0}; // continuous values replaced by newer ones
+      std::array<rsj::LatencyHistogram, kPriorities> wait_{};
+      bool aged_last_{false}; // last Pop let an aged continuous command ahead
+   };
+
    bool sending_stopped_{false};
    const Profile& profile_;
    ControlsModel& controls_model_;
-   rsj::BlockingQueue<std::string> command_;
-   std::future<void> send_out_future_;
+   CommandQueue command_;
+   rsj::Executor& executor_;
    std::shared_ptr<MidiSender> midi_sender_{nullptr};
-   std::vector<std::function<void(bool, bool)>> callbacks_{};
+   rsj::ListenerRegistry<void(bool, bool)> callbacks_{};
+   rsj::ClientSocket socket_;
+   rsj::Worker send_out_worker_{}; // after command_ and socket_, which it uses
+   rsj::LatencyHistogram to_queue_latency_{};   // MIDI input to command_
+   rsj::LatencyHistogram write_latency_{};      // socket write
+   rsj::LatencyHistogram end_to_end_latency_{}; // MIDI input to written to socket
 
    // helper classes
-   class ConnectTimer final : public juce::Timer {
-    public:
-      explicit ConnectTimer(LrIpcOut& owner) noexcept : owner_(owner) {}
-      void Start();
-      void Stop();
-
-    private:
-      void timerCallback() override;
-      LrIpcOut& owner_;
-      bool timer_off_{false};
-      mutable std::mutex connect_mutex_; // fix race during shutdown
-   };
    class Recenter final : public juce::Timer {
     public:
       explicit Recenter(LrIpcOut& owner) noexcept : owner_{owner} {}
@@ -101,7 +168,6 @@ class LrIpcOut final : juce::InterprocessConnection {
       mutable rsj::SpinLock mtx_;
       rsj::MidiMessage mm_{};
    };
-   ConnectTimer connect_timer_{*this};
    Recenter recenter_{*this};
 };
 
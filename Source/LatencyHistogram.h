@@ -0,0 +1,109 @@
+#ifndef MIDI2LR_LATENCYHISTOGRAM_H_INCLUDED
+#define MIDI2LR_LATENCYHISTOGRAM_H_INCLUDED
+/*
+==============================================================================
+
+LatencyHistogram.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rsj {
+   // Log-linear histogram of durations in microseconds. Values below 16us get their own bucket,
+   // above that every power of two is split into 16 buckets, so a reported percentile is at most
+   // 1/16 above the true value. Recording is wait-free and may be done from any thread; the
+   // percentiles read while recording continues are approximate, which is fine for diagnostics.
+   class LatencyHistogram {
+    public:
+      void Record(std::chrono::microseconds duration) noexcept
+      {
+         const auto us = duration.count() < 0 ? std::uint64_t{0}
+                                              : static_cast<std::uint64_t>(duration.count());
+         counts_.at(BucketOf(std::min(us, kMaxValue))).fetch_add(1, std::memory_order_relaxed);
+         count_.fetch_add(1, std::memory_order_relaxed);
+      }
+      template<class Clock, class Duration>
+      void Record(std::chrono::time_point<Clock, Duration> start,
+          std::chrono::time_point<Clock, Duration> end) noexcept
+      {
+         Record(std::chrono::duration_cast<std::chrono::microseconds>(end - start));
+      }
+      [[nodiscard]] std::uint64_t Count() const noexcept
+      {
+         return count_.load(std::memory_order_relaxed);
+      }
+      // upper bound of the bucket holding the q-th quantile, 0 <= q <= 1
+      [[nodiscard]] std::chrono::microseconds Percentile(double q) const noexcept
+      {
+         const auto total = Count();
+         if (total == 0)
+            return std::chrono::microseconds{0};
+         const auto rank = std::max(std::uint64_t{1},
+             static_cast<std::uint64_t>(q * static_cast<double>(total) + 0.5));
+         std::uint64_t seen{0};
+         for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += counts_.at(i).load(std::memory_order_relaxed);
+            if (seen >= rank)
+               return std::chrono::microseconds(UpperBoundOf(i));
+         }
+         return std::chrono::microseconds(kMaxValue);
+      }
+      // e.g. "n=1234 p50=120us p99=810us p999=2048us"
+      [[nodiscard]] std::string Summary() const
+      {
+         return "n=" + std::to_string(Count()) + " p50=" + std::to_string(Percentile(0.5).count())
+                + "us p99=" + std::to_string(Percentile(0.99).count())
+                + "us p999=" + std::to_string(Percentile(0.999).count()) + "us";
+      }
+
+    private:
+      static constexpr unsigned kSubBits{4};
+      static constexpr std::uint64_t kSubBuckets{1u << kSubBits};
+      static constexpr unsigned kMaxExponent{31}; // a bit over 71 minutes
+      static constexpr std::uint64_t kMaxValue{(std::uint64_t{1} << (kMaxExponent + 1)) - 1};
+      static constexpr std::size_t kBuckets{(kMaxExponent - kSubBits + 2) * kSubBuckets};
+      [[nodiscard]] static constexpr std::size_t BucketOf(std::uint64_t us) noexcept
+      {
+         if (us < kSubBuckets)
+            return static_cast<std::size_t>(us);
+         unsigned exponent{kSubBits};
+         while (us >> (exponent + 1))
+            ++exponent;
+         const auto shift = exponent - kSubBits;
+         return static_cast<std::size_t>(
+             (shift + 1) * kSubBuckets + ((us >> shift) & (kSubBuckets - 1)));
+      }
+      [[nodiscard]] static constexpr std::uint64_t UpperBoundOf(std::size_t bucket) noexcept
+      {
+         if (bucket < kSubBuckets)
+            return bucket;
+         const auto shift = bucket / kSubBuckets - 1;
+         const auto lower = (kSubBuckets + bucket % kSubBuckets) << shift;
+         return lower + (std::uint64_t{1} << shift) - 1;
+      }
+      std::array<std::atomic<std::uint32_t>, kBuckets> counts_{};
+      std::atomic<std::uint64_t> count_{0};
+   };
+} // namespace rsj
+
+#endif // MIDI2LR_LATENCYHISTOGRAM_H_INCLUDED
@@ -0,0 +1,243 @@
+/*
+==============================================================================
+
+LockBenchmark.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "LockBenchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gsl/gsl>
+#include "Concurrency.h"
+#include "Delegate.h"
+#include "LatencyHistogram.h"
+#include "MidiUtilities.h"
+#include "Misc.h"
+
+namespace {
+   // nanoseconds per acquisition, over all threads
+   template<class Lock> double Contend(Lock& lock, int threads, int iterations)
+   {
+      std::atomic<bool> go{false};
+      std::uint64_t shared{0};
+      std::vector<std::thread> workers{};
+      workers.reserve(gsl::narrow_cast<std::size_t>(threads));
+      for (auto t = 0; t < threads; ++t)
+         workers.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire))
+               std::this_thread::yield();
+            for (auto i = 0; i < iterations; ++i) {
+               auto guard = std::scoped_lock(lock);
+               shared += static_cast<std::uint64_t>(i);
+            }
+         });
+      const auto start = std::chrono::steady_clock::now();
+      go.store(true, std::memory_order_release);
+      for (auto& worker : workers)
+         worker.join();
+      const std::chrono::duration<double, std::nano> elapsed{
+          std::chrono::steady_clock::now() - start};
+      return elapsed.count() / (static_cast<double>(threads) * static_cast<double>(iterations));
+   }
+
+   constexpr std::size_t kQueueCapacity{1024};
+
+   struct Stamp {
+      std::chrono::steady_clock::time_point sent{};
+   };
+
+   // items per second. send and receive are called with and must return a Stamp
+   template<class Send, class Receive>
+   double Transfer(int producers, int items, Send send, Receive receive,
+       rsj::LatencyHistogram& latency)
+   {
+      std::atomic<bool> go{false};
+      std::vector<std::thread> workers{};
+      workers.reserve(gsl::narrow_cast<std::size_t>(producers));
+      for (auto p = 0; p < producers; ++p)
+         workers.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire))
+               std::this_thread::yield();
+            for (auto i = 0; i < items; ++i)
+               send(Stamp{std::chrono::steady_clock::now()});
+         });
+      const auto start = std::chrono::steady_clock::now();
+      go.store(true, std::memory_order_release);
+      for (auto i = 0LL, total = 1LL * producers * items; i < total; ++i) {
+         const auto stamp = receive();
+         latency.Record(stamp.sent, std::chrono::steady_clock::now());
+      }
+      const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+      for (auto& worker : workers)
+         worker.join();
+      return static_cast<double>(producers) * static_cast<double>(items) / elapsed.count();
+   }
+
+   constexpr std::size_t kListeners{4};
+
+   class CountingListener {
+    public:
+      void MidiCmdCallback(gsl::span<const rsj::MidiEvent> events) noexcept
+      {
+         for (const auto& event : events)
+            total_ += event.message.value;
+      }
+      [[nodiscard]] long long Total() const noexcept
+      {
+         return total_;
+      }
+
+    private:
+      long long total_{0};
+   };
+
+   // nanoseconds per listener call. dispatch is called with each burst
+   template<class Dispatch> double TimeDispatch(int messages, Dispatch dispatch)
+   {
+      std::array<rsj::MidiEvent, 1> burst{};
+      const auto start = std::chrono::steady_clock::now();
+      for (auto i = 0; i < messages; ++i) {
+         burst[0].message.value = gsl::narrow_cast<short>(i & 0x7F);
+         dispatch(gsl::span<const rsj::MidiEvent>(burst));
+      }
+      const std::chrono::duration<double, std::nano> elapsed{
+          std::chrono::steady_clock::now() - start};
+      return elapsed.count() / (static_cast<double>(messages) * static_cast<double>(kListeners));
+   }
+
+   std::string LockResult(const char* name, int threads, int iterations, double ns)
+   {
+      return std::string(name) + ": " + std::to_string(threads) + " threads x "
+             + std::to_string(iterations) + ", " + std::to_string(ns) + " ns per acquisition";
+   }
+} // namespace
+
+std::string rsj::LockBenchmark(int threads, int iterations)
+{
+   try {
+      Expects(threads > 0 && iterations > 0);
+      rsj::BasicSpinLock<true> spin_lock{};
+      const auto spin_ns = Contend(spin_lock, threads, iterations);
+      std::mutex mutex{};
+      const auto mutex_ns = Contend(mutex, threads, iterations);
+      const auto stats = spin_lock.stats();
+      const auto waits = static_cast<double>(std::max(stats.contended, std::uint64_t{1}));
+      const auto per_wait = [waits](std::uint64_t count) {
+         return std::to_string(static_cast<double>(count) / waits);
+      };
+      return LockResult("rsj::SpinLock", threads, iterations, spin_ns) + ", "
+             + std::to_string(stats.contended) + " of " + std::to_string(stats.acquisitions)
+             + " waited, " + per_wait(stats.spins) + " pauses and " + per_wait(stats.yields)
+             + " yields per wait\n" + LockResult("std::mutex", threads, iterations, mutex_ns);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+std::string rsj::QueueBenchmark(int producers, int items)
+{
+   try {
+      Expects(producers > 0 && items > 0);
+      const auto line = [producers, items](const char* name, double per_second,
+                            const rsj::LatencyHistogram& latency) {
+         return std::string(name) + ": " + std::to_string(producers) + " producers x "
+                + std::to_string(items) + ", " + std::to_string(per_second) + " items/s, latency "
+                + latency.Summary();
+      };
+      rsj::MpmcRing<Stamp, kQueueCapacity> ring{};
+      rsj::Doorbell doorbell{};
+      rsj::LatencyHistogram ring_latency{};
+      const auto ring_rate = Transfer(
+          producers, items,
+          [&](Stamp stamp) {
+             while (!ring.try_push(std::move(stamp)))
+                std::this_thread::yield();
+             doorbell.Ring();
+          },
+          [&] {
+             while (true) {
+                if (const auto stamp = ring.try_pop())
+                   return *stamp;
+                doorbell.Wait([&ring] { return !ring.empty(); });
+             }
+          },
+          ring_latency);
+      rsj::BlockingQueue<Stamp> queue{kQueueCapacity, rsj::Overflow::kBlock};
+      rsj::LatencyHistogram queue_latency{};
+      const auto queue_rate = Transfer(
+          producers, items, [&](Stamp stamp) { queue.push(stamp); }, [&] { return *queue.pop(); },
+          queue_latency);
+      return line("rsj::MpmcRing", ring_rate, ring_latency) + '\n'
+             + line("rsj::BlockingQueue", queue_rate, queue_latency);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+std::string rsj::DispatchBenchmark(int messages)
+{
+   try {
+      Expects(messages > 0);
+      using Signature = void(gsl::span<const rsj::MidiEvent>);
+      std::array<CountingListener, kListeners> listeners{};
+      rsj::ListenerRegistry<Signature, kListeners> registry{};
+      for (auto& listener : listeners)
+         registry.Add<&CountingListener::MidiCmdCallback>(&listener);
+      const auto registry_ns = TimeDispatch(messages, [&registry](auto events) {
+         for (const auto& cb : registry)
+            cb(events);
+      });
+      std::vector<std::function<Signature>> functions{};
+      for (auto& listener : listeners)
+         functions.emplace_back(
+             std::bind(&CountingListener::MidiCmdCallback, &listener, std::placeholders::_1));
+      const auto function_ns = TimeDispatch(messages, [&functions](auto events) {
+         for (const auto& cb : functions)
+            cb(events);
+      });
+      long long total{0}; // used, so the calls can't be left out
+      for (const auto& listener : listeners)
+         total += listener.Total();
+      const auto line = [messages](const char* name, double ns) {
+         return std::string(name) + ": " + std::to_string(kListeners) + " listeners x "
+                + std::to_string(messages) + " messages, " + std::to_string(ns)
+                + " ns per listener call";
+      };
+      return line("rsj::ListenerRegistry", registry_ns) + '\n'
+             + line("std::function + std::bind", function_ns) + " (checksum "
+             + std::to_string(total) + ')';
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
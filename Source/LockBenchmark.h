@@ -0,0 +1,41 @@
+#ifndef MIDI2LR_LOCKBENCHMARK_H_INCLUDED
+#define MIDI2LR_LOCKBENCHMARK_H_INCLUDED
+/*
+==============================================================================
+
+LockBenchmark.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <string>
+
+namespace rsj {
+   // threads threads each take the lock iterations times around a critical section of a few
+   // instructions, first with rsj::SpinLock then with std::mutex. Returns a line per lock with
+   // the time per acquisition, plus how often the spin lock had to wait and how long, for the log
+   [[nodiscard]] std::string LockBenchmark(int threads, int iterations);
+   // producers threads each send items items to one consumer, first through rsj::MpmcRing with
+   // rsj::Doorbell then through a bounded rsj::BlockingQueue of the same capacity. Returns a line
+   // per queue with items per second and the send to receive latency, for the log
+   [[nodiscard]] std::string QueueBenchmark(int producers, int items);
+   // calls four listeners with a burst of one rsj::MidiEvent messages times, first through
+   // rsj::ListenerRegistry then through a vector of std::function holding std::bind results, as
+   // the listener lists were before. Returns a line per list with the time per listener call,
+   // for the log
+   [[nodiscard]] std::string DispatchBenchmark(int messages);
+} // namespace rsj
+
+#endif // MIDI2LR_LOCKBENCHMARK_H_INCLUDED
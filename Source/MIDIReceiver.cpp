@@ -20,10 +20,33 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "MIDIReceiver.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "ControlsModel.h"
+#include "Profile.h"
 
 namespace {
-   constexpr rsj::MidiMessage kTerminate{0, 129, 0, 0}; // impossible channel
+   constexpr size_t kDispatchBurst{64}; // max messages taken from one device before moving on
+} // namespace
+
+MidiReceiver::MidiReceiver(rsj::Executor& executor) : executor_{executor}
+{
+   try {
+      batch_.reserve(kDispatchBurst);
+      events_.reserve(kDispatchBurst);
+      latest_.reserve(kDispatchBurst);
+      slots_.reserve(rsj::kMaxInputDevices);
+      for (size_t i = 0; i < rsj::kMaxInputDevices; ++i)
+         slots_.push_back(std::make_unique<InputSlot>(*this, i));
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
 }
 
 #pragma warning(push)
@@ -31,12 +54,19 @@ namespace {
 MidiReceiver::~MidiReceiver()
 {
    try {
-      for (const auto& dev : devices_) {
-         dev->stop();
-         rsj::Log("Stopped input device " + dev->getName());
+      replay_worker_.Stop();
+      StopCapture();
+      for (const auto& slot : slots_) {
+         if (slot->device) {
+            slot->device->stop();
+            rsj::Log("Stopped input device " + slot->device->getName());
+         }
       }
-      if (const auto remaining = messages_.clear_count_push(kTerminate))
-         rsj::Log(juce::String(remaining) + " left in queue in MidiReceiver destructor");
+      dispatch_worker_.Stop();
+      if (const auto coalesced = coalesced_.load(std::memory_order_relaxed))
+         rsj::Log(juce::String(coalesced) + " MIDI messages coalesced by MidiReceiver");
+      if (ring_latency_.Count())
+         rsj::Log("MIDI input to dispatch latency " + ring_latency_.Summary());
    }
    catch (const std::exception& e) {
       rsj::LogAndAlertError(juce::String("Exception in MidiReceiver Destructor. ") + e.what());
@@ -52,9 +82,11 @@ MidiReceiver::~MidiReceiver()
 void MidiReceiver::Start()
 {
    try {
-      InitDevices();
-      dispatch_messages_future_ =
-          std::async(std::launch::async, &MidiReceiver::DispatchMessages, this);
+      UpdateDevices();
+      // the path from controller to Lightroom, so it gets all the priority the OS allows
+      dispatch_worker_ = executor_.Spawn({"MIDI dispatch", rsj::ThreadPriority::kRealtime},
+          [this](const rsj::StopToken& stop) { DispatchMessages(stop); },
+          [this] { wake_.Release(); });
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -62,31 +94,110 @@ void MidiReceiver::Start()
    }
 }
 
-void MidiReceiver::handleIncomingMidiMessage(
-    juce::MidiInput* device, const juce::MidiMessage& message)
+void MidiReceiver::SetControlsModel(ControlsModel* controls_model)
+{
+   try {
+      if (controls_model) // slots already in use, e.g. claimed before this was called
+         for (const auto& slot : slots_)
+            if (!slot->identity.name.empty())
+               controls_model->OpenDevice(gsl::narrow_cast<short>(slot->index));
+      controls_model_.store(controls_model, std::memory_order_release);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiReceiver::InputSlot::handleIncomingMidiMessage(
+    juce::MidiInput* /*device*/, const juce::MidiMessage& message)
 {
    try {
       // this procedure is in near-real-time, so must return quickly.
-      // will place message in multithreaded queue and let separate process handle the messages
-      const rsj::MidiMessage mess{message};
+      // will place message in this device's ring and let separate process handle the messages
+      rsj::MidiMessage mess{message};
+#ifdef __LINUX_ALSA__
+      mess.time = InputDevice::MidiTimeOf(message); // kernel's time for the event, not arrival
+#endif
+      Receive(mess);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiReceiver::InputSlot::ReceiveUmp(
+    gsl::span<const std::uint32_t> packet, rsj::MidiTime time)
+{
+   try {
+      auto parsed = rsj::ParseUmp(packet);
+      if (!parsed)
+         return;
+      auto& mess = parsed->message;
+      mess.time = time;
+      if (parsed->is_midi1) {
+         Receive(mess);
+         return;
+      }
+      // MIDI 2.0 values arrive whole, so there is nothing to assemble
+      switch (mess.message_type_byte) {
+      case rsj::kCcFlag:
+         if (const auto* const model = owner_.controls_model_.load(std::memory_order_acquire);
+             model && mess.number < 32 && model->IsCc14Bit(mess.channel, mess.number))
+            rsj::SetUmpValue(mess, parsed->wide_value, 14);
+         [[fallthrough]];
+      case rsj::kNoteOnFlag:
+      case rsj::kPwFlag:
+      case rsj::kRpnFlag:
+         Push(mess);
+         break;
+      default:
+          /* no action if other type of MIDI message */;
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiReceiver::InputSlot::Receive(const rsj::MidiMessage& mess)
+{
+   try {
+      filter.SetMsbTimeout(std::chrono::microseconds(
+          owner_.nrpn_msb_timeout_.load(std::memory_order_relaxed)));
+      // a data entry half that waited too long for the other goes ahead of the message that
+      // revealed it, unless the dispatch thread has already timed it out
+      for (auto expired = filter.TakeDue(mess.time); expired.is_ready;
+           expired = filter.TakeDue(mess.time))
+         Push({expired.is_rpn ? rsj::kRpnFlag : rsj::kCcFlag, expired.channel, expired.control,
+             expired.value, mess.time});
       switch (mess.message_type_byte) {
       case rsj::kCcFlag: {
-         NrpnFilter::ProcessResult result{};
-         {
-            auto lock = std::scoped_lock(filter_mutex_);
-            result = filters_[device](mess.channel, mess.number, mess.value);
-         }
+         const auto result = filter(mess.channel, mess.number, mess.value, mess.time);
          if (result.is_nrpn) {
             if (result.is_ready) { // send when finished
-               messages_.emplace(rsj::kCcFlag, mess.channel, result.control, result.value);
+               Push({result.is_rpn ? rsj::kRpnFlag : rsj::kCcFlag, mess.channel, result.control,
+                   result.value, mess.time});
             }
+            else if (filter.Holding()) // so a parked dispatcher sleeps no longer than the hold
+               owner_.Wake();
             break; // finished with nrpn piece
          }
+         if (const auto* const model = owner_.controls_model_.load(std::memory_order_acquire);
+             model && mess.number < 64 && model->IsCc14Bit(mess.channel, mess.number % 32)) {
+            const auto paired = cc14_filter(mess.channel, mess.number, mess.value);
+            if (paired.is_ready)
+               Push({rsj::kCcFlag, mess.channel, paired.control, paired.value, mess.time});
+            break; // finished with 14-bit pair piece
+         }
       }
          [[fallthrough]]; // if not nrpn, handle like other messages
       case rsj::kNoteOnFlag:
+      case rsj::kNoteOffFlag: // for GestureFilter, which doesn't pass it on
       case rsj::kPwFlag:
-         messages_.push(mess);
+         Push(mess);
          break;
       default:
           /* no action if other type of MIDI message */;
@@ -98,53 +209,332 @@ void MidiReceiver::handleIncomingMidiMessage(
    }
 }
 
+void MidiReceiver::InputSlot::Push(const rsj::MidiMessage& message) noexcept
+{
+   auto stamped{message};
+   stamped.device = gsl::narrow_cast<short>(index);
+   if (replaying.load(std::memory_order_relaxed)) { // unlike a device, wait, don't drop
+      while (!ring.try_push(stamped) && !owner_.stop_replay_.load(std::memory_order_acquire))
+         std::this_thread::yield();
+      owner_.Wake();
+   }
+   else if (ring.try_push(stamped))
+      owner_.Wake();
+   else // dispatcher hopelessly behind, count it and let the dispatcher report it
+      dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MidiReceiver::Wake() noexcept
+{
+   // order the ring write before reading dispatcher_parked_. Only the idle-to-busy transition
+   // posts the semaphore, and the post never takes a lock, so a device callback never waits.
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (dispatcher_parked_.exchange(false, std::memory_order_acq_rel))
+      wake_.Release();
+}
+
 void MidiReceiver::RescanDevices()
 {
    try {
-      for (const auto& dev : devices_) {
-         dev->stop();
-         rsj::Log("Stopped input device " + dev->getName());
+      rsj::Log("Rescanning input devices");
+      UpdateDevices();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool MidiReceiver::UpdateDevices()
+{
+   try {
+      // match open devices to the current list by name; the same name may appear more than once
+      // when identical controllers are attached
+      std::vector<InputSlot*> unmatched{};
+      for (const auto& slot : slots_)
+         if (slot->device && !slot->is_virtual)
+            unmatched.push_back(slot.get());
+      std::vector<int> added{};
+      const auto available = InputDevice::getDevices();
+      for (auto idx = 0; idx < available.size(); ++idx) {
+         const auto name = available[idx];
+         const auto open = std::find_if(unmatched.begin(), unmatched.end(),
+             [&name](const InputSlot* s) { return s->device->getName() == name; });
+         if (open != unmatched.end())
+            unmatched.erase(open);
+         else
+            added.push_back(idx);
+      }
+      for (auto* const slot : unmatched) {
+         slot->device->stop();
+         rsj::Log("Closed removed input device " + slot->device->getName() + " in slot "
+                  + juce::String(slot->index));
+         slot->device.reset();
+         Identify(*slot, {});
       }
-      devices_.clear();
-      rsj::Log("Cleared input devices");
+      auto all_opened{true};
+      for (const auto idx : added) {
+         const auto slot = FreeSlot();
+         if (!slot) {
+            rsj::Log("All input device slots in use, ignoring remaining input devices");
+            break;
+         }
+         const auto dev = InputDevice::openDevice(idx, slot);
+         if (!dev) { // happens on first try on MacOS, caller may retry later
+            rsj::Log("Unable to open input device " + available[idx]);
+            all_opened = false;
+            continue;
+         }
+         slot->filter.Reset(); // device not started yet, so no concurrent use of filters
+         slot->cc14_filter.Reset();
+         slot->device.reset(dev);
+         Identify(*slot, dev->getName());
+         dev->start();
+         rsj::Log(
+             "Opened input device " + dev->getName() + " in slot " + juce::String(slot->index));
+      }
+      return all_opened;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool MidiReceiver::OpenVirtualInput(const juce::String& name)
+{
+   try {
+#ifdef _WIN32
+      rsj::Log("Input ports for other programs aren't available on Windows, not creating " + name);
+      return false;
+#else
+      const auto slot = FreeSlot();
+      if (!slot) {
+         rsj::Log("All input device slots in use, not creating input port " + name);
+         return false;
+      }
+      const auto dev = InputDevice::createNewDevice(name, slot);
+      if (!dev) {
+         rsj::Log("Unable to create input port " + name);
+         return false;
+      }
+      slot->filter.Reset();
+      slot->cc14_filter.Reset();
+      slot->device.reset(dev);
+      slot->is_virtual = true;
+      Identify(*slot, name);
+      dev->start();
+      rsj::Log("Created input port " + name + " in slot " + juce::String(slot->index));
+      return true;
+#endif
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+MidiReceiver::InputSlot* MidiReceiver::FreeSlot() const noexcept
+{
+   const auto slot = std::find_if(slots_.begin(), slots_.end(), [](const auto& s) noexcept {
+      return !s->device && !s->claimed && !s->replaying.load(std::memory_order_acquire);
+   });
+   return slot == slots_.end() ? nullptr : slot->get();
+}
+
+std::optional<size_t> MidiReceiver::ClaimSlot(const juce::String& source_name)
+{
+   try {
+      const auto slot = FreeSlot();
+      if (!slot) {
+         rsj::Log("All input device slots in use, not receiving from " + source_name);
+         return std::nullopt;
+      }
+      slot->claimed = true;
+      Identify(*slot, source_name);
+      rsj::Log("Receiving from " + source_name + " in slot " + juce::String(slot->index));
+      return slot->index;
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
       throw;
    }
-   InitDevices(); // initdevices has own try catch block
 }
 
-void MidiReceiver::TryToOpen()
+void MidiReceiver::Identify(InputSlot& slot, const juce::String& name)
 {
    try {
-      for (auto idx = 0; idx < juce::MidiInput::getDevices().size(); ++idx) {
-         const auto dev = juce::MidiInput::openDevice(idx, this);
-         if (dev) {
-            devices_.emplace_back(dev);
-            dev->start();
-            rsj::Log("Opened input device " + dev->getName());
+      rsj::DeviceIdentity identity{name.toStdString(), 0};
+      if (!identity.name.empty()) // lowest ordinal no other slot with the name has
+         while (std::any_of(slots_.begin(), slots_.end(), [&](const auto& s) {
+            return s.get() != &slot && s->identity == identity;
+         }))
+            ++identity.ordinal;
+      slot.identity = identity;
+      if (const auto controls_model = controls_model_.load(std::memory_order_acquire);
+          controls_model && !identity.name.empty())
+         controls_model->OpenDevice(gsl::narrow_cast<short>(slot.index));
+      for (const auto& cb : slot_callbacks_)
+         cb(slot.index, slot.identity);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiReceiver::Inject(size_t slot, const rsj::MidiMessage& message) noexcept
+{
+   slots_[slot]->Push(message);
+}
+
+void MidiReceiver::Coalesce(const ControlsModel* controls_model)
+{
+   // latest value wins: a newer absolute value overwrites the queued value for the same control in
+   // place and is itself removed from the batch. Everything else keeps its position and order.
+   latest_.clear();
+   size_t kept{0};
+   for (const auto& mm : batch_) {
+      const auto absolute =
+          mm.message_type_byte == rsj::kPwFlag || mm.message_type_byte == rsj::kRpnFlag
+          || (mm.message_type_byte == rsj::kCcFlag && controls_model
+                 && controls_model->GetCcMethod(mm.channel, mm.number) == rsj::CCmethod::kAbsolute);
+      if (absolute) {
+         const rsj::MidiMessageId id{mm};
+         if (const auto queued = std::find_if(latest_.begin(), latest_.end(),
+                 [&id](const auto& entry) noexcept { return entry.first == id; });
+             queued != latest_.end()) {
+            auto& older = batch_.at(queued->second);
+            older.value = mm.value;
+            older.fraction = mm.fraction;
+            continue;
          }
+         latest_.emplace_back(id, kept);
+      }
+      batch_.at(kept++) = mm;
+   }
+   coalesced_.fetch_add(batch_.size() - kept, std::memory_order_relaxed);
+   batch_.resize(kept);
+}
+
+void MidiReceiver::Enrich(ControlsModel* controls_model, const Profile* profile)
+{
+   events_.clear();
+   for (const auto& mm : batch_)
+      events_.push_back({mm, rsj::MidiMessageId{mm}});
+   if (!profile)
+      return;
+   profile->ResolveCommands(events_);
+   if (!controls_model)
+      return;
+   for (auto& event : events_) {
+      if (!event.IsMapped())
+         continue;
+      switch (event.message.message_type_byte) {
+      case rsj::kOscFlag: // no control to move: the argument is the value, its whole part steps
+         event.delta = event.message.value;
+         event.value = std::clamp(event.message.value + event.message.fraction, 0.0, 1.0);
+         break;
+      case rsj::kLongPressFlag:
+      case rsj::kDoubleTapFlag:
+      case rsj::kChordFlag: // a full press, and one step for commands repeated per step
+         event.delta = 1;
+         event.value = 1.0;
+         break;
+      default:
+         // delta first: for absolute controls both store the new position, and the delta is
+         // measured from the old one
+         event.delta = controls_model->MeasureChange(event.message);
+         event.value = controls_model->ControllerToPlugin(event.message);
       }
    }
+}
+
+void MidiReceiver::Deliver(ControlsModel* controls_model, const Profile* profile)
+{
+   Enrich(controls_model, profile);
+   for (const auto& cb : callbacks_)
+#pragma warning(suppress : 26489) // false alarm, checked for existence before adding to callbacks_
+      cb(events_);
+   const auto deferred_count = deferred_count_.load(std::memory_order_acquire);
+   for (size_t i = 0; i < deferred_count; ++i)
+      deferred_.at(i)->Post(events_);
+}
+
+void MidiReceiver::AddDeferred(Callback callback)
+{
+   try {
+      const auto count = deferred_count_.load(std::memory_order_relaxed);
+      if (count == deferred_.size())
+         throw std::length_error("MidiReceiver deferred listener capacity exceeded");
+      deferred_.at(count) = std::make_unique<DeferredListener>(callback, executor_);
+      deferred_count_.store(count + 1, std::memory_order_release);
+   }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
       throw;
    }
 }
 
-void MidiReceiver::InitDevices()
+MidiReceiver::DeferredListener::DeferredListener(Callback callback, rsj::Executor& executor)
+    : callback_{callback}
 {
-   using namespace std::chrono_literals;
    try {
-      rsj::Log("Trying to open input devices");
-      TryToOpen();
-      if (devices_.empty()) // encountering errors first try on MacOS
+      queued_.reserve(kDispatchBurst);
+      running_.reserve(kDispatchBurst);
+      worker_ = executor.Spawn({"MIDI listener"},
+          [this](const rsj::StopToken& stop) { Run(stop); },
+          [this] {
+             {
+                auto lock{std::scoped_lock(mutex_)};
+             }
+             condition_.notify_one();
+          });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+#pragma warning(push)
+#pragma warning(disable : 26447)
+MidiReceiver::DeferredListener::~DeferredListener()
+{
+   try {
+      worker_.Stop();
+      if (dropped_)
+         rsj::Log(juce::String(dropped_) + " MIDI events dropped, deferred listener behind");
+   }
+   catch (const std::exception& e) {
+      rsj::LogAndAlertError(
+          juce::String("Exception in MidiReceiver DeferredListener Destructor. ") + e.what());
+      std::terminate();
+   }
+   catch (...) {
+      rsj::LogAndAlertError(
+          "Exception in MidiReceiver DeferredListener Destructor. Non-standard exception.");
+      std::terminate();
+   }
+}
+#pragma warning(pop)
+
+void MidiReceiver::DeferredListener::Post(gsl::span<const rsj::MidiEvent> events)
+{
+   try {
+      bool was_empty{};
       {
-         rsj::Log("Retrying to open input devices");
-         rsj::SleepTimedLogged("Open input devices", 20ms);
-         TryToOpen();
+         auto lock{std::scoped_lock(mutex_)};
+         was_empty = queued_.empty();
+         queued_.insert(queued_.end(), events.begin(), events.end());
+         if (queued_.size() > kCapacity) { // listener is hopelessly behind, keep the newest
+            const auto excess = queued_.size() - kCapacity;
+            queued_.erase(queued_.begin(), queued_.begin() + excess);
+            dropped_ += excess;
+         }
       }
+      if (was_empty) // otherwise the worker hasn't taken the last post yet and will see this one
+         condition_.notify_one();
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -152,16 +542,20 @@ void MidiReceiver::InitDevices()
    }
 }
 
-void MidiReceiver::DispatchMessages()
+void MidiReceiver::DeferredListener::Run(const rsj::StopToken& stop)
 {
    try {
       do {
-         auto message_copy = messages_.pop();
-         if (message_copy == kTerminate)
-            return;
-         for (const auto& cb : callbacks_)
-#pragma warning(suppress : 26489) // false alarm, checked for existence before adding to callbacks_
-            cb(message_copy);
+         running_.clear();
+         {
+            auto lock{std::unique_lock(mutex_)};
+            condition_.wait(lock, [&] { return stop.StopRequested() || !queued_.empty(); });
+            if (stop.StopRequested())
+               return;
+            running_.swap(queued_); // everything queued, one lock acquisition
+         }
+#pragma warning(suppress : 26489) // false alarm, checked for existence before constructing
+         callback_(running_);
       } while (true);
    }
    catch (const std::exception& e) {
@@ -169,3 +563,371 @@ void MidiReceiver::DispatchMessages()
       throw;
    }
 }
+
+bool MidiReceiver::DispatchQueued()
+{
+   auto* const controls_model = controls_model_.load(std::memory_order_acquire);
+   const auto* const profile = profile_.load(std::memory_order_acquire);
+   auto dispatched{false};
+   for (const auto& slot : slots_) {
+      batch_.clear();
+      while (batch_.size() < kDispatchBurst) {
+         const auto message = slot->ring.try_pop();
+         if (!message)
+            break;
+         batch_.push_back(*message);
+      }
+      const auto popped = batch_.size();
+      if (slot->filter.Holding()) { // data entry halves timed out without their device's help
+         const auto now = rsj::MidiClock::now();
+         for (auto due = slot->filter.TakeDue(now); due.is_ready;
+              due = slot->filter.TakeDue(now)) {
+            batch_.push_back({due.is_rpn ? rsj::kRpnFlag : rsj::kCcFlag, due.channel,
+                due.control, due.value, now});
+            batch_.back().device = gsl::narrow_cast<short>(slot->index);
+         }
+      }
+      if (batch_.empty())
+         continue;
+      dispatched = true;
+      const auto picked_up = rsj::MidiClock::now();
+      for (size_t i = 0; i < popped; ++i)
+         ring_latency_.Record(batch_[i].time, picked_up);
+      if (capturing_.load(std::memory_order_acquire)) {
+         auto lock{std::scoped_lock(capture_mutex_)};
+         if (capture_)
+            for (const auto& mm : batch_)
+               capture_->Write(gsl::narrow_cast<size_t>(mm.device), mm);
+      }
+      // only a backlog leaves more than one message
+      if (batch_.size() > 1 && coalescing_.load(std::memory_order_relaxed))
+         Coalesce(controls_model);
+      gestures_.Process(batch_, profile);
+      if (!batch_.empty())
+         Deliver(controls_model, profile);
+      if (const auto dropped = slot->dropped.exchange(0, std::memory_order_relaxed))
+         rsj::Log(juce::String(dropped) + " MIDI messages dropped, input ring full");
+   }
+   return dispatched;
+}
+
+bool MidiReceiver::DispatchGestures()
+{
+   batch_.clear();
+   gestures_.Expire(rsj::MidiClock::now(), batch_);
+   if (batch_.empty())
+      return false;
+   Deliver(
+       controls_model_.load(std::memory_order_acquire), profile_.load(std::memory_order_acquire));
+   return true;
+}
+
+std::optional<rsj::MidiTime> MidiReceiver::NextDue() const
+{
+   auto due = gestures_.NextDue();
+   for (const auto& slot : slots_)
+      if (const auto held = slot->filter.NextDue(); held && (!due || *held < *due))
+         due = held;
+   return due;
+}
+
+void MidiReceiver::DispatchMessages(const rsj::StopToken& stop)
+{
+   try {
+      while (!stop.StopRequested()) {
+         const auto dispatched = DispatchQueued();
+         if (DispatchGestures() || dispatched)
+            continue;
+         // nothing queued. Announce we are parking, then look once more so a message pushed
+         // before the announcement is not missed; Wake clears the flag and posts once.
+         dispatcher_parked_.store(true, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         if (std::any_of(slots_.begin(), slots_.end(),
+                 [](const auto& s) noexcept { return !s->ring.empty(); })) {
+            dispatcher_parked_.store(false, std::memory_order_relaxed);
+            continue;
+         }
+         if (const auto due = NextDue()) { // sleep no longer than a gesture or a held half
+            // a Wake that cleared the flag as the wait ran out still posts; take that post so
+            // the count stays at zero while busy
+            if (!wake_.AcquireUntil(*due)
+                && !dispatcher_parked_.exchange(false, std::memory_order_acq_rel))
+               wake_.Acquire();
+         }
+         else
+            wake_.Acquire();
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool MidiReceiver::StartCapture(const std::string& file_name)
+{
+   try {
+      auto writer = std::make_unique<rsj::MidiCaptureWriter>(file_name);
+      if (!writer->IsOpen()) {
+         rsj::Log("Unable to create MIDI capture file " + juce::String(file_name));
+         return false;
+      }
+      {
+         auto lock{std::scoped_lock(capture_mutex_)};
+         capture_.swap(writer); // any previous capture is closed outside the lock
+         capturing_.store(true, std::memory_order_release);
+      }
+      rsj::Log("Capturing MIDI input to " + juce::String(file_name));
+      return true;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiReceiver::StopCapture()
+{
+   try {
+      std::unique_ptr<rsj::MidiCaptureWriter> writer{nullptr};
+      {
+         auto lock{std::scoped_lock(capture_mutex_)};
+         capturing_.store(false, std::memory_order_release);
+         writer.swap(capture_);
+      }
+      if (writer)
+         rsj::Log(juce::String(writer->Count()) + " MIDI messages captured");
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool MidiReceiver::Replay(const std::string& file_name, double speed)
+{
+   try {
+      if (replay_worker_.Running()) {
+         rsj::Log("MIDI replay already running, not replaying " + juce::String(file_name));
+         return false;
+      }
+      auto messages = rsj::ReadMidiCapture(file_name);
+      if (!messages)
+         return false;
+      // every device in the capture gets a slot no device is using, and UpdateDevices leaves those
+      // slots alone until the replay finishes, so each ring still has a single producer
+      std::vector<InputSlot*> slot_for_device{};
+      for (const auto& captured : *messages) {
+         if (captured.device >= slot_for_device.size())
+            slot_for_device.resize(captured.device + 1, nullptr);
+         auto& assigned = slot_for_device.at(captured.device);
+         if (assigned)
+            continue;
+         const auto slot = FreeSlot();
+         if (!slot) {
+            rsj::Log("Not enough free input slots to replay " + juce::String(file_name));
+            for (auto* const reserved : slot_for_device)
+               if (reserved)
+                  reserved->replaying.store(false, std::memory_order_release);
+            return false;
+         }
+         slot->replaying.store(true, std::memory_order_release);
+         assigned = slot;
+      }
+      // replayed messages carry their replay slot's number, so they have control positions and
+      // buttons of their own and live devices are left alone
+      if (const auto controls_model = controls_model_.load(std::memory_order_acquire))
+         for (auto* const slot : slot_for_device)
+            if (slot)
+               controls_model->OpenDevice(gsl::narrow_cast<short>(slot->index));
+      rsj::Log("Replaying " + juce::String(messages->size()) + " MIDI messages from "
+               + juce::String(file_name) + " at speed " + juce::String(speed));
+      // join the finished replay first: replacing it would run its wake, stopping this one
+      replay_worker_.Stop();
+      stop_replay_.store(false, std::memory_order_release);
+      replay_worker_ = executor_.Spawn(
+          {"MIDI replay"},
+          [this, replayed = std::move(*messages), slots = std::move(slot_for_device), speed](
+              const rsj::StopToken&) mutable {
+             ReplayMessages(std::move(replayed), std::move(slots), speed);
+          },
+          [this] { stop_replay_.store(true, std::memory_order_release); });
+      return true;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiReceiver::ReplayMessages(std::vector<rsj::CapturedMidi> messages,
+    std::vector<InputSlot*> slot_for_device, double speed)
+{
+   try {
+      const auto start = rsj::MidiClock::now();
+      for (const auto& captured : messages) {
+         if (stop_replay_.load(std::memory_order_acquire))
+            break;
+         if (speed > 0.0
+             && !SleepUntil(start
+                            + std::chrono::duration_cast<rsj::MidiClock::duration>(
+                                captured.offset / speed)))
+            break;
+         auto* const slot = slot_for_device.at(captured.device);
+         auto message = captured.message;
+         message.device = gsl::narrow_cast<short>(slot->index);
+         message.time = rsj::MidiClock::now();
+         while (!slot->ring.try_push(message) && !stop_replay_.load(std::memory_order_acquire))
+            std::this_thread::yield(); // unlike a device, wait for the dispatcher, don't drop
+         Wake();
+      }
+      const auto elapsed = rsj::MidiClock::now() - start;
+      for (auto* const slot : slot_for_device)
+         if (slot)
+            slot->replaying.store(false, std::memory_order_release);
+      rsj::Log("MIDI replay finished after "
+               + juce::String(std::chrono::duration<double, std::milli>(elapsed).count())
+               + " milliseconds");
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool MidiReceiver::PlayUmp(std::vector<rsj::UmpPacket> packets, double speed)
+{
+   try {
+      if (replay_worker_.Running()) {
+         rsj::Log("MIDI replay already running, not playing UMP stream");
+         return false;
+      }
+      const auto slot = FreeSlot();
+      if (!slot) {
+         rsj::Log("No free input slot to play UMP stream");
+         return false;
+      }
+      slot->filter.Reset(); // no producer until the replay thread starts
+      slot->cc14_filter.Reset();
+      if (const auto controls_model = controls_model_.load(std::memory_order_acquire))
+         controls_model->OpenDevice(gsl::narrow_cast<short>(slot->index));
+      slot->replaying.store(true, std::memory_order_release);
+      rsj::Log("Playing " + juce::String(packets.size()) + " UMP packets in slot "
+               + juce::String(slot->index) + " at speed " + juce::String(speed));
+      // join the finished replay first: replacing it would run its wake, stopping this one
+      replay_worker_.Stop();
+      stop_replay_.store(false, std::memory_order_release);
+      replay_worker_ = executor_.Spawn(
+          {"MIDI replay"},
+          [this, played = std::move(packets), slot, speed](const rsj::StopToken&) mutable {
+             PlayUmpPackets(std::move(played), slot, speed);
+          },
+          [this] { stop_replay_.store(true, std::memory_order_release); });
+      return true;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiReceiver::PlayUmpPackets(
+    std::vector<rsj::UmpPacket> packets, InputSlot* slot, double speed)
+{
+   try {
+      const auto start = rsj::MidiClock::now();
+      for (const auto& packet : packets) {
+         if (stop_replay_.load(std::memory_order_acquire))
+            break;
+         if (speed > 0.0
+             && !SleepUntil(start
+                            + std::chrono::duration_cast<rsj::MidiClock::duration>(
+                                packet.offset / speed)))
+            break;
+         slot->ReceiveUmp(packet.words, rsj::MidiClock::now());
+      }
+      const auto elapsed = rsj::MidiClock::now() - start;
+      slot->replaying.store(false, std::memory_order_release);
+      rsj::Log("UMP stream finished after "
+               + juce::String(std::chrono::duration<double, std::milli>(elapsed).count())
+               + " milliseconds");
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+std::string MidiReceiver::NrpnBenchmark(rsj::Executor& executor, int devices, int nrpns)
+{
+   try {
+      Expects(devices > 0 && devices <= gsl::narrow_cast<int>(rsj::kMaxInputDevices) && nrpns > 0);
+      MidiReceiver receiver{executor};
+      // a sender descheduled between data MSB and LSB mustn't split the NRPN in two
+      receiver.SetNrpnMsbTimeout(std::chrono::seconds(10));
+      std::atomic<bool> go{false};
+      std::vector<std::thread> senders{};
+      senders.reserve(gsl::narrow_cast<size_t>(devices));
+      for (auto d = 0; d < devices; ++d) {
+         auto& slot = *receiver.slots_.at(gsl::narrow_cast<size_t>(d));
+         slot.replaying.store(true, std::memory_order_release); // wait for room, don't drop
+         senders.emplace_back([&slot, &go, nrpns] {
+            while (!go.load(std::memory_order_acquire))
+               std::this_thread::yield();
+            for (auto i = 0; i < nrpns; ++i) {
+               const auto channel = gsl::narrow_cast<short>(i % 16);
+               // 0x3FFF is the null parameter, which deselects
+               const auto parameter = gsl::narrow_cast<short>((i * 31 + slot.index) % 0x3FFF);
+               const auto value = gsl::narrow_cast<short>(i % 0x4000);
+               const auto now = rsj::MidiClock::now();
+               const auto cc = [&](short number, int cc_value) {
+                  slot.Receive({rsj::kCcFlag, channel, number, gsl::narrow_cast<short>(cc_value),
+                      now});
+               };
+               cc(99, parameter >> 7);
+               cc(98, parameter & 0x7F);
+               cc(6, value >> 7);
+               cc(38, value & 0x7F);
+            }
+         });
+      }
+      rsj::LatencyHistogram latency{};
+      const auto total = 1LL * devices * nrpns;
+      const auto start = rsj::MidiClock::now();
+      go.store(true, std::memory_order_release);
+      for (auto received = 0LL; received < total;) {
+         auto idle{true};
+         for (auto d = 0; d < devices; ++d)
+            for (auto& ring = receiver.slots_.at(gsl::narrow_cast<size_t>(d))->ring;
+                 const auto message = ring.try_pop();) {
+               latency.Record(message->time, rsj::MidiClock::now());
+               ++received;
+               idle = false;
+            }
+         if (idle)
+            std::this_thread::yield();
+      }
+      const std::chrono::duration<double> elapsed{rsj::MidiClock::now() - start};
+      for (auto& sender : senders)
+         sender.join();
+      return "NRPN slots: " + std::to_string(devices) + " devices x " + std::to_string(nrpns)
+             + " NRPNs, " + std::to_string(static_cast<double>(total) / elapsed.count())
+             + " NRPNs/s, Receive to ring latency " + latency.Summary();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("MidiReceiver", __func__, e);
+      throw;
+   }
+}
+
+bool MidiReceiver::SleepUntil(rsj::MidiTime due) const
+{
+   using namespace std::chrono_literals;
+   // sleep in slices so shutdown isn't held up by a long pause in the stream
+   for (auto now = rsj::MidiClock::now(); now < due; now = rsj::MidiClock::now()) {
+      if (stop_replay_.load(std::memory_order_acquire))
+         return false;
+      std::this_thread::sleep_for(std::min<rsj::MidiClock::duration>(due - now, 50ms));
+   }
+   return !stop_replay_.load(std::memory_order_acquire);
+}
@@ -20,42 +20,159 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <exception>
-#include <functional>
-#include <future>
-#include <map> //map faster than unordered_map for very few members
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <gsl/gsl>
 #include <JuceLibraryCode/JuceHeader.h>
+#include "AlsaMidi.h"
 #include "Concurrency.h"
+#include "Delegate.h"
+#include "Executor.h"
+#include "GestureFilter.h"
+#include "LatencyHistogram.h"
+#include "MidiCapture.h"
 #include "MidiUtilities.h"
 #include "Misc.h"
 #include "NrpnMessage.h"
+#include "Ump.h"
 
 #ifndef _MSC_VER
 #define _In_
 #endif
+class ControlsModel;
+class Profile;
 
-class MidiReceiver final : juce::MidiInputCallback {
+class MidiReceiver final {
  public:
-   MidiReceiver() = default;
+#ifdef __LINUX_ALSA__
+   using InputDevice = rsj::AlsaMidiInput;
+#else
+   using InputDevice = juce::MidiInput;
+#endif
+   explicit MidiReceiver(rsj::Executor& executor);
    ~MidiReceiver();
    MidiReceiver(const MidiReceiver& other) = delete;
    MidiReceiver(MidiReceiver&& other) = delete;
    MidiReceiver& operator=(const MidiReceiver& other) = delete;
    MidiReceiver& operator=(MidiReceiver&& other) = delete;
    void Start();
-   // re-enumerates MIDI IN devices
+   // re-enumerates MIDI IN devices, closing removed devices and opening new ones. Devices that
+   // are still attached keep streaming and keep their NRPN state.
    void RescanDevices();
+   // as RescanDevices, returns false if a listed device failed to open and a retry may help.
+   // Message thread only.
+   bool UpdateDevices();
+   // opens an input port other programs can connect to, in a free slot, and keeps it open until
+   // the receiver is destroyed. Returns false if it can't be created (always on Windows) or
+   // every slot is in use. Message thread only.
+   bool OpenVirtualInput(const juce::String& name);
+   // gives a free slot to an input source that isn't a MIDI device, such as OscReceiver, for the
+   // life of the receiver. Returns the slot's index, or nullopt if every slot is in use. Message
+   // thread only.
+   [[nodiscard]] std::optional<size_t> ClaimSlot(const juce::String& source_name);
+   // hands a message from a claimed slot's source to the dispatch thread, dropping it if the
+   // slot's ring is full as for a device. Only one thread may inject into a slot.
+   void Inject(size_t slot, const rsj::MidiMessage& message) noexcept;
+   // when a backlog builds up, a newer absolute value replaces an older queued value for the
+   // same control instead of being dispatched after it. Pitch bend and RPNs are always absolute;
+   // CCs are coalesced only if the controls model says they are. Relative CCs and notes never
+   // are. Only a backlog in the input rings is seen here; values waiting on a slow plugin are
+   // coalesced in LrIpcOut's queue. Off until turned on
+   void SetCoalescing(bool enabled) noexcept
+   {
+      coalescing_.store(enabled, std::memory_order_relaxed);
+   }
+   // controls_model supplies the CC methods and 14-bit CC opt-ins, and moves the controls of
+   // mapped messages; nullptr leaves events without a value, CC pairs unjoined and CCs
+   // uncoalesced. Each slot's control positions are set up as it is given to a source. Message
+   // thread only
+   void SetControlsModel(ControlsModel* controls_model);
+   // how long an NRPN data entry MSB waits for its LSB before it is sent on its own, after which
+   // that channel is treated as MSB-only. Zero sends every MSB at once. The dispatch thread sends
+   // a timed-out MSB even if the device sends nothing more.
+   void SetNrpnMsbTimeout(std::chrono::milliseconds timeout) noexcept
+   {
+      nrpn_msb_timeout_.store(
+          std::chrono::duration_cast<std::chrono::microseconds>(timeout).count(),
+          std::memory_order_relaxed);
+   }
+   // profile resolves each message's command before the listeners are called, and tells
+   // GestureFilter which notes have gestures mapped. nullptr leaves every message unmapped
+   void SetProfile(const Profile* profile) noexcept
+   {
+      profile_.store(profile, std::memory_order_release);
+   }
+   [[nodiscard]] unsigned long long GetCoalescedCount() const noexcept
+   {
+      return coalesced_.load(std::memory_order_relaxed);
+   }
+   // writes every message the dispatch thread takes from the device rings to file_name, see
+   // MidiCapture.h for the format. Returns false if the file can't be created.
+   bool StartCapture(const std::string& file_name);
+   void StopCapture();
+   // feeds a capture file into the dispatch path through otherwise unused input slots, so no MIDI
+   // hardware is needed. speed 1.0 keeps the recorded timing, 2.0 plays twice as fast, and 0 or
+   // less injects as fast as the dispatcher accepts. Messages are stamped when injected and carry
+   // their replay slot's number, so only any-device profile rows map them. Returns false if the
+   // file can't be read, a replay is running or there are not enough free slots.
+   bool Replay(const std::string& file_name, double speed);
+   // feeds Universal MIDI Packets, e.g. from rsj::SyntheticUmpStream, into a free input slot as if
+   // from a MIDI 2.0 device, timed by each packet's offset. speed as for Replay. Shares the
+   // replay thread, so returns false if a replay is running or no slot is free.
+   bool PlayUmp(std::vector<rsj::UmpPacket> packets, double speed);
+   // devices threads, standing in for device callbacks, each send nrpns NRPNs through their own
+   // slot's Receive, interleaving channels and parameters, to a receiver of its own that isn't
+   // started, so the calling thread takes them from the rings. Returns a line with the NRPN rate
+   // and the Receive to ring latency, for the log
+   [[nodiscard]] static std::string NrpnBenchmark(rsj::Executor& executor, int devices, int nrpns);
 
-   template<class T>
-   void AddCallback(_In_ T* const object, _In_ void (T::*const mf)(rsj::MidiMessage))
+   // kImmediate listeners are called on the dispatch thread as each burst is decoded, in the
+   // order added, and should be quick: they are the path to Lightroom. Each kDeferred listener
+   // gets its own queue and thread, is handed the burst after every immediate listener has
+   // returned, and may fall behind without delaying anything else; when its queue is full the
+   // oldest events are dropped.
+   enum class Priority { kImmediate, kDeferred };
+   // listeners receive events in bursts, in arrival order per device. The profile lookup and the
+   // control's new value are worked out once per message for all listeners, see rsj::MidiEvent
+   // usage: AddCallback<&Listener::Method>(this) or AddCallback<&Listener::Method>(this, priority)
+   template<auto MemFn, class T>
+   void AddCallback(_In_ T* const object, Priority priority = Priority::kImmediate)
+   {
+      try {
+         if (priority == Priority::kImmediate)
+            callbacks_.Add<MemFn>(object);
+         else if (object)
+            AddDeferred(Callback::Bind<MemFn>(object));
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+   // slot listeners are called on the message thread when a device, input port or claimed source
+   // is given a slot, before it can send anything, and with an empty name when it leaves the
+   // slot. Replays aren't announced. A listener added later is told about the slots in use.
+   // usage: AddSlotCallback<&Listener::Method>(this), with Method(size_t, const DeviceIdentity&)
+   template<auto MemFn, class T> void AddSlotCallback(_In_ T* const object)
    {
       try {
-         using namespace std::placeholders;
-         if (object && mf) // only store non-empty functions
-            callbacks_.emplace_back(std::bind(mf, object, _1));
+         if (!object)
+            return;
+         slot_callbacks_.Add<MemFn>(object);
+         for (const auto& slot : slots_)
+            if (!slot->identity.name.empty())
+               (object->*MemFn)(slot->index, slot->identity);
       }
       catch (const std::exception& e) {
          rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -64,16 +181,109 @@ class MidiReceiver final : juce::MidiInputCallback {
    }
 
  private:
-   void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage&) override;
-   void DispatchMessages();
-   void InitDevices();
-   void TryToOpen(); // inner code for InitDevices
-   rsj::BlockingQueue<rsj::MidiMessage> messages_;
-   rsj::SpinLock filter_mutex_;
-   std::future<void> dispatch_messages_future_;
-   std::map<juce::MidiInput*, NrpnFilter> filters_{};
-   std::vector<std::function<void(rsj::MidiMessage)>> callbacks_;
-   std::vector<std::unique_ptr<juce::MidiInput>> devices_;
+   static constexpr size_t kRingSize{1024};
+   using Callback = rsj::Delegate<void(gsl::span<const rsj::MidiEvent>)>;
+   // queue and thread for one kDeferred listener. Post never waits for the listener, only for
+   // the worker to swap out the queue.
+   class DeferredListener final {
+    public:
+      DeferredListener(Callback callback, rsj::Executor& executor);
+      ~DeferredListener();
+      DeferredListener(const DeferredListener& other) = delete;
+      DeferredListener(DeferredListener&& other) = delete;
+      DeferredListener& operator=(const DeferredListener& other) = delete;
+      DeferredListener& operator=(DeferredListener&& other) = delete;
+      void Post(gsl::span<const rsj::MidiEvent> events);
+
+    private:
+      static constexpr size_t kCapacity{4096};
+      void Run(const rsj::StopToken& stop);
+      const Callback callback_;
+      unsigned long long dropped_{0};
+      std::condition_variable condition_{};
+      std::mutex mutex_{};
+      std::vector<rsj::MidiEvent> queued_{};
+      std::vector<rsj::MidiEvent> running_{}; // worker thread only
+      rsj::Worker worker_{};                  // declared last, stopped before the rest go
+   };
+   // one per opened device, index fixed for the life of the receiver. The device's callback
+   // thread is the only producer for the ring and feeds the NRPN filter, and the dispatch thread
+   // is the only consumer of the ring and only takes timed-out halves from the filter, so the
+   // callback never waits on another thread.
+   class InputSlot final : public juce::MidiInputCallback {
+    public:
+      InputSlot(MidiReceiver& owner, size_t slot_index) noexcept
+          : index{slot_index}, owner_{owner}
+      {
+      }
+      // assembles NRPNs and 14-bit CCs, then pushes. Called from the device's callback thread,
+      // or the replay thread for a slot reserved with replaying
+      void Receive(const rsj::MidiMessage& message);
+      void ReceiveUmp(gsl::span<const std::uint32_t> packet, rsj::MidiTime time);
+      // stamps index as the device. Drops the message if the ring is full, unless replaying
+      void Push(const rsj::MidiMessage& message) noexcept;
+      const size_t index;
+      std::atomic<bool> replaying{false}; // ring's producer is the replay thread, not a device
+      std::atomic<unsigned> dropped{0};
+      NrpnFilter filter{};
+      Cc14Filter cc14_filter{};
+      rsj::SpscRing<rsj::MidiMessage, kRingSize> ring;
+      std::unique_ptr<InputDevice> device{nullptr};
+      bool is_virtual{false}; // message thread only, left alone by UpdateDevices
+      bool claimed{false};    // message thread only, fed by Inject and never given a device
+      rsj::DeviceIdentity identity{}; // message thread only, no name unless something has the slot
+
+    private:
+      void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage&) override;
+      MidiReceiver& owner_;
+   };
+   void AddDeferred(Callback callback);
+   // a slot with no device, not replaying and not claimed. Message thread only
+   [[nodiscard]] InputSlot* FreeSlot() const noexcept;
+   // names the slot after its new user, numbered among the slots in use with the same name, and
+   // tells the slot listeners. An empty name when the user leaves. Message thread only
+   void Identify(InputSlot& slot, const juce::String& name);
+   void Coalesce(const ControlsModel* controls_model);
+   void Enrich(ControlsModel* controls_model, const Profile* profile);
+   // enriches batch_ and hands it to the listeners
+   void Deliver(ControlsModel* controls_model, const Profile* profile);
+   void DispatchMessages(const rsj::StopToken& stop);
+   [[nodiscard]] bool DispatchQueued();
+   [[nodiscard]] bool DispatchGestures(); // presses and gestures GestureFilter let go of
+   // the next gesture deadline or held NRPN half timeout, whichever comes first
+   [[nodiscard]] std::optional<rsj::MidiTime> NextDue() const;
+   void ReplayMessages(std::vector<rsj::CapturedMidi> messages,
+       std::vector<InputSlot*> slot_for_device, double speed);
+   void PlayUmpPackets(std::vector<rsj::UmpPacket> packets, InputSlot* slot, double speed);
+   bool SleepUntil(rsj::MidiTime due) const; // false if the replay is stopped
+   void Wake() noexcept;
+   std::atomic<ControlsModel*> controls_model_{nullptr};
+   std::atomic<const Profile*> profile_{nullptr};
+   std::atomic<bool> coalescing_{false};
+   std::atomic<unsigned long long> coalesced_{0};
+   std::atomic<long long> nrpn_msb_timeout_{20'000}; // microseconds
+   rsj::LatencyHistogram ring_latency_{}; // input callback to dispatch thread
+   std::atomic<bool> dispatcher_parked_{false};
+   rsj::Semaphore wake_{}; // posted by Wake and by the dispatch worker's stop
+   rsj::ListenerRegistry<void(gsl::span<const rsj::MidiEvent>)> callbacks_;
+   rsj::ListenerRegistry<void(size_t, const rsj::DeviceIdentity&)> slot_callbacks_;
+   // filled before the count is published, so the dispatch thread may read while one is added
+   std::array<std::unique_ptr<DeferredListener>, 4> deferred_{};
+   std::atomic<size_t> deferred_count_{0};
+   std::atomic<bool> capturing_{false};
+   std::atomic<bool> stop_replay_{false}; // set by replay_worker_'s wake, seen by Push too
+   std::mutex capture_mutex_{}; // uncontended except while starting or stopping a capture
+   std::unique_ptr<rsj::MidiCaptureWriter> capture_{nullptr};
+   // dispatch thread only
+   std::vector<rsj::MidiMessage> batch_{};
+   std::vector<rsj::MidiEvent> events_{};
+   std::vector<std::pair<rsj::MidiMessageId, size_t>> latest_{};
+   GestureFilter gestures_{};
+   std::vector<std::unique_ptr<InputSlot>> slots_; // filled in constructor, never resized
+   rsj::Executor& executor_;
+   // declared last so the threads are joined before the slots they use are destroyed
+   rsj::Worker replay_worker_{};
+   rsj::Worker dispatch_worker_{};
 };
 
 #endif // MIDI2LR_MIDIRECEIVER_H_INCLUDED
@@ -20,7 +20,10 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "MIDISender.h"
 
+#include <algorithm>
 #include <exception>
+#include <iterator>
+#include <mutex>
 
 #include <gsl/gsl>
 #include <JuceLibraryCode/JuceHeader.h>
@@ -29,7 +32,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 void MidiSender::Start()
 {
    try {
-      InitDevices();
+      UpdateDevices();
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -37,10 +40,21 @@ void MidiSender::Start()
    }
 }
 
-void MidiSender::SendCc(int midi_channel, int controller, int value) const
+void MidiSender::SendCc(int midi_channel, int controller, int value, bool high_resolution) const
 {
    try {
-      if (controller < 128) { // regular message
+      auto lock = std::shared_lock(devices_mtx_);
+      if (high_resolution && controller < 32) { // MSB, then LSB
+         const auto value_lsb = value & 0x7f;
+         const auto value_msb = value >> 7 & 0x7F;
+         for (const auto& dev : output_devices_) {
+            dev->sendMessageNow(
+                juce::MidiMessage::controllerEvent(midi_channel, controller, value_msb));
+            dev->sendMessageNow(
+                juce::MidiMessage::controllerEvent(midi_channel, controller + 32, value_lsb));
+         }
+      }
+      else if (controller < 128) { // regular message
          for (const auto& dev : output_devices_)
             dev->sendMessageNow(
                 juce::MidiMessage::controllerEvent(midi_channel, controller, value));
@@ -69,6 +83,7 @@ void MidiSender::SendCc(int midi_channel, int controller, int value) const
 void MidiSender::SendNoteOn(int midi_channel, int controller, int value) const
 {
    try {
+      auto lock = std::shared_lock(devices_mtx_);
       for (const auto& dev : output_devices_)
          dev->sendMessageNow(juce::MidiMessage::noteOn(
              midi_channel, controller, gsl::narrow_cast<juce::uint8>(value)));
@@ -82,6 +97,7 @@ void MidiSender::SendNoteOn(int midi_channel, int controller, int value) const
 void MidiSender::SendPitchWheel(int midi_channel, int value) const
 {
    try {
+      auto lock = std::shared_lock(devices_mtx_);
       for (const auto& dev : output_devices_)
          dev->sendMessageNow(juce::MidiMessage::pitchWheel(midi_channel, value));
    }
@@ -91,12 +107,32 @@ void MidiSender::SendPitchWheel(int midi_channel, int value) const
    }
 }
 
+void MidiSender::SendRpn(int midi_channel, int parameter, int value) const
+{
+   try {
+      const auto parameter_lsb = parameter & 0x7f;
+      const auto parameter_msb = parameter >> 7 & 0x7F;
+      const auto value_lsb = value & 0x7f;
+      const auto value_msb = value >> 7 & 0x7F;
+      auto lock = std::shared_lock(devices_mtx_);
+      for (const auto& dev : output_devices_) {
+         dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 101, parameter_msb));
+         dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 100, parameter_lsb));
+         dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 6, value_msb));
+         dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 38, value_lsb));
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
 void MidiSender::RescanDevices()
 {
    try {
-      output_devices_.clear();
-      rsj::Log("Cleared output devices");
-      InitDevices();
+      rsj::Log("Rescanning output devices");
+      UpdateDevices();
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -104,19 +140,85 @@ void MidiSender::RescanDevices()
    }
 }
 
-void MidiSender::InitDevices()
+bool MidiSender::UpdateDevices()
 {
    try {
-      for (auto idx = 0; idx < juce::MidiOutput::getDevices().size(); ++idx) {
-         auto dev = juce::MidiOutput::openDevice(idx);
-         if (dev) {
-            output_devices_.emplace_back(dev);
+      // only called on the message thread, so output_devices_ can't change between the two locks.
+      // New devices are opened without the lock, so sending is only held up for the swap.
+      std::vector<OutputDevice*> unmatched{};
+      std::vector<std::unique_ptr<OutputDevice>> added{};
+      auto all_opened{true};
+      {
+         auto lock = std::shared_lock(devices_mtx_);
+         for (const auto& dev : output_devices_)
+            if (std::find(virtual_devices_.begin(), virtual_devices_.end(), dev.get())
+                == virtual_devices_.end())
+               unmatched.push_back(dev.get());
+      }
+      const auto available = OutputDevice::getDevices();
+      for (auto idx = 0; idx < available.size(); ++idx) {
+         const auto name = available[idx];
+         const auto open = std::find_if(unmatched.begin(), unmatched.end(),
+             [&name](const OutputDevice* d) { return d->getName() == name; });
+         if (open != unmatched.end()) {
+            unmatched.erase(open);
+            continue;
+         }
+         if (auto dev = OutputDevice::openDevice(idx)) {
+            added.emplace_back(dev);
             rsj::Log("Opened output device " + dev->getName());
          }
+         else {
+            rsj::Log("Unable to open output device " + available[idx]);
+            all_opened = false;
+         }
+      }
+      if (unmatched.empty() && added.empty())
+         return all_opened;
+      std::vector<std::unique_ptr<OutputDevice>> removed{};
+      {
+         auto lock = std::unique_lock(devices_mtx_);
+         const auto keep = std::stable_partition(output_devices_.begin(), output_devices_.end(),
+             [&unmatched](const auto& dev) {
+                return std::find(unmatched.begin(), unmatched.end(), dev.get()) == unmatched.end();
+             });
+         std::move(keep, output_devices_.end(), std::back_inserter(removed));
+         output_devices_.erase(keep, output_devices_.end());
+         std::move(added.begin(), added.end(), std::back_inserter(output_devices_));
       }
+      for (const auto& dev : removed)
+         rsj::Log("Closed removed output device " + dev->getName());
+      return all_opened;
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
       throw;
    }
-}
\ No newline at end of file
+}
+
+bool MidiSender::OpenVirtualOutput(const juce::String& name)
+{
+   try {
+#ifdef _WIN32
+      rsj::Log("Output ports for other programs aren't available on Windows, not creating " + name);
+      return false;
+#else
+      std::unique_ptr<OutputDevice> dev{OutputDevice::createNewDevice(name)};
+      if (!dev) {
+         rsj::Log("Unable to create output port " + name);
+         return false;
+      }
+      virtual_devices_.push_back(dev.get());
+      {
+         auto lock = std::unique_lock(devices_mtx_);
+         output_devices_.push_back(std::move(dev));
+      }
+      rsj::Log("Created output port " + name);
+      return true;
+#endif
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
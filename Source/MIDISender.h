@@ -21,29 +21,47 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include <memory>
+#include <shared_mutex>
 #include <vector>
 
+#include "AlsaMidi.h"
+
 namespace juce {
    class MidiOutput;
-}
+   class String;
+} // namespace juce
 
 class MidiSender {
  public:
+#ifdef __LINUX_ALSA__
+   using OutputDevice = rsj::AlsaMidiOutput;
+#else
+   using OutputDevice = juce::MidiOutput;
+#endif
    void Start();
 
-   // sends a CC message to all output devices
-   void SendCc(int midi_channel, int controller, int value) const;
+   // sends a CC message to all output devices. high_resolution sends controller 0-31 as a 14-bit
+   // MSB/LSB pair, the LSB on controller + 32
+   void SendCc(int midi_channel, int controller, int value, bool high_resolution = false) const;
    // sends a PitchBend message to all output devices
    void SendPitchWheel(int midi_channel, int value) const;
 
    void SendNoteOn(int midi_channel, int controller, int value) const;
+   // sends a 14-bit value to a registered parameter (CC 101/100, then data entry 6/38)
+   void SendRpn(int midi_channel, int parameter, int value) const;
 
-   // re-enumerates MIDI OUT devices
+   // re-enumerates MIDI OUT devices, closing removed devices and opening new ones
    void RescanDevices();
+   // as RescanDevices, returns false if a listed device failed to open and a retry may help
+   bool UpdateDevices();
+   // opens an output port other programs can connect to and keeps it open until the sender is
+   // destroyed. Returns false if it can't be created (always on Windows). Message thread only.
+   bool OpenVirtualOutput(const juce::String& name);
 
  private:
-   void InitDevices();
-   std::vector<std::unique_ptr<juce::MidiOutput>> output_devices_;
+   mutable std::shared_mutex devices_mtx_; // senders share, device changes are exclusive
+   std::vector<std::unique_ptr<OutputDevice>> output_devices_;
+   std::vector<const OutputDevice*> virtual_devices_; // message thread only, kept by rescans
 };
 
 #endif // MIDISENDER_H_INCLUDED
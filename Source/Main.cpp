@@ -27,6 +27,7 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
+#include <chrono>
 #include <exception>
 #include <fstream>
 #include <memory>
@@ -46,21 +47,42 @@ namespace fs = std::filesystem;
 #include "CCoptions.h"
 #include "CommandSet.h"
 #include "ControlsModel.h"
+#include "Executor.h"
+#include "LockBenchmark.h"
 #include "LR_IPC_In.h"
 #include "LR_IPC_Out.h"
 #include "MainWindow.h"
+#include "MidiDeviceWatcher.h"
 #include "MIDIReceiver.h"
 #include "MIDISender.h"
 #include "Misc.h"
+#include "OscReceiver.h"
 #include "Profile.h"
 #include "ProfileManager.h"
 #include "PWoptions.h"
+#include "Reactor.h"
 #include "SettingsManager.h"
 #include "Translate.h"
+#include "Ump.h"
 #include "VersionChecker.h"
 
 namespace {
    constexpr auto kShutDownString{"--LRSHUTDOWN"};
+   constexpr auto kCaptureOption{"--capture"};
+   constexpr auto kReplayOption{"--replay"};
+   constexpr auto kReplaySpeedOption{"--replay-speed"};
+   constexpr auto kVirtualPortOption{"--virtual-port"};
+   constexpr auto kSyntheticUmpOption{"--synthetic-ump"};
+   constexpr auto kOscPortOption{"--osc-port"};
+   constexpr auto kLockBenchmarkOption{"--lock-benchmark"};
+   constexpr int kLockBenchmarkIterations{200000}; // per thread
+   constexpr auto kQueueBenchmarkOption{"--queue-benchmark"};
+   constexpr auto kNrpnBenchmarkOption{"--nrpn-benchmark"};
+   constexpr int kNrpnBenchmarkDevices{8};
+   constexpr auto kDispatchBenchmarkOption{"--dispatch-benchmark"};
+#if JUCE_UNIT_TESTS
+   constexpr auto kUnitTestsOption{"--unit-tests"};
+#endif
    constexpr auto kSettingsFile{"settings.bin"};
    constexpr auto kSettingsFileX("settings.xml");
    constexpr auto kDefaultsFile{"default.xml"};
@@ -119,10 +141,17 @@ class MIDI2LRApplication final : public juce::JUCEApplication {
          // loop won't be run.
          if (command_line != kShutDownString) {
             CerealLoad();
+            midi_receiver_->SetControlsModel(&controls_model_);
+            midi_receiver_->SetCoalescing(true);
+            midi_receiver_->SetProfile(&profile_);
+            midi_receiver_->SetNrpnMsbTimeout(
+                std::chrono::milliseconds(settings_manager_.GetNrpnMsbTimeout()));
             midi_receiver_->Start();
             midi_sender_->Start();
+            ApplyCommandLine(command_line);
             lr_ipc_out_->Start();
             lr_ipc_in_->Start();
+            device_watcher_.Start();
             main_window_ =
                 std::make_unique<MainWindow>(getApplicationName(), command_set_, profile_,
                     profile_manager_, settings_manager_, lr_ipc_out_, midi_receiver_, midi_sender_);
@@ -151,7 +180,9 @@ class MIDI2LRApplication final : public juce::JUCEApplication {
       // Be careful that nothing happens in this method that might rely on
       // messages being sent, or any kind of window activity, because the
       // message loop is no longer running at this point.
+      device_watcher_.Stop();
       lr_ipc_in_->PleaseStopThread();
+      osc_receiver_.Stop();
       DefaultProfileSave();
       CerealSave();
       lr_ipc_out_.reset();
@@ -223,6 +254,74 @@ class MIDI2LRApplication final : public juce::JUCEApplication {
    }
 
  private:
+   // --capture <file> records MIDI input, --replay <file> [--replay-speed <x>] plays a capture
+   // back through the receiver (speed 0 is as fast as possible). OSC is received on
+   // OscReceiver::kDefaultPort unless --osc-port <port> gives another, 0 turns it off
+   void ApplyCommandLine(const juce::String& command_line)
+   {
+      try {
+         const auto args = juce::StringArray::fromTokens(command_line, true);
+         const auto argument = [&args](const char* option) {
+            const auto i = args.indexOf(option);
+            return i >= 0 && i + 1 < args.size() ? args[i + 1].unquoted() : juce::String();
+         };
+         // --lock-benchmark <threads> logs rsj::SpinLock against std::mutex under contention
+         if (const auto threads = argument(kLockBenchmarkOption).getIntValue(); threads > 0)
+            rsj::Log(rsj::LockBenchmark(threads, kLockBenchmarkIterations));
+         // --queue-benchmark <items> logs the lock-free command queue against rsj::BlockingQueue
+         // with 1, 4 and 16 producers each sending items
+         if (const auto items = argument(kQueueBenchmarkOption).getIntValue(); items > 0)
+            for (const auto producers : {1, 4, 16})
+               rsj::Log(rsj::QueueBenchmark(producers, items));
+         // --nrpn-benchmark <nrpns> logs the NRPN filters and slot rings with 8 devices sending
+         if (const auto nrpns = argument(kNrpnBenchmarkOption).getIntValue(); nrpns > 0)
+            rsj::Log(MidiReceiver::NrpnBenchmark(executor_, kNrpnBenchmarkDevices, nrpns));
+         // --dispatch-benchmark <messages> logs listener calls through rsj::ListenerRegistry
+         // against std::function
+         if (const auto messages = argument(kDispatchBenchmarkOption).getIntValue(); messages > 0)
+            rsj::Log(rsj::DispatchBenchmark(messages));
+#if JUCE_UNIT_TESTS
+         // --unit-tests runs the juce::UnitTest classes, e.g. NrpnFilter's, writing each result
+         // to the log
+         if (args.contains(kUnitTestsOption)) {
+            juce::UnitTestRunner runner{};
+            runner.runAllTests();
+            auto failures{0};
+            for (auto i = 0; i < runner.getNumResults(); ++i)
+               failures += runner.getResult(i)->failures;
+            rsj::Log("Unit tests finished, " + juce::String(failures) + " failures");
+         }
+#endif
+         // an input and an output port other programs connect to, for testing without hardware
+         if (const auto port_name = argument(kVirtualPortOption); port_name.isNotEmpty()) {
+            midi_receiver_->OpenVirtualInput(port_name);
+            midi_sender_->OpenVirtualOutput(port_name);
+         }
+         const auto osc_port = argument(kOscPortOption);
+         if (const auto port = osc_port.isNotEmpty() ? osc_port.getIntValue()
+                                                     : OscReceiver::kDefaultPort;
+             port > 0)
+            osc_receiver_.Start(port);
+         if (const auto capture_file = argument(kCaptureOption); capture_file.isNotEmpty())
+            midi_receiver_->StartCapture(capture_file.toStdString());
+         if (const auto replay_file = argument(kReplayOption); replay_file.isNotEmpty()) {
+            const auto speed = argument(kReplaySpeedOption);
+            midi_receiver_->Replay(
+                replay_file.toStdString(), speed.isNotEmpty() ? speed.getDoubleValue() : 1.0);
+         }
+         // sweeps MIDI 2.0 controls through their full range, one step a millisecond
+         else if (const auto steps = argument(kSyntheticUmpOption).getIntValue(); steps >= 2) {
+            const auto speed = argument(kReplaySpeedOption);
+            midi_receiver_->PlayUmp(rsj::SyntheticUmpStream(steps, std::chrono::milliseconds(1)),
+                speed.isNotEmpty() ? speed.getDoubleValue() : 1.0);
+         }
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+
    void DefaultProfileSave()
    {
       try {
@@ -386,13 +485,18 @@ class MIDI2LRApplication final : public juce::JUCEApplication {
    ControlsModel controls_model_{};
    Profile profile_{command_set_};
    std::shared_ptr<MidiSender> midi_sender_{std::make_shared<MidiSender>()};
-   std::shared_ptr<MidiReceiver> midi_receiver_{std::make_shared<MidiReceiver>()};
-   std::shared_ptr<LrIpcOut> lr_ipc_out_{
-       std::make_shared<LrIpcOut>(controls_model_, profile_, midi_sender_, *midi_receiver_)};
-   ProfileManager profile_manager_{controls_model_, profile_, lr_ipc_out_, *midi_receiver_};
-   std::shared_ptr<LrIpcIn> lr_ipc_in_{
-       std::make_shared<LrIpcIn>(controls_model_, profile_manager_, profile_, midi_sender_)};
+   // starts the pipeline's threads, so it must outlive the objects that own them
+   rsj::Executor executor_{};
+   rsj::Reactor reactor_{executor_}; // waits on the sockets below and ALSA device announcements
+   std::shared_ptr<MidiReceiver> midi_receiver_{std::make_shared<MidiReceiver>(executor_)};
+   OscReceiver osc_receiver_{*midi_receiver_, reactor_};
+   std::shared_ptr<LrIpcOut> lr_ipc_out_{std::make_shared<LrIpcOut>(
+       controls_model_, profile_, midi_sender_, *midi_receiver_, executor_, reactor_)};
+   ProfileManager profile_manager_{profile_, lr_ipc_out_, *midi_receiver_};
+   std::shared_ptr<LrIpcIn> lr_ipc_in_{std::make_shared<LrIpcIn>(
+       controls_model_, profile_manager_, profile_, midi_sender_, executor_, reactor_)};
    SettingsManager settings_manager_{profile_manager_, lr_ipc_out_};
+   MidiDeviceWatcher device_watcher_{midi_receiver_, midi_sender_, lr_ipc_out_, reactor_};
    std::unique_ptr<MainWindow> main_window_{nullptr};
    // destroy after window that uses it
    juce::LookAndFeel_V3 look_feel_;
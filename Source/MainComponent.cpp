@@ -30,6 +30,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "MIDISender.h"
 #include "MidiUtilities.h"
 #include "Misc.h"
+#include "Osc.h"
 #include "Profile.h"
 #include "ProfileManager.h"
 #include "SettingsComponent.h"
@@ -84,15 +85,16 @@ void MainContentComponent::Init(std::weak_ptr<LrIpcOut>&& lr_ipc_out,
       midi_sender_ = std::move(midi_sender);
 
       if (midi_receiver_)
-         // Add ourselves as a listener for MIDI commands
-         midi_receiver_->AddCallback(this, &MainContentComponent::MidiCmdCallback);
+         // Add ourselves as a listener for MIDI commands, off the path to Lightroom
+         midi_receiver_->AddCallback<&MainContentComponent::MidiCmdCallback>(
+             this, MidiReceiver::Priority::kDeferred);
 
       if (const auto ptr = lr_ipc_out_.lock())
          // Add ourselves as a listener for LR_IPC_OUT events
-         ptr->AddCallback(this, &MainContentComponent::LrIpcOutCallback);
+         ptr->AddCallback<&MainContentComponent::LrIpcOutCallback>(this);
 
       // Add ourselves as a listener for profile changes
-      profile_manager_.AddCallback(this, &MainContentComponent::ProfileChanged);
+      profile_manager_.AddCallback<&MainContentComponent::ProfileChanged>(this);
 
       // Main title
       title_label_.setFont(juce::Font{36.f, juce::Font::bold});
@@ -211,36 +213,56 @@ void MainContentComponent::paint(juce::Graphics& g)
    }
 }
 
-void MainContentComponent::MidiCmdCallback(rsj::MidiMessage mm)
+void MainContentComponent::MidiCmdCallback(gsl::span<const rsj::MidiEvent> events)
 {
    try {
-      // Display the CC parameters and add/highlight row in table corresponding to the CC
-      auto mt{rsj::MsgIdEnum::kCc};
+      if (events.empty())
+         return;
+      // Display the last message's parameters and add/highlight row in table corresponding to it;
+      // rows for the whole burst are added under one Profile lock
+      rows_to_add_.clear();
+      for (const auto& event : events)
+         rows_to_add_.push_back(event.id);
+      const auto& last = events[events.size() - 1];
       juce::String command_type{"CC"};
-      switch (mm.message_type_byte) { // this is needed because mapping uses custom structure
-      case rsj::kCcFlag:              // this is default for mt and commandtype
+      switch (last.id.msg_id_type) {
+      case rsj::MsgIdEnum::kCc:
          break;
-      case rsj::kNoteOnFlag:
-         mt = rsj::MsgIdEnum::kNote;
-         command_type = "NOTE ON";
+      case rsj::MsgIdEnum::kNote:
+         command_type =
+             last.message.message_type_byte == rsj::kNoteOffFlag ? "NOTE OFF" : "NOTE ON";
          break;
-      case rsj::kNoteOffFlag:
-         mt = rsj::MsgIdEnum::kNote;
-         command_type = "NOTE OFF";
-         break;
-      case rsj::kPwFlag:
-         mt = rsj::MsgIdEnum::kPitchBend;
+      case rsj::MsgIdEnum::kPitchBend:
          command_type = "PITCHBEND";
          break;
-      default: // shouldn't receive any messages note categorized above
-         Ensures(0);
+      case rsj::MsgIdEnum::kRpn:
+         command_type = "RPN";
+         break;
+      case rsj::MsgIdEnum::kOsc:
+         command_type = "OSC";
+         break;
+      case rsj::MsgIdEnum::kLongPress:
+         command_type = "LONG PRESS";
+         break;
+      case rsj::MsgIdEnum::kDoubleTap:
+         command_type = "DOUBLE TAP";
+         break;
+      case rsj::MsgIdEnum::kChord:
+         command_type = "CHORD";
       }
-      mm.channel++; // used to 1-based channel numbers
-      last_command_ = juce::String(mm.channel) + ": " + command_type + juce::String(mm.number)
-                      + " [" + juce::String(mm.value) + "]";
-      const rsj::MidiMessageId msg{mm.channel, mm.number, mt};
-      profile_.AddRowUnmapped(msg);
-      row_to_select_ = gsl::narrow_cast<size_t>(profile_.GetRowForMessage(msg));
+      if (last.id.msg_id_type == rsj::MsgIdEnum::kOsc)
+         last_command_ = command_type + ": " + rsj::OscAddress(last.id.data) + " ["
+                         + juce::String(last.message.value + last.message.fraction) + "]";
+      else if (last.id.msg_id_type == rsj::MsgIdEnum::kChord)
+         last_command_ = juce::String(last.message.channel + 1) + ": " + command_type
+                         + juce::String(last.message.number >> 7) + "+"
+                         + juce::String(last.message.number & 0x7F);
+      else
+         last_command_ = juce::String(last.message.channel + 1) + ": " + command_type
+                         + juce::String(last.message.number) + " ["
+                         + juce::String(last.message.value) + "]";
+      profile_.AddRowsUnmapped(rows_to_add_, settings_manager_.GetLearnPerDevice());
+      row_to_select_ = gsl::narrow_cast<size_t>(profile_.GetRowForMessage(rows_to_add_.back()));
       triggerAsyncUpdate();
    }
    catch (const std::exception& e) {
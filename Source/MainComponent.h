@@ -25,10 +25,13 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include <memory>
+#include <vector>
 
+#include <gsl/gsl>
 #include <JuceLibraryCode/JuceHeader.h>
 #include "CommandTable.h"      //class member
 #include "CommandTableModel.h" //class member
+#include "MidiUtilities.h"     //class member
 #include "ResizableLayout.h"   //base class
 class CommandSet;
 class LrIpcOut;
@@ -37,9 +40,6 @@ class MidiSender;
 class Profile;
 class ProfileManager;
 class SettingsManager;
-namespace rsj {
-   struct MidiMessage;
-}
 
 class MainContentComponent final : public juce::Component,
                                    juce::AsyncUpdater,
@@ -69,7 +69,7 @@ class MainContentComponent final : public juce::Component,
    void timerCallback() override;
    // callbacks
    void LrIpcOutCallback(bool, bool);
-   void MidiCmdCallback(rsj::MidiMessage);
+   void MidiCmdCallback(gsl::span<const rsj::MidiEvent> events);
    void ProfileChanged(juce::XmlElement* xml_element, const juce::String& file_name);
 
    Profile& profile_;
@@ -92,6 +92,7 @@ class MainContentComponent final : public juce::Component,
    juce::TextButton settings_button_{juce::translate("Settings")};
    SettingsManager& settings_manager_;
    size_t row_to_select_{0};
+   std::vector<rsj::MidiMessageId> rows_to_add_{}; // MIDI listener thread only
    std::shared_ptr<MidiReceiver> midi_receiver_{nullptr};
    std::shared_ptr<MidiSender> midi_sender_{nullptr};
    std::unique_ptr<juce::DialogWindow> settings_dialog_;
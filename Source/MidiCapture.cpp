@@ -0,0 +1,131 @@
+/*
+==============================================================================
+
+MidiCapture.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "MidiCapture.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <exception>
+
+#include <gsl/gsl>
+#include "Misc.h"
+
+namespace {
+   constexpr std::array<char, 8> kMagic{'M', 'I', 'D', 'I', '2', 'L', 'R', 'C'};
+   constexpr std::uint32_t kFormatVersion{1};
+   constexpr std::size_t kHeaderSize{16};
+   constexpr std::size_t kRecordSize{16};
+
+   template<class T> void PutLe(char* dest, T value) noexcept
+   {
+      for (std::size_t i = 0; i < sizeof(T); ++i)
+         dest[i] = static_cast<char>((static_cast<std::uint64_t>(value) >> (8 * i)) & 0xFF);
+   }
+
+   template<class T> [[nodiscard]] T GetLe(const char* src) noexcept
+   {
+      std::uint64_t value{0};
+      for (std::size_t i = 0; i < sizeof(T); ++i)
+         value |= static_cast<std::uint64_t>(static_cast<unsigned char>(src[i])) << (8 * i);
+      return static_cast<T>(value);
+   }
+} // namespace
+
+#pragma warning(push)
+#pragma warning(disable : 26481) // pointer arithmetic on fixed-size byte records
+rsj::MidiCaptureWriter::MidiCaptureWriter(const std::string& file_name)
+    : out_{file_name, std::ios::binary | std::ios::trunc}
+{
+   try {
+      if (!out_.is_open())
+         return;
+      std::array<char, kHeaderSize> header{};
+      std::copy(kMagic.begin(), kMagic.end(), header.begin());
+      PutLe(header.data() + kMagic.size(), kFormatVersion);
+      out_.write(header.data(), header.size());
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::MidiCaptureWriter::Write(std::size_t device, const MidiMessage& message)
+{
+   try {
+      const auto offset =
+          std::chrono::duration_cast<std::chrono::microseconds>(message.time - start_).count();
+      std::array<char, kRecordSize> record{};
+      PutLe(record.data(), gsl::narrow_cast<std::uint64_t>(offset < 0 ? 0 : offset));
+      PutLe(record.data() + 8, gsl::narrow_cast<std::uint8_t>(device));
+      PutLe(record.data() + 9, gsl::narrow_cast<std::uint8_t>(message.message_type_byte));
+      PutLe(record.data() + 10, gsl::narrow_cast<std::uint8_t>(message.channel));
+      PutLe(record.data() + 12, gsl::narrow_cast<std::uint16_t>(message.number));
+      PutLe(record.data() + 14, gsl::narrow_cast<std::uint16_t>(message.value));
+      out_.write(record.data(), record.size());
+      ++count_;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+std::optional<std::vector<rsj::CapturedMidi>> rsj::ReadMidiCapture(const std::string& file_name)
+{
+   try {
+      std::ifstream in{file_name, std::ios::binary};
+      if (!in.is_open()) {
+         rsj::Log("Unable to open MIDI capture file " + juce::String(file_name) + '.');
+         return std::nullopt;
+      }
+      std::array<char, kHeaderSize> header{};
+      if (!in.read(header.data(), header.size())
+          || !std::equal(kMagic.begin(), kMagic.end(), header.begin())) {
+         rsj::Log(juce::String(file_name) + " is not a MIDI2LR capture file.");
+         return std::nullopt;
+      }
+      if (const auto version = GetLe<std::uint32_t>(header.data() + kMagic.size());
+          version != kFormatVersion) {
+         rsj::Log("Unsupported MIDI capture format version " + juce::String(version) + " in "
+                  + juce::String(file_name) + '.');
+         return std::nullopt;
+      }
+      std::vector<CapturedMidi> ret;
+      std::array<char, kRecordSize> record{};
+      while (in.read(record.data(), record.size())) {
+         CapturedMidi captured;
+         captured.offset = std::chrono::microseconds(GetLe<std::uint64_t>(record.data()));
+         captured.device = GetLe<std::uint8_t>(record.data() + 8);
+         captured.message.message_type_byte = GetLe<std::uint8_t>(record.data() + 9);
+         captured.message.channel = GetLe<std::uint8_t>(record.data() + 10);
+         captured.message.number = GetLe<std::int16_t>(record.data() + 12);
+         captured.message.value = GetLe<std::int16_t>(record.data() + 14);
+         ret.push_back(captured);
+      }
+      return ret;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+#pragma warning(pop)
@@ -0,0 +1,74 @@
+#ifndef MIDI2LR_MIDICAPTURE_H_INCLUDED
+#define MIDI2LR_MIDICAPTURE_H_INCLUDED
+/*
+==============================================================================
+
+MidiCapture.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "MidiUtilities.h"
+
+// Capture file: 16 byte header, "MIDI2LRC" then a little-endian uint32 format version and four
+// reserved bytes, followed by one 16 byte little-endian record per message:
+//    uint64 microseconds since capture started
+//    uint8  input device slot
+//    uint8  message type (high nibble of the status byte, or rsj::kRpnFlag)
+//    uint8  channel, zero-based
+//    uint8  reserved
+//    uint16 number
+//    uint16 value
+// Messages are recorded after NRPN assembly, exactly as MidiReceiver dispatches them, except that
+// the fraction of a MIDI 2.0 value or OSC argument isn't kept. OSC messages aren't replayed.
+namespace rsj {
+   struct CapturedMidi {
+      std::chrono::microseconds offset{0};
+      std::size_t device{0};
+      MidiMessage message{};
+   };
+
+   class MidiCaptureWriter {
+    public:
+      explicit MidiCaptureWriter(const std::string& file_name);
+      [[nodiscard]] bool IsOpen() const noexcept
+      {
+         return out_.is_open() && out_.good();
+      }
+      void Write(std::size_t device, const MidiMessage& message);
+      [[nodiscard]] unsigned long long Count() const noexcept
+      {
+         return count_;
+      }
+
+    private:
+      std::ofstream out_;
+      MidiTime start_{MidiClock::now()};
+      unsigned long long count_{0};
+   };
+
+   // logs the reason and returns nullopt if the file can't be opened or is not a capture file
+   [[nodiscard]] std::optional<std::vector<CapturedMidi>> ReadMidiCapture(
+       const std::string& file_name);
+} // namespace rsj
+
+#endif // MIDI2LR_MIDICAPTURE_H_INCLUDED
@@ -0,0 +1,356 @@
+/*
+==============================================================================
+
+MidiDeviceWatcher.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "MidiDeviceWatcher.h"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <string>
+#include <utility>
+
+#ifdef __APPLE__
+#include <CoreMIDI/CoreMIDI.h>
+#elif defined(__LINUX_ALSA__)
+#include <alsa/asoundlib.h>
+#include <cerrno>
+#include <poll.h>
+#endif
+
+#include <gsl/gsl>
+#include "LR_IPC_Out.h"
+#include "MIDIReceiver.h"
+#include "MIDISender.h"
+#include "Misc.h"
+#include "Reactor.h"
+
+namespace {
+   constexpr std::chrono::milliseconds kWatchInterval{1000}; // first retry, polls after a change
+   constexpr std::chrono::milliseconds kLongestRetry{64000}; // of a list that won't open
+   constexpr std::chrono::milliseconds kLongestPoll{8000};   // while the lists stay the same
+} // namespace
+
+#ifdef __APPLE__
+class MidiDeviceWatcher::Notifier {
+ public:
+   Notifier(rsj::Reactor& /*reactor*/, std::function<void()> changed)
+       : changed_{std::move(changed)}
+   {
+      // notifications arrive on the run loop of the thread creating the client: the message
+      // thread
+      if (MIDIClientCreate(CFSTR("MIDI2LR device watcher"), &Notifier::Notify, this, &client_)
+          != noErr) {
+         client_ = 0;
+         rsj::Log("Unable to create CoreMIDI client for device notifications");
+      }
+   }
+   ~Notifier()
+   {
+      if (client_)
+         MIDIClientDispose(client_);
+   }
+   Notifier(const Notifier& other) = delete;
+   Notifier(Notifier&& other) = delete;
+   Notifier& operator=(const Notifier& other) = delete;
+   Notifier& operator=(Notifier&& other) = delete;
+   [[nodiscard]] bool Active() const noexcept
+   {
+      return client_ != 0;
+   }
+
+ private:
+   static void Notify(const MIDINotification* message, void* self)
+   {
+      try {
+         if (message && message->messageID == kMIDIMsgSetupChanged)
+            static_cast<Notifier*>(self)->changed_();
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse("MidiDeviceWatcher::Notifier", __func__, e);
+         throw;
+      }
+   }
+   std::function<void()> changed_;
+   MIDIClientRef client_{0};
+};
+#elif defined(__LINUX_ALSA__)
+class MidiDeviceWatcher::Notifier {
+ public:
+   // a sequencer client of our own subscribed to the system announce port, which reports every
+   // client and port that comes or goes. Our own ports are among them, costing one check of
+   // unchanged lists each time a device is opened
+   Notifier(rsj::Reactor& reactor, std::function<void()> changed)
+       : reactor_{reactor}, changed_{std::move(changed)}
+   {
+      try {
+         if (snd_seq_open(&seq_, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) < 0) {
+            seq_ = nullptr;
+            rsj::Log("Unable to open ALSA sequencer for device notifications");
+            return;
+         }
+         snd_seq_set_client_name(seq_, "MIDI2LR"); // so AlsaMidi leaves it out of the lists
+         const auto port = snd_seq_create_simple_port(seq_, "device watcher",
+             SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT, SND_SEQ_PORT_TYPE_APPLICATION);
+         pollfd fd{};
+         if (port < 0
+             || snd_seq_connect_from(
+                    seq_, port, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE) < 0
+             || snd_seq_poll_descriptors(seq_, &fd, 1, POLLIN) != 1) {
+            snd_seq_close(std::exchange(seq_, nullptr));
+            rsj::Log("Unable to subscribe to ALSA sequencer announcements");
+            return;
+         }
+         watch_ = reactor_.Watch(fd.fd, [this] { Announced(); });
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+   ~Notifier()
+   {
+      reactor_.Cancel(watch_); // before the fd goes
+      if (seq_)
+         snd_seq_close(seq_);
+   }
+   Notifier(const Notifier& other) = delete;
+   Notifier(Notifier&& other) = delete;
+   Notifier& operator=(const Notifier& other) = delete;
+   Notifier& operator=(Notifier&& other) = delete;
+   [[nodiscard]] bool Active() const noexcept
+   {
+      return watch_ != 0;
+   }
+
+ private:
+   // reactor thread
+   void Announced()
+   {
+      try {
+         auto changed{false};
+         for (;;) {
+            snd_seq_event_t* event{nullptr};
+            const auto result = snd_seq_event_input(seq_, &event);
+            if (result == -ENOSPC) { // the kernel's buffer overran, events were lost
+               changed = true;
+               continue;
+            }
+            if (result < 0) // -EAGAIN once drained
+               break;
+            if (event)
+               switch (event->type) {
+               case SND_SEQ_EVENT_CLIENT_START:
+               case SND_SEQ_EVENT_CLIENT_EXIT:
+               case SND_SEQ_EVENT_PORT_START:
+               case SND_SEQ_EVENT_PORT_EXIT:
+               case SND_SEQ_EVENT_PORT_CHANGE:
+                  changed = true;
+                  break;
+               default:
+                  break;
+               }
+         }
+         if (changed)
+            changed_();
+      }
+      catch (const std::exception& e) {
+         rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+         throw;
+      }
+   }
+   rsj::Reactor& reactor_;
+   std::function<void()> changed_;
+   snd_seq_t* seq_{nullptr};
+   rsj::Reactor::Token watch_{0};
+};
+#else
+class MidiDeviceWatcher::Notifier {
+ public:
+   // Windows only tells windows, with WM_DEVICECHANGE, and JUCE's MIDI on other systems has no
+   // notification at all, so nothing here: the lists are polled
+   Notifier(rsj::Reactor& /*reactor*/, const std::function<void()>& /*changed*/) noexcept {}
+   [[nodiscard]] static constexpr bool Active() noexcept
+   {
+      return false;
+   }
+};
+#endif
+
+MidiDeviceWatcher::MidiDeviceWatcher(std::weak_ptr<MidiReceiver> midi_receiver,
+    std::weak_ptr<MidiSender> midi_sender, std::weak_ptr<LrIpcOut> lr_ipc_out,
+    rsj::Reactor& reactor) noexcept
+    : lr_ipc_out_{std::move(lr_ipc_out)}, midi_receiver_{std::move(midi_receiver)},
+      midi_sender_{std::move(midi_sender)}, reactor_{reactor}
+{
+}
+
+MidiDeviceWatcher::~MidiDeviceWatcher() = default;
+
+void MidiDeviceWatcher::Start()
+{
+   try {
+      // devices were opened by MidiReceiver::Start and MidiSender::Start
+      inputs_.opened = MidiReceiver::InputDevice::getDevices();
+      outputs_.opened = MidiSender::OutputDevice::getDevices();
+      notifier_ = std::make_unique<Notifier>(reactor_, [this] { triggerAsyncUpdate(); });
+      if (!notifier_->Active())
+         rsj::Log("No MIDI device notifications, polling the device lists");
+      Schedule(true, Clock::now());
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiDeviceWatcher::Stop()
+{
+   try {
+      notifier_.reset();
+      juce::Timer::stopTimer();
+      cancelPendingUpdate();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+bool MidiDeviceWatcher::Due(
+    Watched& watched, const juce::StringArray& devices, Clock::time_point now)
+{
+   try {
+      if (devices == watched.opened) {
+         watched.failed = juce::StringArray{}; // back as it was, nothing to retry
+         return false;
+      }
+      if (devices != watched.failed) // changed since the last try, so try now
+         return true;
+      return now >= watched.retry;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("MidiDeviceWatcher", __func__, e);
+      throw;
+   }
+}
+
+void MidiDeviceWatcher::Tried(
+    Watched& watched, juce::StringArray devices, bool all_opened, Clock::time_point now)
+{
+   try {
+      if (all_opened) {
+         watched.opened = std::move(devices);
+         watched.failed = juce::StringArray{};
+         watched.backoff = kWatchInterval;
+         return;
+      }
+      if (devices != watched.failed)
+         watched.backoff = kWatchInterval;
+      watched.failed = std::move(devices);
+      watched.retry = now + watched.backoff;
+      watched.backoff = std::min(watched.backoff * 2, kLongestRetry);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("MidiDeviceWatcher", __func__, e);
+      throw;
+   }
+}
+
+void MidiDeviceWatcher::Check()
+{
+   using namespace std::string_literals;
+   try {
+      // a device that failed to open (common on the first try on MacOS) is retried, less often
+      // each time it fails again
+      const auto now = Clock::now();
+      auto changed{false};
+      if (auto inputs = MidiReceiver::InputDevice::getDevices(); Due(inputs_, inputs, now))
+         if (const auto receiver = midi_receiver_.lock()) {
+            changed = true;
+            Tried(inputs_, std::move(inputs), receiver->UpdateDevices(), now);
+         }
+      if (auto outputs = MidiSender::OutputDevice::getDevices(); Due(outputs_, outputs, now))
+         if (const auto sender = midi_sender_.lock()) {
+            changed = true;
+            const auto all_opened = sender->UpdateDevices();
+            Tried(outputs_, std::move(outputs), all_opened, now);
+            // bring newly attached controllers up to date
+            if (const auto ptr = lr_ipc_out_.lock())
+               ptr->SendCommand("FullRefresh 1\n"s);
+         }
+      Schedule(changed, now);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiDeviceWatcher::Schedule(bool changed, Clock::time_point now)
+{
+   try {
+      std::optional<Clock::time_point> next{};
+      const auto no_later_than = [&next](Clock::time_point due) {
+         if (!next || due < *next)
+            next = due;
+      };
+      for (const auto* watched : {&inputs_, &outputs_})
+         if (!watched->failed.isEmpty())
+            no_later_than(watched->retry);
+      if (notifier_ && !notifier_->Active()) {
+         poll_ = changed ? kWatchInterval : std::min(poll_ * 2, kLongestPoll);
+         no_later_than(now + poll_);
+      }
+      if (!next) {
+         juce::Timer::stopTimer();
+         return;
+      }
+      const auto wait = std::chrono::ceil<std::chrono::milliseconds>(*next - now);
+      juce::Timer::startTimer(
+          gsl::narrow_cast<int>(std::max<std::chrono::milliseconds::rep>(wait.count(), 1)));
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiDeviceWatcher::handleAsyncUpdate()
+{
+   try {
+      Check();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void MidiDeviceWatcher::timerCallback()
+{
+   try {
+      Check();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
@@ -0,0 +1,87 @@
+#ifndef MIDI2LR_MIDIDEVICEWATCHER_H_INCLUDED
+#define MIDI2LR_MIDIDEVICEWATCHER_H_INCLUDED
+/*
+==============================================================================
+
+MidiDeviceWatcher.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <chrono>
+#include <memory>
+
+#include <JuceLibraryCode/JuceHeader.h>
+class LrIpcOut;
+class MidiReceiver;
+class MidiSender;
+namespace rsj {
+   class Reactor;
+}
+
+// Checks the MIDI device lists on the message thread and has MidiReceiver and MidiSender open
+// added devices and close removed ones. Devices that stay attached are never interrupted. A list
+// with a device that fails to open is retried after 1, 2, 4... up to 64 seconds, until it opens
+// or the list changes.
+// The lists are checked when the OS says the MIDI setup changed: CoreMIDI's setup-changed
+// notification on MacOS, the ALSA sequencer's announce port when built with __LINUX_ALSA__
+// (its fd is watched by the Reactor). Elsewhere, Windows included, JUCE 5.4 gives no such word,
+// so the lists are still polled, every second after a change and less often while none comes,
+// up to kLongestPoll.
+class MidiDeviceWatcher final : juce::Timer, juce::AsyncUpdater {
+ public:
+   MidiDeviceWatcher(std::weak_ptr<MidiReceiver> midi_receiver,
+       std::weak_ptr<MidiSender> midi_sender, std::weak_ptr<LrIpcOut> lr_ipc_out,
+       rsj::Reactor& reactor) noexcept;
+   ~MidiDeviceWatcher();
+   MidiDeviceWatcher(const MidiDeviceWatcher& other) = delete;
+   MidiDeviceWatcher(MidiDeviceWatcher&& other) = delete;
+   MidiDeviceWatcher& operator=(const MidiDeviceWatcher& other) = delete;
+   MidiDeviceWatcher& operator=(MidiDeviceWatcher&& other) = delete;
+   void Start();
+   void Stop();
+
+ private:
+   using Clock = std::chrono::steady_clock;
+   class Notifier; // the OS's word that the MIDI setup changed, where it gives one
+   // one direction's devices as the receiver or sender last saw them
+   struct Watched {
+      juce::StringArray opened{}; // last list every device on opened
+      juce::StringArray failed{}; // last list that didn't, empty if none is waiting for a retry
+      Clock::time_point retry{};  // when failed is tried again
+      std::chrono::milliseconds backoff{0}; // wait if it fails again
+   };
+   // whether devices should be handed to the receiver or sender now
+   [[nodiscard]] static bool Due(
+       Watched& watched, const juce::StringArray& devices, Clock::time_point now);
+   static void Tried(
+       Watched& watched, juce::StringArray devices, bool all_opened, Clock::time_point now);
+   void Check();
+   // sets the timer for the next retry or poll, stops it if there is neither. changed: this
+   // check found a new list
+   void Schedule(bool changed, Clock::time_point now);
+   void handleAsyncUpdate() override;
+   void timerCallback() override;
+   Watched inputs_{};
+   Watched outputs_{};
+   std::chrono::milliseconds poll_{0}; // current polling interval, without a Notifier
+   std::weak_ptr<LrIpcOut> lr_ipc_out_;
+   std::weak_ptr<MidiReceiver> midi_receiver_;
+   std::weak_ptr<MidiSender> midi_sender_;
+   rsj::Reactor& reactor_;
+   std::unique_ptr<Notifier> notifier_{};
+};
+
+#endif // MIDI2LR_MIDIDEVICEWATCHER_H_INCLUDED
@@ -23,6 +23,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <gsl/gsl>
 
 rsj::MidiMessage::MidiMessage(const juce::MidiMessage& mm) noexcept(kNdebug)
+    : time{MidiClock::now()}
 { // anything not set below is set to zero by default constructor
 #pragma warning(push)
 #pragma warning(disable : 26481) // doing raw pointer arithmetic, parsing low-level structure
@@ -56,8 +57,8 @@ rsj::MidiMessage::MidiMessage(const juce::MidiMessage& mm) noexcept(kNdebug)
 }
 
 rsj::MidiMessageId::MidiMessageId(const MidiMessage& rhs) noexcept(kNdebug)
-    : msg_id_type{rsj::MsgIdEnum::kCc}, channel(rhs.channel + 1),
-      data(rhs.number) // channel 1-based
+    : msg_id_type{rsj::MsgIdEnum::kCc}, channel(rhs.channel + 1), data(rhs.number),
+      device(rhs.device) // channel 1-based
 {
    switch (rhs.message_type_byte) { // this is needed because mapping uses custom structure
    case kCcFlag:
@@ -69,6 +70,22 @@ rsj::MidiMessageId::MidiMessageId(const MidiMessage& rhs) noexcept(kNdebug)
    case kPwFlag:
       msg_id_type = rsj::MsgIdEnum::kPitchBend;
       break;
+   case kRpnFlag:
+      msg_id_type = rsj::MsgIdEnum::kRpn;
+      break;
+   case kLongPressFlag:
+      msg_id_type = rsj::MsgIdEnum::kLongPress;
+      break;
+   case kDoubleTapFlag:
+      msg_id_type = rsj::MsgIdEnum::kDoubleTap;
+      break;
+   case kChordFlag:
+      msg_id_type = rsj::MsgIdEnum::kChord;
+      break;
+   case kOscFlag: // an address means the same thing whichever slot OscReceiver was given
+      msg_id_type = rsj::MsgIdEnum::kOsc;
+      device = kAnyDevice;
+      break;
    default: // should be unreachable--MidiMessageId only handles a few message types
       Ensures(0);
    }
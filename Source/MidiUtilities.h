@@ -22,6 +22,11 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 /* NOTE: Channel and Number are zero-based */
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
 // Get the declaration of the primary std::hash template.
 // We are not permitted to declare it ourselves.
 // <typeindex> is guaranteed to provide such a declaration,
@@ -41,19 +46,70 @@ namespace rsj {
    constexpr short kChanPressureFlag = 0xD; // Max Key Pressure
    constexpr short kPwFlag = 0xE;           // Pitch Wheel
    constexpr short kSystemFlag = 0xF;
+   // not a MIDI status: an RPN value assembled from CC 101/100/6/38 (or 96/97), with the 14-bit
+   // parameter number in number. NRPNs keep kCcFlag with the parameter number as controller.
+   constexpr short kRpnFlag = 0x1;
+   // not MIDI: an OSC message from OscReceiver. number is the address's rsj::OscAddressIndex
+   // and value plus fraction is the message's argument, unscaled.
+   constexpr short kOscFlag = 0x2;
+   // not MIDI: button gestures found by GestureFilter, with the note in number. A chord's number
+   // is its lower note times 128 plus its higher note, see ChordNumber.
+   constexpr short kLongPressFlag = 0x3;
+   constexpr short kDoubleTapFlag = 0x4;
+   constexpr short kChordFlag = 0x5;
+   [[nodiscard]] constexpr short ChordNumber(short note, short other_note) noexcept
+   {
+      return static_cast<short>(
+          note < other_note ? note << 7 | other_note : other_note << 7 | note);
+   }
+
+   // input devices are numbered by the MidiReceiver slot they are opened in, 0 to
+   // kMaxInputDevices - 1. kAnyDevice in a MidiMessageId matches a message from any device.
+   // Profile gives rows for devices that aren't open numbers from kMaxInputDevices up, and
+   // moves them to the device's slot when it opens
+   constexpr size_t kMaxInputDevices{16};
+   constexpr short kAnyDevice{-1};
+
+   // what a slot number stands for across runs: the device's name, and which of the open
+   // devices with that name it is, counting from 0. An empty name is no device
+   struct DeviceIdentity {
+      std::string name{};
+      int ordinal{0};
+   };
+   inline bool operator==(const DeviceIdentity& lhs, const DeviceIdentity& rhs) noexcept
+   {
+      return lhs.ordinal == rhs.ordinal && lhs.name == rhs.name;
+   }
+   inline bool operator!=(const DeviceIdentity& lhs, const DeviceIdentity& rhs) noexcept
+   {
+      return !(lhs == rhs);
+   }
+
+   // monotonic clock used to stamp MIDI input and measure how long it takes to reach Lightroom
+   using MidiClock = std::chrono::steady_clock;
+   using MidiTime = MidiClock::time_point;
 
    struct MidiMessage {
       short message_type_byte{0};
       short channel{0};
       short number{0};
       short value{0};
+      short device{0}; // input slot the message arrived on
+      // the bits of a MIDI 2.0 value below value's resolution, as a fraction of one step of
+      // value, or the part of an OSC argument after its integer part. Always 0 for MIDI 1.0
+      // input.
+      double fraction{0.0};
+      MidiTime time{}; // arrival at the input callback, not part of the message's identity
       constexpr MidiMessage() noexcept = default;
 
-      constexpr MidiMessage(short mt, short ch, short nu, short va) noexcept
-          : message_type_byte(mt), channel(ch), number(nu), value(va)
+      constexpr MidiMessage(short mt, short ch, short nu, short va, MidiTime ti = {}) noexcept
+          : message_type_byte(mt), channel(ch), number(nu), value(va), time(ti)
       {
       }
 
+      // stamps time with MidiClock::now(). juce's own time stamp counts seconds on
+      // Time::getMillisecondCounter, too coarse and on a different clock from the rest of the
+      // pipeline
       // ReSharper disable once CppNonExplicitConvertingConstructor
       MidiMessage(const juce::MidiMessage& mm) noexcept(kNdebug);
    };
@@ -61,22 +117,34 @@ namespace rsj {
    constexpr bool operator==(const rsj::MidiMessage& lhs, const rsj::MidiMessage& rhs) noexcept
    {
       return lhs.message_type_byte == rhs.message_type_byte && lhs.channel == rhs.channel
-             && lhs.number == rhs.number && lhs.value == rhs.value;
+             && lhs.number == rhs.number && lhs.value == rhs.value && lhs.device == rhs.device
+             && lhs.fraction == rhs.fraction;
    }
 
-   enum class MsgIdEnum : short { kNote, kCc, kPitchBend };
+   enum class MsgIdEnum : short {
+      kNote,
+      kCc,
+      kPitchBend,
+      kRpn,
+      kOsc,
+      kLongPress,
+      kDoubleTap,
+      kChord
+   };
 
    struct MidiMessageId {
       MsgIdEnum msg_id_type;
       int channel;
       int data;
+      int device;
 
-      constexpr MidiMessageId() noexcept : msg_id_type(rsj::MsgIdEnum::kNote), channel(0), data(0)
+      constexpr MidiMessageId() noexcept
+          : msg_id_type(rsj::MsgIdEnum::kNote), channel(0), data(0), device(kAnyDevice)
       {
       }
 
-      constexpr MidiMessageId(int ch, int dat, MsgIdEnum msgType) noexcept
-          : msg_id_type(msgType), channel(ch), data(dat)
+      constexpr MidiMessageId(int ch, int dat, MsgIdEnum msgType, int dev = kAnyDevice) noexcept
+          : msg_id_type(msgType), channel(ch), data(dat), device(dev)
       {
       }
 
@@ -85,7 +153,8 @@ namespace rsj {
 
       constexpr bool operator==(const MidiMessageId& other) const noexcept
       {
-         return msg_id_type == other.msg_id_type && channel == other.channel && data == other.data;
+         return msg_id_type == other.msg_id_type && channel == other.channel && data == other.data
+                && device == other.device;
       }
 
       constexpr bool operator<(const MidiMessageId& other) const noexcept
@@ -95,12 +164,32 @@ namespace rsj {
          if (channel == other.channel) {
             if (data < other.data)
                return true;
-            if (data == other.data && msg_id_type < other.msg_id_type)
-               return true;
+            if (data == other.data) {
+               if (msg_id_type < other.msg_id_type)
+                  return true;
+               if (msg_id_type == other.msg_id_type && device < other.device)
+                  return true;
+            }
          }
          return false;
       }
    };
+
+   // a dispatched message with what the listeners need from the profile and controls model,
+   // worked out once on the dispatch thread. value and delta are only filled in when the message
+   // is mapped to a command, so unmapped messages don't move the control's position.
+   struct MidiEvent {
+      static constexpr size_t kNotInProfile{std::numeric_limits<size_t>::max()};
+      MidiMessage message{};
+      MidiMessageId id{};
+      size_t command{kNotInProfile}; // CommandSet index, 0 is "Unmapped"
+      short delta{0};   // ControlsModel::MeasureChange, for commands repeated per step
+      double value{0.0}; // ControlsModel::ControllerToPlugin, 0 to 1
+      [[nodiscard]] constexpr bool IsMapped() const noexcept
+      {
+         return command != kNotInProfile && command != 0;
+      }
+   };
 } // namespace rsj
 // hash functions
 // It is allowed to add template specializations for any standard library class template to the
@@ -111,9 +200,11 @@ namespace std {
    template<> struct hash<rsj::MidiMessageId> {
       size_t operator()(const rsj::MidiMessageId& k) const noexcept
       {
-         return hash<int_fast32_t>()(int_fast32_t(k.channel) | int_fast32_t(k.msg_id_type) << 8
-                                     | int_fast32_t(k.data) << 16);
-      } // channel is one byte, messagetype is one byte, controller (data) is two bytes
+         return hash<uint_fast64_t>()(uint_fast64_t(k.channel) | uint_fast64_t(k.msg_id_type) << 8
+                                      | uint_fast64_t(k.data) << 16
+                                      | uint_fast64_t(k.device + 1) << 32);
+      } // channel is one byte, messagetype is one byte, controller (data) is two bytes, device
+        // (offset so kAnyDevice is zero) is one byte
    };
 } // namespace std
 
@@ -20,10 +20,31 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "NrpnMessage.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <gsl/gsl>
 #include "Misc.h"
 
-NrpnFilter::ProcessResult NrpnFilter::operator()(short channel, short control, short value)
+namespace {
+   constexpr short kMaxNrpnValue{0x3FFF};
+   constexpr short kNullParameter{0x7F};
+   constexpr int kFieldBits{14};
+   constexpr std::uint64_t kFieldMask{0x3FFF};
+
+   // a held half's claim: value, parameter and RPN flag below a generation that is never zero,
+   // so a claim is non-zero and a later hold of the same value can't be taken for this one
+   constexpr std::uint64_t Pack(
+       std::uint32_t generation, bool rpn, short parameter, short value) noexcept
+   {
+      return std::uint64_t{generation} << 32 | std::uint64_t{rpn} << (2 * kFieldBits)
+             | (static_cast<std::uint64_t>(parameter) & kFieldMask) << kFieldBits
+             | (static_cast<std::uint64_t>(value) & kFieldMask);
+   }
+} // namespace
+
+NrpnFilter::ProcessResult NrpnFilter::operator()(
+    short channel, short control, short value, rsj::MidiTime time)
 {
    try {
       if (channel < 0 || channel >= kChannels)
@@ -31,54 +52,301 @@ NrpnFilter::ProcessResult NrpnFilter::operator()(short channel, short control, s
              "Channel value in ProcessMIDI is " + rsj::NumToChars(channel) + '.');
       Expects(value <= 0x7F);
       Expects(control <= 0x7F);
-      ProcessResult ret_val{false, false, 0, 0};
+      auto& state = channels_[channel];
       switch (control) {
-      case 6:
-         if (ready_flags_[channel] >= 0b11) {
-            ret_val.is_nrpn = true;
-            value_msb_[channel] = value & 0x7F;
-            ready_flags_[channel] |= 0b100; //"Magic number" false alarm //-V112
-            if (ready_flags_[channel] == 0b1111) {
-               ret_val.is_ready = true;
-               ret_val.control =
-                   gsl::narrow_cast<short>((control_msb_[channel] << 7) + control_lsb_[channel]);
-               ret_val.value =
-                   gsl::narrow_cast<short>((value_msb_[channel] << 7) + value_lsb_[channel]);
-               Clear(channel);
-            }
+      case 6u: { // data entry MSB
+         if (!IsSelected(state))
+            return {};
+         const auto lsb_waiting = state.lsb_pending;
+         Reclaim(channel); // a waiting MSB is replaced, a waiting LSB completed
+         state.value_msb = value & 0x7F;
+         state.has_value_msb = true;
+         if (lsb_waiting) {
+            state.lsb_first = true;
+            state.msb_only = false;
+            return Emit(channel, gsl::narrow_cast<short>((state.value_msb << 7) | state.value_lsb));
          }
-         return ret_val;
-      case 38u:
-         if (ready_flags_[channel] >= 0b11) {
-            ret_val.is_nrpn = true;
-            value_lsb_[channel] = value & 0x7F;
-            ready_flags_[channel] |= 0b1000;
-            if (ready_flags_[channel] == 0b1111) {
-               ret_val.is_ready = true;
-               ret_val.control =
-                   gsl::narrow_cast<short>((control_msb_[channel] << 7) + control_lsb_[channel]);
-               ret_val.value =
-                   gsl::narrow_cast<short>((value_msb_[channel] << 7) + value_lsb_[channel]);
-               Clear(channel);
-            }
+         if (state.msb_only || msb_timeout_.count() == 0)
+            return Emit(channel, gsl::narrow_cast<short>(state.value_msb << 7));
+         state.msb_pending = true;
+         Hold(channel, gsl::narrow_cast<short>(state.value_msb << 7), time);
+         return {true, false};
+      }
+      case 38u: { // data entry LSB
+         if (!IsSelected(state))
+            return {};
+         const auto msb_waiting = state.msb_pending;
+         Reclaim(channel); // a waiting MSB is completed, even if it went out alone
+         state.value_lsb = value & 0x7F;
+         if (msb_waiting || (state.has_value_msb && !state.lsb_first)) {
+            if (msb_waiting)
+               state.lsb_first = false;
+            state.msb_only = false;
+            return Emit(channel, gsl::narrow_cast<short>((state.value_msb << 7) | state.value_lsb));
          }
-         return ret_val;
+         // no MSB yet, or the controller sends LSB first: wait for the MSB. With an MSB from
+         // before, a fine step that no MSB follows still goes out on time
+         state.lsb_pending = true;
+         if (state.has_value_msb && msb_timeout_.count() != 0)
+            Hold(channel, gsl::narrow_cast<short>((state.value_msb << 7) | state.value_lsb), time);
+         return {true, false};
+      }
+      case 96u: // data increment, data byte ignored per RP-018
+      case 97u: { // data decrement
+         if (!IsSelected(state))
+            return {};
+         Reclaim(channel);
+         const short step = state.msb_only ? 0x80 : 1;
+         const auto changed = gsl::narrow_cast<short>(std::clamp(
+             state.value + (control == 96u ? step : -step), 0, static_cast<int>(kMaxNrpnValue)));
+         state.value_msb = changed >> 7;
+         state.has_value_msb = true;
+         return Emit(channel, changed);
+      }
       case 98u:
-         ret_val.is_nrpn = true;
-         control_lsb_[channel] = value & 0x7F;
-         ready_flags_[channel] |= 0b10;
-         return ret_val;
       case 99u:
-         ret_val.is_nrpn = true;
-         control_msb_[channel] = value & 0x7F;
-         ready_flags_[channel] |= 0b1;
-         return ret_val;
+      case 100u:
+      case 101u:
+         Select(channel, control >= 100, (control & 1) != 0, value); // odd numbers are the MSB
+         return {true, false};
       default: // not an expected nrpn control #, handle as typical midi message
+         return {};
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+NrpnFilter::ProcessResult NrpnFilter::TakeDue(rsj::MidiTime now) noexcept
+{
+   if (!Holding())
+      return {};
+   const auto now_count = now.time_since_epoch().count();
+   for (short channel = 0; channel < kChannels; ++channel) {
+      auto& held = held_[channel];
+      auto claim = held.claim.load(std::memory_order_acquire);
+      if (claim == 0 || held.due.load(std::memory_order_relaxed) > now_count)
+         continue;
+      if (held.claim.compare_exchange_strong(claim, 0, std::memory_order_acq_rel)) {
+         held_count_.fetch_sub(1, std::memory_order_relaxed);
+         return {true, true, gsl::narrow_cast<short>(claim >> kFieldBits & kFieldMask),
+             gsl::narrow_cast<short>(claim & kFieldMask), channel,
+             (claim >> (2 * kFieldBits) & 1) != 0};
+      }
+   }
+   return {};
+}
+
+std::optional<rsj::MidiTime> NrpnFilter::NextDue() const noexcept
+{
+   if (!Holding())
+      return std::nullopt;
+   std::optional<rsj::MidiClock::rep> first{};
+   for (const auto& held : held_)
+      if (held.claim.load(std::memory_order_acquire) != 0) {
+         const auto due = held.due.load(std::memory_order_relaxed);
+         if (!first || due < *first)
+            first = due;
+      }
+   if (!first)
+      return std::nullopt;
+   return rsj::MidiTime(rsj::MidiClock::duration(*first));
+}
+
+void NrpnFilter::Reset() noexcept
+{
+   channels_.fill({});
+   for (auto& held : held_)
+      if (held.claim.exchange(0, std::memory_order_acq_rel) != 0)
+         held_count_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+NrpnFilter::ProcessResult NrpnFilter::Emit(short channel, short value) noexcept
+{
+   auto& state = channels_[channel];
+   state.value = value;
+   return {true, true, gsl::narrow_cast<short>((state.parameter_msb << 7) + state.parameter_lsb),
+       value, channel, state.registered};
+}
+
+void NrpnFilter::Select(short channel, bool registered, bool msb, short value) noexcept
+{
+   // a new parameter starts without a value; switching between NRPN and RPN drops the half
+   // selected for the other set, and the null parameter deselects
+   Reclaim(channel);
+   auto& state = channels_[channel];
+   if (state.registered != registered) {
+      state = ChannelState{};
+      state.registered = registered;
+   }
+   state.has_value_msb = false;
+   state.value = 0;
+   if (msb) {
+      state.parameter_msb = value & 0x7F;
+      state.selected |= 0b1;
+   }
+   else {
+      state.parameter_lsb = value & 0x7F;
+      state.selected |= 0b10;
+   }
+}
+
+void NrpnFilter::Hold(short channel, short value, rsj::MidiTime time) noexcept
+{
+   auto& state = channels_[channel];
+   auto& held = held_[channel];
+   if (++generation_ == 0)
+      ++generation_;
+   // counted before it can be taken, so the count never falls below the claims
+   held_count_.fetch_add(1, std::memory_order_relaxed);
+   held.due.store((time + msb_timeout_).time_since_epoch().count(), std::memory_order_relaxed);
+   held.claim.store(Pack(generation_, state.registered,
+                        gsl::narrow_cast<short>((state.parameter_msb << 7) + state.parameter_lsb),
+                        value),
+       std::memory_order_release);
+   state.held = true;
+}
+
+void NrpnFilter::Reclaim(short channel) noexcept
+{
+   auto& state = channels_[channel];
+   if (state.held) {
+      state.held = false;
+      if (held_[channel].claim.exchange(0, std::memory_order_acq_rel) != 0)
+         held_count_.fetch_sub(1, std::memory_order_relaxed);
+      else { // sent by TakeDue, as if it had timed out here
+         state.value = gsl::narrow_cast<short>(
+             state.msb_pending ? state.value_msb << 7 : (state.value_msb << 7) | state.value_lsb);
+         if (state.msb_pending)
+            state.msb_only = true;
+      }
+   }
+   state.msb_pending = false;
+   state.lsb_pending = false;
+}
+
+bool NrpnFilter::IsSelected(const ChannelState& state) noexcept
+{
+   // checked on use, not on selection: moving from x/127 to 127/y passes through 127/127, and
+   // that mustn't lose the half already sent
+   return state.selected == 0b11
+          && !(state.parameter_msb == kNullParameter && state.parameter_lsb == kNullParameter);
+}
+
+Cc14Filter::ProcessResult Cc14Filter::operator()(short channel, short control, short value)
+{
+   try {
+      if (channel < 0 || channel >= kChannels)
+         throw std::range_error(
+             "Channel value in Cc14Filter is " + rsj::NumToChars(channel) + '.');
+      Expects(control >= 0 && control < 2 * kPairs);
+      Expects(value <= 0x7F);
+      const auto pair = control % kPairs;
+      auto& msb = msb_[channel][pair];
+      auto& pending = msb_pending_[channel][pair];
+      if (control < kPairs) { // MSB
+         const ProcessResult ret_val{pending, gsl::narrow_cast<short>(pair),
+             gsl::narrow_cast<short>(msb << 7)};
+         msb = value & 0x7F;
+         pending = true;
          return ret_val;
       }
+      pending = false; // LSB
+      return {true, gsl::narrow_cast<short>(pair), gsl::narrow_cast<short>((msb << 7) | value)};
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
       throw;
    }
 }
+
+#if JUCE_UNIT_TESTS
+namespace {
+   class NrpnFilterTest final : public juce::UnitTest {
+    public:
+      NrpnFilterTest() : juce::UnitTest("NrpnFilter", "MIDI2LR") {}
+
+      void runTest() override
+      {
+         using namespace std::chrono_literals;
+         const auto start = rsj::MidiClock::now();
+         constexpr short kParameter{1 << 7 | 2};
+
+         beginTest("data entry LSB before MSB");
+         {
+            NrpnFilter filter{};
+            Select(filter, start);
+            auto result = filter(0, 38, 5, start);
+            expect(result.is_nrpn && !result.is_ready, "LSB held for its MSB");
+            result = filter(0, 6, 3, start);
+            expect(result.is_ready, "MSB completes the pair");
+            expectEquals<int>(result.control, kParameter);
+            expectEquals<int>(result.value, 3 << 7 | 5);
+            // the next LSB waits for its own MSB instead of refining the last one
+            result = filter(0, 38, 9, start + 1ms);
+            expect(!result.is_ready, "later LSB held too");
+            result = filter(0, 6, 4, start + 2ms);
+            expect(result.is_ready, "second pair");
+            expectEquals<int>(result.value, 4 << 7 | 9);
+            expect(!filter.Holding() && !filter.TakeDue(start + 1s).is_ready, "nothing left held");
+         }
+
+         beginTest("data entry MSB before LSB");
+         {
+            NrpnFilter filter{};
+            Select(filter, start);
+            expect(!filter(0, 6, 3, start).is_ready, "MSB held for its LSB");
+            const auto result = filter(0, 38, 5, start);
+            expect(result.is_ready, "LSB completes the pair");
+            expectEquals<int>(result.value, 3 << 7 | 5);
+            expectEquals<int>(filter(0, 38, 6, start).value, 3 << 7 | 6); // fine step alone
+         }
+
+         beginTest("MSB-only timeout");
+         {
+            NrpnFilter filter{};
+            Select(filter, start);
+            expect(!filter(0, 6, 3, start).is_ready, "MSB held for its LSB");
+            expect(filter.NextDue() == start + kTimeout, "due after the timeout");
+            expect(!filter.TakeDue(start + kTimeout - 1ms).is_ready, "not due yet");
+            const auto result = filter.TakeDue(start + kTimeout);
+            expect(result.is_ready, "MSB sent alone on time");
+            expectEquals<int>(result.control, kParameter);
+            expectEquals<int>(result.value, 3 << 7);
+            expect(!filter.TakeDue(start + 1s).is_ready, "sent once");
+            const auto next = filter(0, 6, 4, start + 1s);
+            expect(next.is_ready, "channel now MSB-only");
+            expectEquals<int>(next.value, 4 << 7);
+         }
+
+         beginTest("LSB-first fine step without MSB");
+         {
+            NrpnFilter filter{};
+            Select(filter, start);
+            filter(0, 38, 5, start);
+            filter(0, 6, 3, start);
+            expect(!filter(0, 38, 7, start).is_ready, "LSB held for its MSB");
+            const auto result = filter.TakeDue(start + kTimeout);
+            expect(result.is_ready, "sent with the last MSB on time");
+            expectEquals<int>(result.value, 3 << 7 | 7);
+            const auto next = filter(0, 38, 8, start + 1s);
+            expect(!next.is_ready, "still LSB first, not MSB-only");
+         }
+      }
+
+    private:
+      static constexpr auto kTimeout{std::chrono::milliseconds(20)};
+
+      static void Select(NrpnFilter& filter, rsj::MidiTime time)
+      {
+         filter.SetMsbTimeout(kTimeout);
+         filter(0, 99, 1, time);
+         filter(0, 98, 2, time);
+      }
+   };
+
+   NrpnFilterTest nrpn_filter_test{}; // registers with juce::UnitTest::getAllTests
+} // namespace
+#endif
@@ -21,35 +21,118 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 ==============================================================================
 */
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "MidiUtilities.h"
 
 class NrpnFilter {
-   // This  assumes that all NRPN messages have 4 messages, though the NRPN standard allows omission
-   // of the 4th message. If the 4th message is dropped, this class silently consumes the message
-   // without emitting anything. Caller must handle all concurrency considerations.
+   // Assembles NRPN and RPN parameter changes. Both use the same 14-bit parameter numbers (MSB
+   // << 7 | LSB); is_rpn tells which set the number belongs to. Once a parameter is selected with
+   // CC 99/98 (NRPN) or CC 101/100 (RPN) it stays selected, so a controller may send the
+   // selection once and then stream only data entry (CC 6/38) or data increment/decrement (CC
+   // 96/97). Data entry halves may come in either order: whichever arrives first is held for
+   // the other, and the order seen is remembered per channel, so an LSB that doesn't follow an
+   // MSB waits for one. If an MSB's LSB doesn't arrive within the MSB-only timeout, the MSB is
+   // taken as the whole value and the channel is treated as MSB-only, emitting on each MSB, until
+   // an LSB shows up again. An LSB whose MSB doesn't arrive in time goes out with the last MSB. A
+   // timeout of zero emits on every MSB. Selecting the null parameter (127/127) deselects, after
+   // which CC 6/38/96/97 pass through as ordinary controllers. operator() and Reset must only be
+   // used by one thread; MidiReceiver keeps one filter per input device so each is only used by
+   // that device's callback thread. TakeDue, Holding and NextDue may be called from any thread,
+   // so another thread can time out held halves without waiting for the device's next message.
  public:
    struct ProcessResult {
-      bool is_nrpn{};
+      bool is_nrpn{}; // consumed as part of an NRPN or RPN
       bool is_ready{};
       short control{};
       short value{};
+      short channel{};
+      bool is_rpn{};
    };
-   ProcessResult operator()(short channel, short control, short value);
+   ProcessResult operator()(short channel, short control, short value, rsj::MidiTime time = {});
+   // returns a held half whose timeout has run out by now, call until is_ready is false. Each
+   // held half is returned once, here or by the filter when its partner arrives
+   ProcessResult TakeDue(rsj::MidiTime now) noexcept;
+   [[nodiscard]] bool Holding() const noexcept
+   {
+      return held_count_.load(std::memory_order_acquire) > 0;
+   }
+   // when the first held half times out, nullopt if nothing is held
+   [[nodiscard]] std::optional<rsj::MidiTime> NextDue() const noexcept;
+   void SetMsbTimeout(std::chrono::microseconds timeout) noexcept
+   {
+      msb_timeout_ = timeout;
+   }
+   void Reset() noexcept;
 
  private:
    static constexpr int kChannels{16};
-   std::array<int, kChannels> control_msb_{};
-   std::array<int, kChannels> control_lsb_{};
-   std::array<int, kChannels> value_msb_{};
-   std::array<int, kChannels> value_lsb_{};
-   std::array<int, kChannels> ready_flags_{};
-   void Clear(int channel) noexcept
+   struct ChannelState {
+      short parameter_msb{0};
+      short parameter_lsb{0};
+      short selected{0}; // 0b01 parameter MSB seen, 0b10 parameter LSB seen
+      short value_msb{0};
+      short value_lsb{0};
+      short value{0}; // last emitted, the base for increment and decrement
+      bool has_value_msb{false};
+      bool msb_pending{false};
+      bool lsb_pending{false};
+      bool held{false}; // the pending half has a timeout, see Held
+      bool msb_only{false};
+      bool lsb_first{false}; // the controller sends data entry LSB before MSB
+      bool registered{false}; // parameter is an RPN
+   };
+   // the value a held half goes out as when it times out, shared with TakeDue's thread. claim
+   // is zero when nothing is held; whichever thread swaps it to zero owns the half
+   struct Held {
+      std::atomic<std::uint64_t> claim{0};
+      std::atomic<rsj::MidiClock::rep> due{0};
+   };
+   ProcessResult Emit(short channel, short value) noexcept;
+   // both halves of the parameter seen, and together they aren't the null parameter
+   [[nodiscard]] static bool IsSelected(const ChannelState& state) noexcept;
+   void Select(short channel, bool registered, bool msb, short value) noexcept;
+   // gives the pending half a timeout; it goes out as value if its partner doesn't come in time
+   void Hold(short channel, short value, rsj::MidiTime time) noexcept;
+   // ends the pending half. If TakeDue already sent it, catches the channel up with that
+   void Reclaim(short channel) noexcept;
+   std::array<ChannelState, kChannels> channels_{};
+   std::array<Held, kChannels> held_{};
+   std::atomic<int> held_count_{0}; // never less than the number of non-zero claims
+   std::uint32_t generation_{0};    // tells claims of the same value apart
+   std::chrono::microseconds msb_timeout_{0};
+};
+
+// Joins high-resolution controller pairs, MSB on CC 0-31 and LSB on CC 32-63, into one 14-bit
+// value on the MSB's control number. Only feed it controls opted in to 14-bit handling. The value
+// is emitted when the LSB arrives. An LSB without a new MSB (allowed when only the fine part
+// changes) reuses the last MSB. An MSB followed by another MSB emits the first with a zero LSB,
+// but an MSB on its own is held until the next message for that control. Same concurrency
+// rules as NrpnFilter.
+class Cc14Filter {
+ public:
+   struct ProcessResult {
+      bool is_ready{};
+      short control{};
+      short value{};
+   };
+   ProcessResult operator()(short channel, short control, short value);
+   void Reset() noexcept
    {
-      ready_flags_[channel] = 0;
-      control_msb_[channel] = 0;
-      control_lsb_[channel] = 0;
-      value_msb_[channel] = 0;
-      value_lsb_[channel] = 0;
+      for (auto& channel : msb_)
+         channel.fill(0);
+      for (auto& channel : msb_pending_)
+         channel.fill(false);
    }
+
+ private:
+   static constexpr int kChannels{16};
+   static constexpr int kPairs{32};
+   std::array<std::array<short, kPairs>, kChannels> msb_{};
+   std::array<std::array<bool, kPairs>, kChannels> msb_pending_{};
 };
 
 #endif
\ No newline at end of file
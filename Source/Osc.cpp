@@ -0,0 +1,233 @@
+/*
+==============================================================================
+
+Osc.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "Osc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include "Misc.h"
+
+namespace {
+   constexpr int kMaxBundleDepth{8};
+   constexpr std::string_view kBundleTag{"#bundle"};
+   constexpr std::ptrdiff_t kTimeTagSize{8};
+
+   template<class T> [[nodiscard]] T GetBe(const char* src) noexcept
+   {
+      std::uint64_t value{0};
+      for (std::size_t i = 0; i < sizeof(T); ++i)
+         value = value << 8 | static_cast<unsigned char>(src[i]);
+      return static_cast<T>(value);
+   }
+
+   template<class Float, class Bits> [[nodiscard]] double GetBeFloat(const char* src) noexcept
+   {
+      static_assert(sizeof(Float) == sizeof(Bits));
+      const auto bits = GetBe<Bits>(src);
+      Float value{};
+      std::memcpy(&value, &bits, sizeof(value));
+      return static_cast<double>(value);
+   }
+
+   // takes a null terminated string padded with nulls to a multiple of four bytes from the front
+   // of packet. nullopt if it runs past the end.
+   std::optional<std::string_view> TakeString(gsl::span<const char>& packet)
+   {
+      const auto end = std::find(packet.begin(), packet.end(), '\0');
+      if (end == packet.end())
+         return std::nullopt;
+      const auto length = end - packet.begin();
+      const auto padded = (length + 4) & ~std::ptrdiff_t{3};
+      if (padded > packet.size())
+         return std::nullopt;
+      const std::string_view text{packet.data(), gsl::narrow_cast<std::size_t>(length)};
+      packet = packet.subspan(padded);
+      return text;
+   }
+
+   // the first numeric argument, nullopt if there is none or the arguments run past the end
+   std::optional<double> TakeValue(std::string_view type_tags, gsl::span<const char> arguments)
+   {
+#pragma warning(push)
+#pragma warning(disable : 26481) // reading fixed-size fields of a checked length
+      for (const auto tag : type_tags) {
+         std::ptrdiff_t size{0};
+         switch (tag) {
+         case 'T':
+            return 1.0;
+         case 'F':
+            return 0.0;
+         case 'i':
+            if (arguments.size() < 4)
+               return std::nullopt;
+            return static_cast<double>(GetBe<std::int32_t>(arguments.data()));
+         case 'h':
+            if (arguments.size() < 8)
+               return std::nullopt;
+            return static_cast<double>(GetBe<std::int64_t>(arguments.data()));
+         case 'f':
+            if (arguments.size() < 4)
+               return std::nullopt;
+            return GetBeFloat<float, std::uint32_t>(arguments.data());
+         case 'd':
+            if (arguments.size() < 8)
+               return std::nullopt;
+            return GetBeFloat<double, std::uint64_t>(arguments.data());
+         case 'N':
+         case 'I':
+            break; // no data
+         case 's':
+         case 'S':
+            if (!TakeString(arguments))
+               return std::nullopt;
+            break;
+         case 'b':
+            if (arguments.size() < 4)
+               return std::nullopt;
+            size = std::ptrdiff_t{GetBe<std::int32_t>(arguments.data())};
+            size = 4 + ((size + 3) & ~std::ptrdiff_t{3});
+            break;
+         case 'c':
+         case 'r':
+         case 'm':
+            size = 4;
+            break;
+         case 't':
+            size = 8;
+            break;
+         default: // unknown types have unknown sizes, nothing after them can be read
+            return std::nullopt;
+         }
+         if (size < 0 || size > arguments.size())
+            return std::nullopt;
+         arguments = arguments.subspan(size);
+      }
+      return std::nullopt;
+#pragma warning(pop)
+   }
+
+   void ParseElement(gsl::span<const char> packet, std::vector<rsj::OscMessage>& messages,
+       int depth)
+   {
+      const auto address = TakeString(packet);
+      if (!address || address->empty())
+         return;
+      if (*address == kBundleTag) {
+         if (depth >= kMaxBundleDepth || packet.size() < kTimeTagSize)
+            return;
+         packet = packet.subspan(kTimeTagSize);
+         while (packet.size() >= 4) {
+            const auto size = GetBe<std::int32_t>(packet.data());
+            if (size <= 0 || size % 4 != 0 || size > packet.size() - 4)
+               return;
+            ParseElement(packet.subspan(4, size), messages, depth + 1);
+            packet = packet.subspan(4 + size);
+         }
+         return;
+      }
+      if (address->front() != '/')
+         return;
+      // a message without type tags predates OSC 1.0 and is treated as having no arguments
+      if (packet.empty()) {
+         messages.push_back({*address});
+         return;
+      }
+      const auto type_tags = TakeString(packet);
+      if (!type_tags || type_tags->empty() || type_tags->front() != ',')
+         return;
+      if (type_tags->size() == 1) {
+         messages.push_back({*address});
+         return;
+      }
+      const auto value = TakeValue(type_tags->substr(1), packet);
+      if (value && std::isfinite(*value))
+         messages.push_back({*address, *value});
+   }
+
+   struct AddressTable {
+      std::mutex mutex{};
+      std::vector<std::string> addresses{};
+      std::unordered_map<std::string, int> indexes{};
+   };
+
+   AddressTable& Addresses()
+   {
+      static AddressTable table{};
+      return table;
+   }
+} // namespace
+
+void rsj::ParseOsc(gsl::span<const char> packet, std::vector<OscMessage>& messages)
+{
+   try {
+      // every OSC packet is a multiple of four bytes
+      if (packet.empty() || packet.size() % 4 != 0)
+         return;
+      ParseElement(packet, messages, 0);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+int rsj::OscAddressIndex(std::string_view address)
+{
+   try {
+      auto& table = Addresses();
+      auto lock = std::scoped_lock(table.mutex);
+      const auto [entry, added] = table.indexes.try_emplace(
+          std::string(address), gsl::narrow_cast<int>(table.addresses.size()));
+      if (!added)
+         return entry->second;
+      if (table.addresses.size() >= kMaxOscAddresses) {
+         table.indexes.erase(entry);
+         return -1;
+      }
+      table.addresses.push_back(entry->first);
+      return entry->second;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+std::string rsj::OscAddress(int index)
+{
+   try {
+      auto& table = Addresses();
+      auto lock = std::scoped_lock(table.mutex);
+      if (index < 0 || gsl::narrow_cast<std::size_t>(index) >= table.addresses.size())
+         return {};
+      return table.addresses.at(gsl::narrow_cast<std::size_t>(index));
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
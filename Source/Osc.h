@@ -0,0 +1,54 @@
+#ifndef MIDI2LR_OSC_H_INCLUDED
+#define MIDI2LR_OSC_H_INCLUDED
+/*
+==============================================================================
+
+Osc.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/gsl>
+
+// Open Sound Control packets as sent over UDP by tablet and software control surfaces. Only
+// what a control surface needs is understood: messages, bundles (timetags are ignored, contents
+// are handled at once) and the numeric argument types. Addresses are matched literally, OSC
+// pattern matching isn't supported.
+namespace rsj {
+   constexpr int kMaxOscAddresses{4096};
+
+   struct OscMessage {
+      std::string_view address; // points into the packet
+      double value{1.0};
+   };
+
+   // appends each message in packet, including those in bundles, to messages. value is the
+   // message's first int32, int64, float32, float64 or true/false argument, or 1 for a message
+   // with no arguments (an OSC trigger). Malformed parts and messages with only non-numeric
+   // arguments are skipped.
+   void ParseOsc(gsl::span<const char> packet, std::vector<OscMessage>& messages);
+   // addresses are numbered in the order first seen, for the life of the program, so messages and
+   // profile rows can name them with a number. -1 once kMaxOscAddresses have been numbered.
+   // Thread safe.
+   [[nodiscard]] int OscAddressIndex(std::string_view address);
+   // empty for a number never handed out. Thread safe.
+   [[nodiscard]] std::string OscAddress(int index);
+} // namespace rsj
+
+#endif // MIDI2LR_OSC_H_INCLUDED
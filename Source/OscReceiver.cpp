@@ -0,0 +1,134 @@
+/*
+==============================================================================
+
+OscReceiver.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "OscReceiver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <utility>
+
+#include <gsl/gsl>
+#include "MIDIReceiver.h"
+#include "Misc.h"
+
+namespace {
+   constexpr auto kHost{"127.0.0.1"};
+   constexpr int kMaxPacket{65536}; // larger than any UDP datagram
+} // namespace
+
+OscReceiver::OscReceiver(MidiReceiver& midi_receiver, rsj::Reactor& reactor)
+    : buffer_(kMaxPacket), midi_receiver_{midi_receiver}, reactor_{reactor}
+{
+}
+
+#pragma warning(push)
+#pragma warning(disable : 26447)
+OscReceiver::~OscReceiver()
+{
+   try {
+      Stop();
+   }
+   catch (const std::exception& e) {
+      rsj::LogAndAlertError(juce::String("Exception in OscReceiver Destructor. ") + e.what());
+      std::terminate();
+   }
+}
+#pragma warning(pop)
+
+bool OscReceiver::Start(int port)
+{
+   try {
+      if (!socket_.bindToPort(port, kHost)) {
+         rsj::Log("Unable to listen for OSC on port " + juce::String(port));
+         return false;
+      }
+      slot_ = midi_receiver_.ClaimSlot("OSC port " + juce::String(port));
+      if (!slot_) {
+         socket_.shutdown();
+         return false;
+      }
+      watch_ = reactor_.Watch(socket_.getRawSocketHandle(), [this] { Read(); });
+      return true;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void OscReceiver::Stop()
+{
+   try {
+      reactor_.Cancel(std::exchange(watch_, 0));
+      socket_.shutdown();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void OscReceiver::Read()
+{
+   try {
+      // each read is one datagram, which holds one OSC packet. A failed read, such as Windows
+      // reporting an earlier send as unreachable, leaves the socket usable
+      const auto size = socket_.read(buffer_.data(), kMaxPacket, false);
+      if (size > 0)
+         Receive(gsl::span<const char>(buffer_.data(), size));
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void OscReceiver::Receive(gsl::span<const char> packet)
+{
+   try {
+      const auto time = rsj::MidiClock::now();
+      messages_.clear();
+      rsj::ParseOsc(packet, messages_);
+      for (const auto& osc : messages_) {
+         const auto index = rsj::OscAddressIndex(osc.address);
+         if (index < 0) {
+            if (!std::exchange(table_full_logged_, true))
+               rsj::Log("Too many OSC addresses, ignoring new ones starting with "
+                        + juce::String(osc.address.data(), osc.address.size()));
+            continue;
+         }
+         // value carries the whole part and fraction the rest, as for MIDI 2.0 values
+         const auto value =
+             std::clamp(osc.value, static_cast<double>(std::numeric_limits<short>::min()),
+                 static_cast<double>(std::numeric_limits<short>::max()));
+         const auto whole = std::floor(value);
+         rsj::MidiMessage message{rsj::kOscFlag, 0, gsl::narrow_cast<short>(index),
+             gsl::narrow_cast<short>(whole), time};
+         message.fraction = value - whole;
+         midi_receiver_.Inject(*slot_, message);
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
@@ -0,0 +1,66 @@
+#ifndef MIDI2LR_OSCRECEIVER_H_INCLUDED
+#define MIDI2LR_OSCRECEIVER_H_INCLUDED
+/*
+==============================================================================
+
+OscReceiver.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <JuceLibraryCode/JuceHeader.h>
+#include "Osc.h"
+#include "Reactor.h"
+class MidiReceiver;
+
+// listens for OSC over UDP on the loopback interface and hands each message to MidiReceiver in
+// a slot of its own as an rsj::kOscFlag message, so OSC goes through the same profile lookup and
+// listeners as MIDI. Addresses are mapped in the profile like MIDI controls, and a mapped
+// message's argument goes to Lightroom as is, clamped to 0 to 1, without MIDI's 7 or 14 bit
+// steps. For commands repeated per step, such as NextPrev, the argument's whole part is the
+// number of steps, so send 1 or -1.
+class OscReceiver final {
+ public:
+   static constexpr int kDefaultPort{58765};
+   OscReceiver(MidiReceiver& midi_receiver, rsj::Reactor& reactor);
+   ~OscReceiver();
+   OscReceiver(const OscReceiver& other) = delete;
+   OscReceiver(OscReceiver&& other) = delete;
+   OscReceiver& operator=(const OscReceiver& other) = delete;
+   OscReceiver& operator=(OscReceiver&& other) = delete;
+   // returns false if the port can't be bound or MidiReceiver has no free slot. Message thread
+   // only, and only once
+   bool Start(int port = kDefaultPort);
+   // stops listening, call before MidiReceiver is destroyed
+   void Stop();
+
+ private:
+   void Read(); // reactor thread
+   void Receive(gsl::span<const char> packet);
+   bool table_full_logged_{false};
+   std::optional<std::size_t> slot_{};
+   std::vector<char> buffer_;                // reactor thread only
+   std::vector<rsj::OscMessage> messages_{}; // reactor thread only
+   juce::DatagramSocket socket_{false};
+   MidiReceiver& midi_receiver_;
+   rsj::Reactor& reactor_;
+   rsj::Reactor::Token watch_{0};
+};
+
+#endif // MIDI2LR_OSCRECEIVER_H_INCLUDED
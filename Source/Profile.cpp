@@ -23,6 +23,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <algorithm>
 
 #include "Misc.h"
+#include "Osc.h"
 
 void Profile::AddCommandForMessageI(size_t command, const rsj::MidiMessageId& message)
 {
@@ -31,6 +32,7 @@ void Profile::AddCommandForMessageI(size_t command, const rsj::MidiMessageId& me
          auto cmd_abbreviation = command_set_.CommandAbbrevAt(command);
          message_map_[message] = cmd_abbreviation;
          command_string_map_.emplace(cmd_abbreviation, message);
+         IndexGesturesI();
          SortI();
          profile_unsaved_ = true;
       }
@@ -55,6 +57,7 @@ void Profile::AddRowMapped(const std::string& command, const rsj::MidiMessageId&
             command_string_map_.emplace(command, message);
          }
          command_table_.push_back(message);
+         IndexGesturesI();
          SortI();
          profile_unsaved_ = true;
       }
@@ -82,6 +85,85 @@ void Profile::AddRowUnmapped(const rsj::MidiMessageId& message)
    }
 }
 
+void Profile::AddRowsUnmapped(gsl::span<const rsj::MidiMessageId> messages, bool per_device)
+{
+   try {
+      const auto& no_command = command_set_.CommandAbbrevAt(0);
+      auto guard = std::unique_lock{mutex_};
+      auto added{false}; // sort once for the whole batch
+      for (const auto& message : messages) {
+         if (FindI(message) == message_map_.end()) { // rows for any device already cover it
+            auto row{message};
+            if (!per_device)
+               row.device = rsj::kAnyDevice;
+            message_map_[row] = no_command;
+            command_string_map_.emplace(no_command, row);
+            command_table_.push_back(row);
+            added = true;
+         }
+      }
+      if (added) {
+         IndexGesturesI();
+         SortI();
+         profile_unsaved_ = true;
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+const rsj::DeviceIdentity& Profile::DeviceIdentityI(int device) const
+{
+   try {
+      static const rsj::DeviceIdentity kNoDevice{};
+      if (device < 0)
+         return kNoDevice;
+      if (const auto number = gsl::narrow_cast<size_t>(device); number < rsj::kMaxInputDevices)
+         return slot_devices_.at(number);
+      else if (number - rsj::kMaxInputDevices < parked_devices_.size())
+         return parked_devices_.at(number - rsj::kMaxInputDevices);
+      return kNoDevice;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+std::string Profile::DeviceLabel(int device) const
+{
+   try {
+      auto guard = std::shared_lock{mutex_};
+      const auto& identity = DeviceIdentityI(device);
+      if (identity.ordinal == 0)
+         return identity.name;
+      return identity.name + " #" + std::to_string(identity.ordinal + 1);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+int Profile::DeviceNumberI(const rsj::DeviceIdentity& identity)
+{
+   try {
+      if (const auto open = std::find(slot_devices_.begin(), slot_devices_.end(), identity);
+          open != slot_devices_.end())
+         return gsl::narrow_cast<int>(open - slot_devices_.begin());
+      auto parked = std::find(parked_devices_.begin(), parked_devices_.end(), identity);
+      if (parked == parked_devices_.end())
+         parked = parked_devices_.insert(parked_devices_.end(), identity);
+      return gsl::narrow_cast<int>(rsj::kMaxInputDevices + (parked - parked_devices_.begin()));
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
 void Profile::FromXml(const juce::XmlElement* root)
 { // external use only, but will either use external versions of Profile calls to lock individual
   // accesses or manually lock any internal calls instead of using mutex for entire method
@@ -91,19 +173,58 @@ void Profile::FromXml(const juce::XmlElement* root)
       RemoveAllRows();
       const auto* setting = root->getFirstChildElement();
       while (setting) {
+         // settings without a device match every device
+         int device{rsj::kAnyDevice};
+         if (const auto device_name = setting->getStringAttribute("device_name");
+             device_name.isNotEmpty()) {
+            auto guard = std::unique_lock{mutex_};
+            device = DeviceNumberI(
+                {device_name.toStdString(), setting->getIntAttribute("device_ordinal")});
+         }
          if (setting->hasAttribute("controller")) {
             const rsj::MidiMessageId message{setting->getIntAttribute("channel"),
-                setting->getIntAttribute("controller"), rsj::MsgIdEnum::kCc};
+                setting->getIntAttribute("controller"), rsj::MsgIdEnum::kCc, device};
             AddRowMapped(setting->getStringAttribute("command_string").toStdString(), message);
          }
          else if (setting->hasAttribute("note")) {
             const rsj::MidiMessageId note{setting->getIntAttribute("channel"),
-                setting->getIntAttribute("note"), rsj::MsgIdEnum::kNote};
+                setting->getIntAttribute("note"), rsj::MsgIdEnum::kNote, device};
             AddRowMapped(setting->getStringAttribute("command_string").toStdString(), note);
          }
+         else if (setting->hasAttribute("rpn")) {
+            const rsj::MidiMessageId rpn{setting->getIntAttribute("channel"),
+                setting->getIntAttribute("rpn"), rsj::MsgIdEnum::kRpn, device};
+            AddRowMapped(setting->getStringAttribute("command_string").toStdString(), rpn);
+         }
+         else if (setting->hasAttribute("longpress")) {
+            const rsj::MidiMessageId long_press{setting->getIntAttribute("channel"),
+                setting->getIntAttribute("longpress"), rsj::MsgIdEnum::kLongPress, device};
+            AddRowMapped(setting->getStringAttribute("command_string").toStdString(), long_press);
+         }
+         else if (setting->hasAttribute("doubletap")) {
+            const rsj::MidiMessageId double_tap{setting->getIntAttribute("channel"),
+                setting->getIntAttribute("doubletap"), rsj::MsgIdEnum::kDoubleTap, device};
+            AddRowMapped(setting->getStringAttribute("command_string").toStdString(), double_tap);
+         }
+         else if (setting->hasAttribute("chord")) {
+            const rsj::MidiMessageId chord{setting->getIntAttribute("channel"),
+                rsj::ChordNumber(gsl::narrow_cast<short>(setting->getIntAttribute("chord")),
+                    gsl::narrow_cast<short>(setting->getIntAttribute("chord_with"))),
+                rsj::MsgIdEnum::kChord, device};
+            AddRowMapped(setting->getStringAttribute("command_string").toStdString(), chord);
+         }
+         else if (setting->hasAttribute("osc")) {
+            const auto index = rsj::OscAddressIndex(
+                setting->getStringAttribute("osc").toStdString());
+            if (index >= 0) {
+               const rsj::MidiMessageId osc{
+                   setting->getIntAttribute("channel"), index, rsj::MsgIdEnum::kOsc, device};
+               AddRowMapped(setting->getStringAttribute("command_string").toStdString(), osc);
+            }
+         }
          else if (setting->hasAttribute("pitchbend")) {
             const rsj::MidiMessageId pb{
-                setting->getIntAttribute("channel"), 0, rsj::MsgIdEnum::kPitchBend};
+                setting->getIntAttribute("channel"), 0, rsj::MsgIdEnum::kPitchBend, device};
             AddRowMapped(setting->getStringAttribute("command_string").toStdString(), pb);
          }
          setting = setting->getNextElement();
@@ -135,6 +256,90 @@ std::vector<rsj::MidiMessageId> Profile::GetMessagesForCommand(const std::string
    }
 }
 
+void Profile::ResolveCommands(gsl::span<rsj::MidiEvent> events) const
+{
+   try {
+      auto guard = std::shared_lock{mutex_};
+      for (auto& event : events) {
+         if (const auto found = FindI(event.id); found != message_map_.end())
+            event.command = command_set_.CommandTextIndex(found->second);
+         else
+            event.command = rsj::MidiEvent::kNotInProfile;
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+Profile::NoteGestures Profile::GesturesFor(const rsj::MidiMessageId& note) const
+{
+   try {
+      static const GestureRows kNone{};
+      const auto rows_for = [this](const rsj::MidiMessageId& id) -> const GestureRows& {
+         const auto found = gesture_rows_.find(id);
+         return found == gesture_rows_.end() ? kNone : found->second;
+      };
+      auto any_device{note};
+      any_device.device = rsj::kAnyDevice;
+      auto guard = std::shared_lock{mutex_};
+      const auto& own = rows_for(note);
+      const auto& any = rows_for(any_device);
+      // as FindI: a row for the note's own device is used in place of one for any device
+      NoteGestures gestures{};
+      gestures.long_press = own.long_press_row ? own.mapped.long_press : any.mapped.long_press;
+      gestures.double_tap = own.double_tap_row ? own.mapped.double_tap : any.mapped.double_tap;
+      gestures.chord_partners = own.mapped.chord_partners | any.mapped.chord_partners;
+      return gestures;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void Profile::IndexGesturesI()
+{
+   try {
+      gesture_rows_.clear();
+      for (const auto& [id, command] : message_map_) {
+         const auto mapped = command_set_.CommandTextIndex(command) != 0;
+         const auto rows_of = [this, &id](int note) -> GestureRows& {
+            return gesture_rows_[{id.channel, note, rsj::MsgIdEnum::kNote, id.device}];
+         };
+         switch (id.msg_id_type) {
+         case rsj::MsgIdEnum::kLongPress: {
+            auto& rows = rows_of(id.data);
+            rows.long_press_row = true;
+            rows.mapped.long_press = mapped;
+            break;
+         }
+         case rsj::MsgIdEnum::kDoubleTap: {
+            auto& rows = rows_of(id.data);
+            rows.double_tap_row = true;
+            rows.mapped.double_tap = mapped;
+            break;
+         }
+         case rsj::MsgIdEnum::kChord:
+            if (mapped) {
+               const auto low = id.data >> 7;
+               const auto high = id.data & 0x7F;
+               rows_of(low).mapped.chord_partners.set(gsl::narrow_cast<size_t>(high));
+               rows_of(high).mapped.chord_partners.set(gsl::narrow_cast<size_t>(low));
+            }
+            break;
+         default:
+            break;
+         }
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
 void Profile::RemoveAllRows()
 {
    try {
@@ -142,6 +347,8 @@ void Profile::RemoveAllRows()
       command_string_map_.clear();
       command_table_.clear();
       message_map_.clear();
+      gesture_rows_.clear();
+      parked_devices_.clear();
       profile_unsaved_ = false;
       // no reason for profile_unsaved_ here. nothing to save
    }
@@ -157,6 +364,7 @@ void Profile::RemoveMessage(const rsj::MidiMessageId& message)
       auto guard = std::unique_lock{mutex_};
       command_string_map_.erase(message_map_.at(message));
       message_map_.erase(message);
+      IndexGesturesI();
       profile_unsaved_ = true;
    }
    catch (const std::exception& e) {
@@ -173,6 +381,7 @@ void Profile::RemoveRow(size_t row)
       command_string_map_.erase(message_map_.at(msg));
       command_table_.erase(command_table_.cbegin() + row);
       message_map_.erase(msg);
+      IndexGesturesI();
       profile_unsaved_ = true;
    }
    catch (const std::exception& e) {
@@ -181,6 +390,37 @@ void Profile::RemoveRow(size_t row)
    }
 }
 
+void Profile::RenumberDeviceI(int from, int to)
+{
+   try {
+      const auto renumber = [from, to](rsj::MidiMessageId id) noexcept {
+         if (id.device == from)
+            id.device = to;
+         return id;
+      };
+      const auto renumber_keys = [&renumber](
+                                     std::unordered_map<rsj::MidiMessageId, std::string>& map) {
+         std::unordered_map<rsj::MidiMessageId, std::string> renumbered{};
+         renumbered.reserve(map.size());
+         for (auto& [id, command] : map)
+            renumbered.emplace(renumber(id), std::move(command));
+         map.swap(renumbered);
+      };
+      renumber_keys(message_map_);
+      renumber_keys(saved_map_); // so the renumbering doesn't look like an unsaved change
+      for (auto& entry : command_string_map_)
+         entry.second = renumber(entry.second);
+      std::transform(
+          command_table_.begin(), command_table_.end(), command_table_.begin(), renumber);
+      IndexGesturesI();
+      SortI();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
 void Profile::Resort(std::pair<int, bool> new_order)
 {
    try {
@@ -194,6 +434,34 @@ void Profile::Resort(std::pair<int, bool> new_order)
    }
 }
 
+void Profile::SetSlotDevice(size_t slot, const rsj::DeviceIdentity& identity)
+{
+   try {
+      auto guard = std::unique_lock{mutex_};
+      auto& current = slot_devices_.at(slot);
+      if (current == identity)
+         return;
+      const auto slot_number = gsl::narrow_cast<int>(slot);
+      if (!current.name.empty()) { // park the closed device's rows until it returns
+         const auto closed = current;
+         current = {};
+         RenumberDeviceI(slot_number, DeviceNumberI(closed));
+      }
+      current = identity;
+      if (!identity.name.empty())
+         if (const auto parked =
+                 std::find(parked_devices_.begin(), parked_devices_.end(), identity);
+             parked != parked_devices_.end())
+            RenumberDeviceI(
+                gsl::narrow_cast<int>(rsj::kMaxInputDevices + (parked - parked_devices_.begin())),
+                slot_number);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
 void Profile::SortI()
 {
    try {
@@ -229,6 +497,14 @@ void Profile::ToXmlFile(const juce::File& file)
          for (const auto& map_entry : message_map_) {
             auto setting = std::make_unique<juce::XmlElement>("setting");
             setting->setAttribute("channel", map_entry.first.channel);
+            if (map_entry.first.device != rsj::kAnyDevice) {
+               // the slot number is only good until the devices change, the name lasts
+               const auto& device = DeviceIdentityI(map_entry.first.device);
+               if (!device.name.empty())
+                  setting->setAttribute("device_name", juce::String(device.name));
+               if (device.ordinal > 0)
+                  setting->setAttribute("device_ordinal", device.ordinal);
+            }
             switch (map_entry.first.msg_id_type) {
             case rsj::MsgIdEnum::kNote:
                setting->setAttribute("note", map_entry.first.data);
@@ -239,6 +515,22 @@ void Profile::ToXmlFile(const juce::File& file)
             case rsj::MsgIdEnum::kPitchBend:
                setting->setAttribute("pitchbend", 0);
                break;
+            case rsj::MsgIdEnum::kRpn:
+               setting->setAttribute("rpn", map_entry.first.data);
+               break;
+            case rsj::MsgIdEnum::kOsc:
+               setting->setAttribute("osc", rsj::OscAddress(map_entry.first.data));
+               break;
+            case rsj::MsgIdEnum::kLongPress:
+               setting->setAttribute("longpress", map_entry.first.data);
+               break;
+            case rsj::MsgIdEnum::kDoubleTap:
+               setting->setAttribute("doubletap", map_entry.first.data);
+               break;
+            case rsj::MsgIdEnum::kChord:
+               setting->setAttribute("chord", map_entry.first.data >> 7);
+               setting->setAttribute("chord_with", map_entry.first.data & 0x7F);
+               break;
             }
             setting->setAttribute("command_string", map_entry.second);
             root.addChildElement(setting.release());
@@ -20,6 +20,8 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
+#include <array>
+#include <bitset>
 #include <exception>
 #include <map>
 #include <shared_mutex>
@@ -37,13 +39,38 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 // without I do have mutex and could be called by another class
 class Profile {
  public:
+   // the gestures of one note that are mapped to a command, see GestureFilter
+   struct NoteGestures {
+      bool long_press{false};
+      bool double_tap{false};
+      std::bitset<128> chord_partners{}; // notes it makes a mapped chord with
+      [[nodiscard]] bool Any() const noexcept
+      {
+         return long_press || double_tap || chord_partners.any();
+      }
+   };
    explicit Profile(const CommandSet& command_set) : command_set_{command_set} {}
    void AddCommandForMessage(size_t command, const rsj::MidiMessageId& message);
    void AddRowMapped(const std::string& command, const rsj::MidiMessageId& message);
    void AddRowUnmapped(const rsj::MidiMessageId& message);
+   // rows for messages no row covers yet, for any device unless per_device
+   void AddRowsUnmapped(gsl::span<const rsj::MidiMessageId> messages, bool per_device);
    [[nodiscard]] bool CommandHasAssociatedMessage(const std::string& command) const;
+   // a row's device as shown to the user, empty for kAnyDevice
+   [[nodiscard]] std::string DeviceLabel(int device) const;
    void FromXml(const juce::XmlElement* root);
    [[nodiscard]] const std::string& GetCommandForMessage(const rsj::MidiMessageId& message) const;
+   // command name for a CommandSet index, such as rsj::MidiEvent::command
+   [[nodiscard]] const std::string& GetCommandForIndex(size_t index) const
+   {
+      return command_set_.CommandAbbrevAt(index); // command set never changes, no lock needed
+   }
+   // sets each event's command index, one lookup per event under a single lock. Events for
+   // messages not in the profile get rsj::MidiEvent::kNotInProfile
+   void ResolveCommands(gsl::span<rsj::MidiEvent> events) const;
+   // note is the kNote id of a press, with its device. Rows for any device count too, rows
+   // left "Unmapped" don't. Looked up in an index kept as rows change, not searched for
+   [[nodiscard]] NoteGestures GesturesFor(const rsj::MidiMessageId& note) const;
    [[nodiscard]] const rsj::MidiMessageId& GetMessageForNumber(size_t num) const;
    [[nodiscard]] std::vector<rsj::MidiMessageId> GetMessagesForCommand(
        const std::string& command) const;
@@ -54,6 +81,9 @@ class Profile {
    void RemoveMessage(const rsj::MidiMessageId& message);
    void RemoveRow(size_t row);
    void Resort(std::pair<int, bool> new_order);
+   // slot's new device, or no name when it closed, see MidiReceiver::AddSlotCallback. The closed
+   // device's rows keep a number past the slots until it opens again, in any slot
+   void SetSlotDevice(size_t slot, const rsj::DeviceIdentity& identity);
    [[nodiscard]] size_t Size() const;
    void ToXmlFile(const juce::File& file);
 
@@ -61,7 +91,18 @@ class Profile {
    void AddCommandForMessageI(size_t command, const rsj::MidiMessageId& message);
    const std::string& GetCommandForMessageI(const rsj::MidiMessageId& message) const;
    const rsj::MidiMessageId& GetMessageForNumberI(size_t num) const;
+   // a row for the message's own device, or failing that a row for any device
+   std::unordered_map<rsj::MidiMessageId, std::string>::const_iterator FindI(
+       const rsj::MidiMessageId& message) const;
+   // the device's slot if it is open, else its number past the slots, given one if it has none
+   int DeviceNumberI(const rsj::DeviceIdentity& identity);
+   const rsj::DeviceIdentity& DeviceIdentityI(int device) const;
    bool MessageExistsInMapI(const rsj::MidiMessageId& message) const;
+   // rebuilds gesture_rows_ from message_map_, after any change to the rows
+   void IndexGesturesI();
+   // moves every row for device from to device to. The rows are unchanged, so there is nothing
+   // new to save
+   void RenumberDeviceI(int from, int to);
    void SortI();
 
    bool profile_unsaved_{false};
@@ -70,8 +111,17 @@ class Profile {
    std::multimap<std::string, rsj::MidiMessageId> command_string_map_{};
    std::pair<int, bool> current_sort_{2, true};
    std::unordered_map<rsj::MidiMessageId, std::string> message_map_{};
+   // the gesture rows of one note on one device, or on any device
+   struct GestureRows {
+      NoteGestures mapped{};
+      bool long_press_row{false}; // even if unmapped, it hides a long press row for any device
+      bool double_tap_row{false};
+   };
+   std::unordered_map<rsj::MidiMessageId, GestureRows> gesture_rows_{}; // by kNote id
    std::unordered_map<rsj::MidiMessageId, std::string> saved_map_{};
    std::vector<rsj::MidiMessageId> command_table_{};
+   std::array<rsj::DeviceIdentity, rsj::kMaxInputDevices> slot_devices_{};
+   std::vector<rsj::DeviceIdentity> parked_devices_{}; // numbered from kMaxInputDevices
 };
 
 inline void Profile::AddCommandForMessage(size_t command, const rsj::MidiMessageId& message)
@@ -148,8 +198,10 @@ inline int Profile::GetRowForMessage(const rsj::MidiMessageId& message) const
 {
    try {
       auto guard = std::shared_lock{mutex_};
-      return gsl::narrow_cast<int>(std::find(command_table_.begin(), command_table_.end(), message)
-                                   - command_table_.begin());
+      const auto found = FindI(message);
+      const auto& row = found == message_map_.end() ? message : found->first;
+      return gsl::narrow_cast<int>(
+          std::find(command_table_.begin(), command_table_.end(), row) - command_table_.begin());
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -180,6 +232,23 @@ inline bool Profile::MessageExistsInMapI(const rsj::MidiMessageId& message) cons
    }
 }
 
+inline std::unordered_map<rsj::MidiMessageId, std::string>::const_iterator Profile::FindI(
+    const rsj::MidiMessageId& message) const
+{
+   try {
+      if (const auto found = message_map_.find(message);
+          found != message_map_.end() || message.device == rsj::kAnyDevice)
+         return found;
+      auto any_device{message};
+      any_device.device = rsj::kAnyDevice;
+      return message_map_.find(any_device);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
 inline bool Profile::ProfileUnsaved() const
 {
    try {
@@ -24,22 +24,23 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <utility>
 
 #include <gsl/gsl>
-#include "ControlsModel.h"
 #include "LR_IPC_Out.h"
 #include "MIDIReceiver.h"
 #include "MidiUtilities.h"
 #include "Profile.h"
 using namespace std::literals::string_literals;
 
-ProfileManager::ProfileManager(ControlsModel& c_model, Profile& profile,
-    std::weak_ptr<LrIpcOut>&& out, MidiReceiver& midi_receiver) noexcept
-    : current_profile_{profile}, controls_model_{c_model}, lr_ipc_out_{std::move(out)}
+ProfileManager::ProfileManager(
+    Profile& profile, std::weak_ptr<LrIpcOut>&& out, MidiReceiver& midi_receiver) noexcept
+    : current_profile_{profile}, lr_ipc_out_{std::move(out)}
 {
-   midi_receiver.AddCallback(this, &ProfileManager::MidiCmdCallback);
+   midi_receiver.AddCallback<&ProfileManager::MidiCmdCallback>(this);
+   // rows for a device follow it to whichever slot it opens in
+   midi_receiver.AddSlotCallback<&ProfileManager::SlotCallback>(this);
    if (const auto ptr = lr_ipc_out_.lock())
       // add ourselves as a listener to LR_IPC_OUT so that we can send plugin
       // settings on connection
-      ptr->AddCallback(this, &ProfileManager::ConnectionCallback);
+      ptr->AddCallback<&ProfileManager::ConnectionCallback>(this);
 }
 
 void ProfileManager::SetProfileDirectory(const juce::File& directory)
@@ -135,10 +136,9 @@ void ProfileManager::SwitchToPreviousProfile()
    }
 }
 
-void ProfileManager::MapCommand(const rsj::MidiMessageId& msg)
+void ProfileManager::MapCommand(const std::string& cmd)
 {
    try {
-      const auto cmd = current_profile_.GetCommandForMessage(msg);
       if (cmd == "PrevPro"s) {
          switch_state_ = SwitchState::kPrev;
          triggerAsyncUpdate();
@@ -154,15 +154,27 @@ void ProfileManager::MapCommand(const rsj::MidiMessageId& msg)
    }
 }
 
-void ProfileManager::MidiCmdCallback(rsj::MidiMessage mm)
+void ProfileManager::MidiCmdCallback(gsl::span<const rsj::MidiEvent> events)
 {
    try {
-      const rsj::MidiMessageId cc = mm;
-      // return if the value isn't high enough (notes may be < 1), or the command isn't a valid
-      // profile-related command
-      if (controls_model_.ControllerToPlugin(mm) < 0.4 || !current_profile_.MessageExistsInMap(cc))
-         return;
-      MapCommand(cc);
+      for (const auto& event : events) {
+         // skip if the command isn't mapped or the value isn't high enough (notes may be < 1);
+         // MapCommand ignores anything but profile-related commands
+         if (!event.IsMapped() || event.value < 0.4)
+            continue;
+         MapCommand(current_profile_.GetCommandForIndex(event.command));
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void ProfileManager::SlotCallback(size_t slot, const rsj::DeviceIdentity& identity)
+{
+   try {
+      current_profile_.SetSlotDevice(slot, identity);
    }
    catch (const std::exception& e) {
       rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -21,42 +21,42 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include <exception>
-#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <gsl/gsl>
 #include <JuceLibraryCode/JuceHeader.h>
+#include "Delegate.h"
 #include "Misc.h"
 #ifndef _MSC_VER
 #define _In_
 #endif
 
-class ControlsModel;
 class LrIpcOut;
 class MidiReceiver;
 class Profile;
 namespace rsj {
+   struct DeviceIdentity;
+   struct MidiEvent;
    struct MidiMessage;
    struct MidiMessageId;
 } // namespace rsj
 
 class ProfileManager final : juce::AsyncUpdater {
  public:
-   ProfileManager(ControlsModel& c_model, Profile& profile, std::weak_ptr<LrIpcOut>&& out,
-       MidiReceiver& midi_receiver) noexcept;
+   ProfileManager(
+       Profile& profile, std::weak_ptr<LrIpcOut>&& out, MidiReceiver& midi_receiver) noexcept;
    ~ProfileManager() = default;
    ProfileManager(const ProfileManager& other) = delete;
    ProfileManager(ProfileManager&& other) = delete;
    ProfileManager& operator=(const ProfileManager& other) = delete;
    ProfileManager& operator=(ProfileManager&& other) = delete;
-   template<class T>
-   void AddCallback(
-       _In_ T* const object, _In_ void (T::*const mf)(juce::XmlElement*, const juce::String&))
+   // usage: AddCallback<&Listener::Method>(this)
+   template<auto MemFn, class T> void AddCallback(_In_ T* const object)
    {
       try {
-         using namespace std::placeholders;
-         if (object && mf) // only store non-empty functions
-            callbacks_.emplace_back(std::bind(mf, object, _1, _2));
+         callbacks_.Add<MemFn>(object);
       }
       catch (const std::exception& e) {
          rsj::ExceptionResponse(typeid(this).name(), __func__, e);
@@ -84,8 +84,9 @@ class ProfileManager final : juce::AsyncUpdater {
    // AsyncUpdate interface
    void handleAsyncUpdate() override;
 
-   void MidiCmdCallback(rsj::MidiMessage);
-   void MapCommand(const rsj::MidiMessageId& msg);
+   void MidiCmdCallback(gsl::span<const rsj::MidiEvent> events);
+   void SlotCallback(size_t slot, const rsj::DeviceIdentity& identity);
+   void MapCommand(const std::string& cmd);
 
    enum class SwitchState {
       kNone,
@@ -94,11 +95,10 @@ class ProfileManager final : juce::AsyncUpdater {
    };
 
    Profile& current_profile_;
-   ControlsModel& controls_model_;
    int current_profile_index_{0};
    juce::File profile_location_;
    std::vector<juce::String> profiles_;
-   std::vector<std::function<void(juce::XmlElement*, const juce::String&)>> callbacks_;
+   rsj::ListenerRegistry<void(juce::XmlElement*, const juce::String&)> callbacks_;
    std::weak_ptr<LrIpcOut> lr_ipc_out_;
    SwitchState switch_state_{SwitchState::kNone};
    void ConnectionCallback(bool, bool);
@@ -0,0 +1,452 @@
+/*
+==============================================================================
+
+Reactor.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "Reactor.h"
+
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <cerrno>
+#include <poll.h>
+#endif
+
+#include <gsl/gsl>
+#include "Misc.h"
+
+namespace {
+   constexpr auto kHost{"127.0.0.1"};
+   constexpr int kConnectTryTime{100};
+   constexpr int kWakeBuffer{64};
+   constexpr std::chrono::milliseconds kPollFailedPause{1000}; // don't spin on a broken poll
+
+#ifdef _WIN32
+   using PollFd = WSAPOLLFD;
+   int Poll(std::vector<PollFd>& fds, int timeout) noexcept
+   {
+      return WSAPoll(fds.data(), gsl::narrow_cast<ULONG>(fds.size()), timeout);
+   }
+   bool Interrupted() noexcept
+   {
+      return WSAGetLastError() == WSAEINTR;
+   }
+#else
+   using PollFd = pollfd;
+   int Poll(std::vector<PollFd>& fds, int timeout) noexcept
+   {
+      return poll(fds.data(), gsl::narrow_cast<nfds_t>(fds.size()), timeout);
+   }
+   bool Interrupted() noexcept
+   {
+      return errno == EINTR;
+   }
+#endif
+
+   PollFd Readable(int handle) noexcept
+   {
+      PollFd fd{};
+      fd.fd = static_cast<decltype(fd.fd)>(handle);
+      fd.events = POLLIN;
+      return fd;
+   }
+} // namespace
+
+rsj::Reactor::Reactor(Executor& executor)
+{
+   try {
+      if (!wake_.bindToPort(0, kHost))
+         throw std::runtime_error("Reactor unable to bind its wake socket");
+      wake_port_ = wake_.getBoundPort();
+      worker_ = executor.Spawn({"Reactor", ThreadPriority::kElevated},
+          [this](const StopToken& stop) { Run(stop); },
+          [this] {
+             auto lock{std::scoped_lock(mutex_)};
+             Wake();
+          });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+#pragma warning(push)
+#pragma warning(disable : 26447)
+rsj::Reactor::~Reactor()
+{
+   try {
+      worker_.Stop();
+      if (!entries_.empty())
+         rsj::Log(juce::String(entries_.size()) + " watches or timers left in Reactor destructor");
+      wake_.shutdown();
+   }
+   catch (const std::exception& e) {
+      rsj::LogAndAlertError(juce::String("Exception in Reactor Destructor. ") + e.what());
+      std::terminate();
+   }
+}
+#pragma warning(pop)
+
+rsj::Reactor::Token rsj::Reactor::Watch(int handle, std::function<void()> on_ready)
+{
+   try {
+      Expects(handle >= 0);
+      auto lock{std::scoped_lock(mutex_)};
+      const auto token = next_token_++;
+      entries_.emplace(token, Entry{handle, {}, std::move(on_ready)});
+      Wake();
+      return token;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+rsj::Reactor::Token rsj::Reactor::After(
+    std::chrono::milliseconds delay, std::function<void()> on_due)
+{
+   try {
+      auto lock{std::scoped_lock(mutex_)};
+      const auto token = next_token_++;
+      entries_.emplace(token, Entry{-1, Clock::now() + delay, std::move(on_due)});
+      Wake();
+      return token;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::Reactor::Cancel(Token token)
+{
+   try {
+      if (token == 0)
+         return;
+      auto lock{std::unique_lock(mutex_)};
+      if (entries_.erase(token))
+         Wake(); // so the poll drops the handle before its owner closes it
+      if (std::this_thread::get_id() != thread_id_)
+         done_.wait(lock, [this, token] { return running_ != token; });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::Reactor::Wake()
+{
+   // mutex_ held: DatagramSocket::write caches the address it last sent to, so isn't thread safe
+   try {
+      if (std::this_thread::get_id() == thread_id_)
+         return; // polls again before sleeping
+      constexpr char kByte{0};
+      wake_.write(kHost, wake_port_, &kByte, 1);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::Reactor::Run(const StopToken& stop)
+{
+   try {
+      std::vector<PollFd> fds{};
+      std::vector<Token> tokens{}; // for each of fds after the first, which is wake_
+      std::vector<Token> due{};
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         thread_id_ = std::this_thread::get_id();
+      }
+      bool poll_failed_logged{false};
+      while (!stop.StopRequested()) {
+         fds.assign(1, Readable(wake_.getRawSocketHandle()));
+         tokens.clear();
+         auto timeout = -1; // no timers, sleep until a socket or Wake
+         {
+            auto lock{std::scoped_lock(mutex_)};
+            const auto now = Clock::now();
+            for (const auto& [token, entry] : entries_) {
+               if (entry.handle >= 0) {
+                  fds.push_back(Readable(entry.handle));
+                  tokens.push_back(token);
+                  continue;
+               }
+               // rounded up, so a timer is never woken for early
+               const auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+                   std::max(entry.due - now, Clock::duration::zero()));
+               const auto ms = gsl::narrow_cast<int>(std::min<std::chrono::milliseconds::rep>(
+                   wait.count(), std::numeric_limits<int>::max()));
+               timeout = timeout < 0 ? ms : std::min(timeout, ms);
+            }
+         }
+         if (Poll(fds, timeout) < 0) {
+            if (Interrupted())
+               continue;
+            if (!std::exchange(poll_failed_logged, true))
+               rsj::Log("Reactor poll failed");
+            stop.WaitFor(kPollFailedPause);
+            continue;
+         }
+         if (fds.front().revents) {
+            std::array<char, kWakeBuffer> buffer{};
+            while (wake_.waitUntilReady(true, 0) > 0
+                   && wake_.read(buffer.data(), kWakeBuffer, false) > 0) {
+            }
+         }
+         for (std::size_t i = 1; i < fds.size(); ++i)
+            if (fds.at(i).revents) // data, hang up, error or closed handle: the handler reads
+               Call(tokens.at(i - 1));
+         due.clear();
+         {
+            auto lock{std::scoped_lock(mutex_)};
+            const auto now = Clock::now();
+            for (const auto& [token, entry] : entries_)
+               if (entry.handle < 0 && entry.due <= now)
+                  due.push_back(token);
+         }
+         for (const auto token : due)
+            Call(token);
+      }
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::Reactor::Call(Token token)
+{
+   try {
+      std::function<void()> call{};
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         const auto found = entries_.find(token);
+         if (found == entries_.end())
+            return; // cancelled since the poll
+         running_ = token;
+         if (found->second.handle < 0) { // timers are called once
+            call = std::move(found->second.call);
+            entries_.erase(found);
+         }
+         else
+            call = found->second.call;
+      }
+      auto _ = gsl::finally([this] {
+         {
+            auto lock{std::scoped_lock(mutex_)};
+            running_ = 0;
+         }
+         done_.notify_all();
+      });
+      call();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+rsj::ClientSocket::ClientSocket(Reactor& reactor, int port, Handlers handlers)
+    : reactor_{reactor}, port_{port}, handlers_{std::move(handlers)}
+{
+}
+
+#pragma warning(push)
+#pragma warning(disable : 26447)
+rsj::ClientSocket::~ClientSocket()
+{
+   try {
+      Stop();
+   }
+   catch (const std::exception& e) {
+      rsj::LogAndAlertError(juce::String("Exception in ClientSocket Destructor. ") + e.what());
+      std::terminate();
+   }
+}
+#pragma warning(pop)
+
+void rsj::ClientSocket::Start()
+{
+   try {
+      auto lock{std::scoped_lock(mutex_)};
+      if (!stopped_ && !timer_ && !watch_)
+         timer_ = reactor_.After(std::chrono::milliseconds(0), [this] { Attempt(); });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::ClientSocket::Stop()
+{
+   try {
+      Reactor::Token watch{0};
+      Reactor::Token timer{0};
+      Reactor::Token resume{0};
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         stopped_ = true;
+         watch = std::exchange(watch_, 0);
+         timer = std::exchange(timer_, 0);
+         resume = std::exchange(resume_, 0);
+      }
+      // outside mutex_, which the handlers take
+      reactor_.Cancel(watch);
+      reactor_.Cancel(timer);
+      reactor_.Cancel(resume);
+      auto lock{std::scoped_lock(mutex_)};
+      paused_ = false;
+      connected_.store(false, std::memory_order_release);
+      socket_.close();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+int rsj::ClientSocket::Write(const void* data, int size)
+{
+   try {
+      auto lock{std::scoped_lock(mutex_)};
+      if (!connected_.load(std::memory_order_relaxed))
+         return -1;
+      return socket_.write(data, size);
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::ClientSocket::PauseReading()
+{
+   try {
+      auto lock{std::scoped_lock(mutex_)};
+      if (stopped_ || !watch_)
+         return;
+      reactor_.Cancel(std::exchange(watch_, 0)); // reactor thread, so doesn't wait
+      paused_ = true;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::ClientSocket::ResumeReading()
+{
+   try {
+      auto lock{std::scoped_lock(mutex_)};
+      if (stopped_ || !paused_ || resume_)
+         return;
+      resume_ = reactor_.After(std::chrono::milliseconds(0), [this] { Resumed(); });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::ClientSocket::Resumed()
+{
+   try {
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         resume_ = 0; // from here a ResumeReading schedules another try
+         if (stopped_ || !paused_)
+            return;
+      }
+      if (handlers_.resumed && !handlers_.resumed())
+         return;
+      auto lock{std::scoped_lock(mutex_)};
+      if (stopped_ || !paused_)
+         return;
+      paused_ = false;
+      watch_ = reactor_.Watch(socket_.getRawSocketHandle(), [this] { Readable(); });
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::ClientSocket::Attempt()
+{
+   try {
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         if (stopped_)
+            return;
+         if (!socket_.connect(kHost, port_, kConnectTryTime)) {
+            timer_ = reactor_.After(retry_, [this] { Attempt(); });
+            retry_ = std::min(retry_ * 2, kLongestRetry);
+            return;
+         }
+         retry_ = kFirstRetry;
+         connected_.store(true, std::memory_order_release);
+         watch_ = reactor_.Watch(socket_.getRawSocketHandle(), [this] { Readable(); });
+      }
+      if (handlers_.connected)
+         handlers_.connected();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void rsj::ClientSocket::Readable()
+{
+   try {
+      // only Stop and this thread close the socket, and Stop waits for us first
+      if (handlers_.readable(socket_))
+         return;
+      {
+         auto lock{std::scoped_lock(mutex_)};
+         if (stopped_)
+            return;
+         reactor_.Cancel(std::exchange(watch_, 0));
+         paused_ = false;
+         connected_.store(false, std::memory_order_release);
+         socket_.close();
+         timer_ = reactor_.After(retry_, [this] { Attempt(); });
+         retry_ = std::min(retry_ * 2, kLongestRetry);
+      }
+      if (handlers_.lost)
+         handlers_.lost();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
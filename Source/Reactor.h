@@ -0,0 +1,138 @@
+#ifndef MIDI2LR_REACTOR_H_INCLUDED
+#define MIDI2LR_REACTOR_H_INCLUDED
+/*
+==============================================================================
+
+Reactor.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <JuceLibraryCode/JuceHeader.h>
+#include "Executor.h"
+
+// One thread that waits, in a single poll call, for every socket the program reads and for the
+// next timer, so an idle program sleeps there until something arrives instead of waking to
+// check. Handlers run on that thread and should return quickly; anything slow belongs on a
+// queue for a thread of its own.
+namespace rsj {
+   class Reactor {
+    public:
+      using Token = std::uint64_t; // names a watch or timer, never reused
+      explicit Reactor(Executor& executor);
+      ~Reactor();
+      Reactor(const Reactor& other) = delete;
+      Reactor(Reactor&& other) = delete;
+      Reactor& operator=(const Reactor& other) = delete;
+      Reactor& operator=(Reactor&& other) = delete;
+      // calls on_ready each time the socket has data or has been closed by the other end, until
+      // cancelled. handle is from getRawSocketHandle, or off Windows any descriptor poll takes,
+      // and must stay open until then
+      Token Watch(int handle, std::function<void()> on_ready);
+      // calls on_due once, after delay
+      Token After(std::chrono::milliseconds delay, std::function<void()> on_due);
+      // once this returns the function isn't running, unless called from it, and won't be
+      // called again. Unknown or finished tokens are ignored
+      void Cancel(Token token);
+
+    private:
+      using Clock = std::chrono::steady_clock;
+      struct Entry {
+         int handle{-1}; // -1 for a timer
+         Clock::time_point due{};
+         std::function<void()> call;
+      };
+      void Run(const StopToken& stop);
+      void Call(Token token);
+      void Wake();
+      std::mutex mutex_{};
+      std::condition_variable done_{}; // a call finished
+      std::map<Token, Entry> entries_{};
+      Token next_token_{1};
+      Token running_{0}; // the token being called, 0 if none
+      std::thread::id thread_id_{};
+      juce::DatagramSocket wake_{false}; // a datagram to ourselves ends the poll
+      int wake_port_{0};
+      Worker worker_{}; // last, so the thread stops before the rest goes
+   };
+
+   // a connection to a port on this machine, such as the Lightroom plugin's, that the reactor
+   // opens and, once lost, opens again. A failed attempt is retried after kFirstRetry, each
+   // further failure doubling the wait up to kLongestRetry, so a missing plugin costs a handful
+   // of wakeups a minute instead of one a second.
+   class ClientSocket {
+    public:
+      struct Handlers {
+         std::function<void()> connected;
+         // reads what's waiting from the socket, false if the connection is done
+         std::function<bool(juce::StreamingSocket&)> readable;
+         std::function<void()> lost;
+         // after ResumeReading, moves on what readable left behind; false to stay paused
+         std::function<bool()> resumed;
+      };
+      ClientSocket(Reactor& reactor, int port, Handlers handlers);
+      ~ClientSocket();
+      ClientSocket(const ClientSocket& other) = delete;
+      ClientSocket(ClientSocket&& other) = delete;
+      ClientSocket& operator=(const ClientSocket& other) = delete;
+      ClientSocket& operator=(ClientSocket&& other) = delete;
+      // first attempt right away
+      void Start();
+      // closes the socket and makes no more attempts. Handlers aren't running once it returns
+      void Stop();
+      [[nodiscard]] bool IsConnected() const noexcept
+      {
+         return connected_.load(std::memory_order_acquire);
+      }
+      // any thread. -1 if not connected
+      int Write(const void* data, int size);
+      // from readable: stops watching the socket, so what the other end sends waits in the
+      // socket's buffers, and then its sends, rather than the reactor waiting for room
+      void PauseReading();
+      // any thread: calls resumed on the reactor thread and, if it returns true, watches the
+      // socket again. Does nothing unless paused
+      void ResumeReading();
+
+    private:
+      void Attempt();
+      void Readable();
+      void Resumed();
+      static constexpr std::chrono::milliseconds kFirstRetry{250};
+      static constexpr std::chrono::milliseconds kLongestRetry{8000};
+      Reactor& reactor_;
+      const int port_;
+      const Handlers handlers_;
+      std::atomic<bool> connected_{false};
+      std::mutex mutex_{}; // socket_ and the rest below
+      juce::StreamingSocket socket_{};
+      std::chrono::milliseconds retry_{kFirstRetry};
+      Reactor::Token watch_{0};
+      Reactor::Token timer_{0}; // the pending or running attempt
+      Reactor::Token resume_{0}; // the pending or running Resumed
+      bool paused_{false};
+      bool stopped_{false};
+   };
+} // namespace rsj
+
+#endif // MIDI2LR_REACTOR_H_INCLUDED
@@ -82,13 +82,20 @@ void SettingsComponent::Init()
       addAndMakeVisible(profile_location_button_);
 
       profile_location_label_.setEditable(false);
-      profile_location_label_.setBounds(kSettingsLeft, 145, kSettingsWidth - 2 * kSettingsLeft, 30);
+      profile_location_label_.setBounds(kSettingsLeft, 145, kSettingsWidth - 2 * kSettingsLeft, 25);
       addToLayout(&profile_location_label_, anchorMidLeft, anchorMidRight);
       profile_location_label_.setColour(juce::Label::textColourId, juce::Colours::darkgrey);
       addAndMakeVisible(profile_location_label_);
       profile_location_label_.setText(
           settings_manager_.GetProfileDirectory(), juce::NotificationType::dontSendNotification);
 
+      learn_per_device_.addListener(this);
+      learn_per_device_.setToggleState(
+          settings_manager_.GetLearnPerDevice(), juce::NotificationType::dontSendNotification);
+      learn_per_device_.setBounds(kSettingsLeft, 170, kSettingsWidth - 2 * kSettingsLeft, 25);
+      addToLayout(&learn_per_device_, anchorMidLeft, anchorMidRight);
+      addAndMakeVisible(learn_per_device_);
+
       ////// ----------------------- auto hide section ------------------------------------
       autohide_group_.setText(juce::translate("Auto hide"));
       autohide_group_.setBounds(0, 200, kSettingsWidth, 100);
@@ -143,6 +150,11 @@ void SettingsComponent::buttonClicked(juce::Button* button)
          settings_manager_.SetPickupEnabled(pickup_state);
          rsj::Log(pickup_state ? "Pickup set to enabled" : "Pickup set to disabled");
       }
+      else if (button == &learn_per_device_) {
+         const auto per_device = learn_per_device_.getToggleState();
+         settings_manager_.SetLearnPerDevice(per_device);
+         rsj::Log(per_device ? "Learning rows per device" : "Learning rows for any device");
+      }
       else if (button == &profile_location_button_) {
          juce::FileChooser chooser{juce::translate("Select Profile Folder"),
              juce::File::getSpecialLocation(juce::File::userDocumentsDirectory), "", true};
@@ -51,6 +51,7 @@ class SettingsComponent final : public juce::Component,
    juce::Slider autohide_setting_;
    juce::TextButton profile_location_button_{juce::translate("Choose Profile Folder")};
    juce::ToggleButton pickup_enabled_{juce::translate("Enable Pickup Mode")};
+   juce::ToggleButton learn_per_device_{juce::translate("Learn rows for their own device only")};
    SettingsManager& settings_manager_;
 };
 
@@ -30,6 +30,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 using namespace std::literals::string_literals;
 namespace {
    constexpr auto kAutoHideSection{"autohide"};
+   constexpr auto kNrpnMsbTimeoutSection{"nrpn_msb_timeout"};
 }
 
 SettingsManager::SettingsManager(
@@ -47,7 +48,7 @@ SettingsManager::SettingsManager(
       if (const auto ptr = lr_ipc_out_.lock())
          // add ourselves as a listener to LR_IPC_OUT so that we can send plugin
          // settings on connection
-         ptr->AddCallback(this, &SettingsManager::ConnectionCallback);
+         ptr->AddCallback<&SettingsManager::ConnectionCallback>(this);
       // set the profile directory
       profile_manager_.SetProfileDirectory(GetProfileDirectory());
    }
@@ -67,6 +68,16 @@ int SettingsManager::GetLastVersionFound() const noexcept
    return properties_file_->getIntValue("LastVersionFound", 0);
 }
 
+bool SettingsManager::GetLearnPerDevice() const noexcept
+{
+   return properties_file_->getBoolValue("learn_per_device", false);
+}
+
+int SettingsManager::GetNrpnMsbTimeout() const noexcept
+{
+   return properties_file_->getIntValue(kNrpnMsbTimeoutSection, 20);
+}
+
 bool SettingsManager::GetPickupEnabled() const noexcept
 {
    return properties_file_->getBoolValue("pickup_enabled", true);
@@ -130,6 +141,30 @@ void SettingsManager::SetLastVersionFound(int version_number)
    }
 }
 
+void SettingsManager::SetLearnPerDevice(bool per_device)
+{
+   try {
+      properties_file_->setValue("learn_per_device", per_device);
+      properties_file_->saveIfNeeded();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
+void SettingsManager::SetNrpnMsbTimeout(int milliseconds)
+{
+   try {
+      properties_file_->setValue(kNrpnMsbTimeoutSection, milliseconds);
+      properties_file_->saveIfNeeded();
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse(typeid(this).name(), __func__, e);
+      throw;
+   }
+}
+
 void SettingsManager::SetPickupEnabled(bool enabled)
 {
    try {
@@ -36,10 +36,16 @@ class SettingsManager final {
    SettingsManager& operator=(SettingsManager&& other) = delete;
    [[nodiscard]] int GetAutoHideTime() const noexcept;
    [[nodiscard]] int GetLastVersionFound() const noexcept;
+   // whether rows learned from MIDI input match only the device they came from
+   [[nodiscard]] bool GetLearnPerDevice() const noexcept;
+   // milliseconds an NRPN data entry MSB waits for its LSB, 0 sends MSBs at once
+   [[nodiscard]] int GetNrpnMsbTimeout() const noexcept;
    [[nodiscard]] bool GetPickupEnabled() const noexcept;
    [[nodiscard]] juce::String GetProfileDirectory() const noexcept;
    void SetAutoHideTime(int new_time);
    void SetLastVersionFound(int version_number);
+   void SetLearnPerDevice(bool per_device);
+   void SetNrpnMsbTimeout(int milliseconds);
    void SetPickupEnabled(bool enabled);
    void SetProfileDirectory(const juce::String& profile_directory);
 
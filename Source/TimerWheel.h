@@ -0,0 +1,148 @@
+#ifndef MIDI2LR_TIMERWHEEL_H_INCLUDED
+#define MIDI2LR_TIMERWHEEL_H_INCLUDED
+/*
+==============================================================================
+
+TimerWheel.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "MidiUtilities.h"
+
+namespace rsj {
+   // Hierarchical timer wheel (Varghese and Lauck). Level 0 has a slot for each of the next
+   // kSlots ticks, and each slot of a level above covers a whole turn of the level below. A timer
+   // is filed in the lowest level whose current turn holds its due tick and moved down a level
+   // when its slot's turn comes, so scheduling and expiry cost the same however many timers are
+   // pending and the owner needs one thread and one wake-up time for all of them. Timers further
+   // out than the wheel reaches wait in the top level and are filed again at each of its steps.
+   // Timers can't be cancelled: owners ignore expiries they no longer want, for example by
+   // carrying a generation count in T. Not thread safe.
+   template<class T, unsigned kSlotBits = 6, unsigned kLevels = 3> class TimerWheel {
+    public:
+      explicit TimerWheel(MidiClock::duration tick = std::chrono::milliseconds(1),
+          MidiTime origin = MidiClock::now()) noexcept
+          : tick_{tick}, origin_{origin}
+      {
+      }
+      // a timer due now or earlier expires on the next Advance
+      void Schedule(MidiTime due, T value)
+      {
+         File({std::max(TickOf(due), current_ + 1), std::move(value)});
+         ++pending_;
+      }
+      // calls on_expired(T&&) for every timer due by now, in order of due tick. on_expired may
+      // schedule more timers.
+      template<class F> void Advance(MidiTime now, F&& on_expired)
+      {
+         const auto target =
+             now < origin_ ? std::uint64_t{0} : static_cast<std::uint64_t>((now - origin_) / tick_);
+         while (current_ < target) {
+            if (pending_ == 0) { // nothing to walk past
+               current_ = target;
+               return;
+            }
+            ++current_;
+            Cascade();
+            expiring_.swap(wheels_.front().at(current_ & kMask));
+            pending_ -= expiring_.size();
+            for (auto& entry : expiring_)
+               on_expired(std::move(entry.value));
+            expiring_.clear();
+         }
+      }
+      [[nodiscard]] bool Empty() const noexcept
+      {
+         return pending_ == 0;
+      }
+      // when Advance may next have something to do: the due time of the earliest timer in this
+      // turn of level 0, or else the start of the next turn, when the level above is moved down
+      [[nodiscard]] std::optional<MidiTime> NextDue() const
+      {
+         if (pending_ == 0)
+            return std::nullopt;
+         auto tick = current_ + 1;
+         for (; (tick & kMask) != 0; ++tick)
+            if (!wheels_.front().at(tick & kMask).empty())
+               break;
+         return origin_ + tick_ * tick;
+      }
+
+    private:
+      static constexpr std::uint64_t kSlots{std::uint64_t{1} << kSlotBits};
+      static constexpr std::uint64_t kMask{kSlots - 1};
+      struct Entry {
+         std::uint64_t tick;
+         T value;
+      };
+      [[nodiscard]] static constexpr std::uint64_t LowBits(unsigned bits) noexcept
+      {
+         return (std::uint64_t{1} << bits) - 1;
+      }
+      [[nodiscard]] std::uint64_t TickOf(MidiTime time) const noexcept
+      {
+         if (time <= origin_)
+            return 0;
+         return static_cast<std::uint64_t>((time - origin_ + tick_ - MidiClock::duration{1})
+                                           / tick_);
+      }
+      void File(Entry&& entry)
+      {
+         for (unsigned level = 0; level < kLevels; ++level) {
+            const auto shift = kSlotBits * (level + 1);
+            if (entry.tick >> shift == current_ >> shift) {
+               wheels_.at(level).at(entry.tick >> (shift - kSlotBits) & kMask).push_back(
+                   std::move(entry));
+               return;
+            }
+         }
+         // beyond the wheel: the top level's next slot, filed again when that slot is moved down
+         constexpr auto kTopShift = kSlotBits * (kLevels - 1);
+         wheels_.back().at(((current_ >> kTopShift) + 1) & kMask).push_back(std::move(entry));
+      }
+      // at the start of a turn of a level, moves the level above's slot for the new turn down,
+      // the highest level first so each level's timers can land in the slot about to be moved
+      void Cascade()
+      {
+         unsigned top{0};
+         while (top + 1 < kLevels && (current_ & LowBits(kSlotBits * (top + 1))) == 0)
+            ++top;
+         for (auto level = top; level > 0; --level) {
+            cascading_.swap(wheels_.at(level).at(current_ >> kSlotBits * level & kMask));
+            for (auto& entry : cascading_)
+               File(std::move(entry));
+            cascading_.clear();
+         }
+      }
+      MidiClock::duration tick_;
+      MidiTime origin_;
+      std::uint64_t current_{0}; // ticks since origin_, everything due by it has expired
+      std::size_t pending_{0};
+      std::array<std::array<std::vector<Entry>, kSlots>, kLevels> wheels_{};
+      std::vector<Entry> expiring_{};
+      std::vector<Entry> cascading_{};
+   };
+} // namespace rsj
+
+#endif // MIDI2LR_TIMERWHEEL_H_INCLUDED
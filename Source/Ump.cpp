@@ -0,0 +1,161 @@
+/*
+==============================================================================
+
+Ump.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include "Ump.h"
+
+#include <exception>
+
+#include "Misc.h"
+
+namespace {
+   constexpr std::uint32_t kMidi1ChannelVoice{0x2};
+   constexpr std::uint32_t kMidi2ChannelVoice{0x4};
+   // MIDI 2.0 status nibbles with no MIDI 1.0 equivalent. Bank and index are the MSB and LSB of
+   // the RPN or NRPN parameter.
+   constexpr short kRegisteredController{0x2};
+   constexpr short kAssignableController{0x3};
+   constexpr std::uint32_t kVelocityMask{0xFFFF0000}; // velocity is the upper half of word two
+} // namespace
+
+std::optional<rsj::UmpMessage> rsj::ParseUmp(gsl::span<const std::uint32_t> packet)
+{
+   try {
+      if (packet.empty() || gsl::narrow_cast<std::size_t>(packet.size()) < UmpWords(packet[0]))
+         return std::nullopt;
+      const auto word = packet[0];
+      const auto type = word >> 28;
+      const auto status = gsl::narrow_cast<short>(word >> 20 & 0xF);
+      const auto byte3 = gsl::narrow_cast<short>(word >> 8 & 0x7F);
+      const auto byte4 = gsl::narrow_cast<short>(word & 0x7F);
+      UmpMessage result{};
+      auto& mm = result.message;
+      mm.channel = gsl::narrow_cast<short>(word >> 16 & 0xF);
+      if (type == kMidi1ChannelVoice) { // same fields as a MIDI 1.0 message
+         result.is_midi1 = true;
+         mm.message_type_byte = status;
+         switch (status) {
+         case kPwFlag:
+            mm.value = byte4 << 7 | byte3;
+            break;
+         case kCcFlag:
+         case kKeyPressureFlag:
+         case kNoteOffFlag:
+         case kNoteOnFlag:
+            mm.number = byte3;
+            mm.value = byte4;
+            break;
+         case kPgmChangeFlag:
+            mm.number = byte3;
+            break;
+         case kChanPressureFlag:
+            mm.value = byte3;
+            break;
+         default:
+            return std::nullopt;
+         }
+         return result;
+      }
+      if (type != kMidi2ChannelVoice)
+         return std::nullopt;
+      result.wide_value = packet[1];
+      switch (status) {
+      case kNoteOffFlag:
+      case kNoteOnFlag:
+         mm.message_type_byte = status;
+         mm.number = byte3;
+         result.wide_value &= kVelocityMask;
+         SetUmpValue(mm, result.wide_value, 7);
+         if (status == kNoteOnFlag && mm.value == 0) { // as in MIDI 1.0, 0 would be a note off
+            mm.value = 1;
+            mm.fraction = 0.0;
+         }
+         break;
+      case kCcFlag:
+         mm.message_type_byte = kCcFlag;
+         mm.number = byte3;
+         SetUmpValue(mm, result.wide_value, 7);
+         break;
+      case kRegisteredController:
+         mm.message_type_byte = kRpnFlag;
+         mm.number = byte3 << 7 | byte4;
+         SetUmpValue(mm, result.wide_value, 14);
+         break;
+      case kAssignableController: // NRPNs are CCs numbered by parameter, as NrpnFilter emits
+         mm.message_type_byte = kCcFlag;
+         mm.number = byte3 << 7 | byte4;
+         SetUmpValue(mm, result.wide_value, 14);
+         break;
+      case kPwFlag:
+         mm.message_type_byte = kPwFlag;
+         SetUmpValue(mm, result.wide_value, 14);
+         break;
+      default:
+         return std::nullopt;
+      }
+      return result;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
+
+void rsj::SetUmpValue(MidiMessage& message, std::uint32_t wide_value, int bits) noexcept
+{
+   const auto shift = 32 - bits;
+   message.value = gsl::narrow_cast<short>(wide_value >> shift);
+   message.fraction = static_cast<double>(wide_value & ((std::uint32_t{1} << shift) - 1))
+                      / static_cast<double>(std::uint64_t{1} << shift);
+}
+
+std::vector<rsj::UmpPacket> rsj::SyntheticUmpStream(
+    int steps, std::chrono::microseconds interval, short channel)
+{
+   try {
+      Expects(steps >= 2);
+      Expects(channel >= 0 && channel < 16);
+      const auto word = [channel](std::uint32_t type, std::uint32_t status, std::uint32_t byte3,
+                            std::uint32_t byte4) noexcept {
+         return type << 28 | status << 20 | static_cast<std::uint32_t>(channel) << 16
+                | (byte3 & 0xFF) << 8 | (byte4 & 0xFF);
+      };
+      std::vector<UmpPacket> stream{};
+      stream.reserve(gsl::narrow_cast<std::size_t>(steps) * 7);
+      for (auto i = 0; i < steps; ++i) {
+         const auto offset = interval * i;
+         const auto wide = gsl::narrow_cast<std::uint32_t>(
+             std::uint64_t{0xFFFFFFFF} * gsl::narrow_cast<std::uint64_t>(i)
+             / gsl::narrow_cast<std::uint64_t>(steps - 1));
+         stream.push_back({offset, {word(kMidi2ChannelVoice, kCcFlag, 16, 0), wide}});
+         stream.push_back({offset, {word(kMidi2ChannelVoice, kPwFlag, 0, 0), wide}});
+         stream.push_back({offset, {word(kMidi2ChannelVoice, kRegisteredController, 0, 1), wide}});
+         stream.push_back({offset, {word(kMidi2ChannelVoice, kAssignableController, 1, 1), wide}});
+         stream.push_back(
+             {offset, {word(kMidi2ChannelVoice, kNoteOnFlag, 60, 0), wide & kVelocityMask}});
+         stream.push_back({offset, {word(kMidi2ChannelVoice, kNoteOffFlag, 60, 0), 0}});
+         stream.push_back({offset, {word(kMidi1ChannelVoice, kCcFlag, 17, wide >> 25)}});
+      }
+      return stream;
+   }
+   catch (const std::exception& e) {
+      rsj::ExceptionResponse("rsj", __func__, e);
+      throw;
+   }
+}
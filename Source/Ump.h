@@ -0,0 +1,74 @@
+#ifndef MIDI2LR_UMP_H_INCLUDED
+#define MIDI2LR_UMP_H_INCLUDED
+/*
+==============================================================================
+
+Ump.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+==============================================================================
+*/
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <gsl/gsl>
+#include "MidiUtilities.h"
+
+// MIDI 2.0 Universal MIDI Packets. A packet is one to four 32-bit words, the message type in the
+// top nibble of the first word gives its length. Only channel voice messages become
+// rsj::MidiMessage:
+//    type 2, MIDI 1.0 channel voice: as from a MIDI 1.0 device, so they still go through NRPN and
+//       14-bit CC assembly
+//    type 4, MIDI 2.0 channel voice: note on and off with 16-bit velocity, and control change,
+//       registered controller (RPN), assignable controller (NRPN) and pitch bend with 32-bit
+//       values. These arrive whole. value gets the resolution the rest of the program works in
+//       (7 bits for notes and CCs, 14 for the others) and fraction keeps the remaining bits.
+// The group is ignored, so all groups share one set of 16 channels. Everything else, including
+// per-note and relative controllers, is skipped.
+namespace rsj {
+   struct UmpPacket {
+      std::chrono::microseconds offset{0}; // from the start of the stream
+      std::array<std::uint32_t, 4> words{};
+   };
+
+   struct UmpMessage {
+      MidiMessage message{};
+      std::uint32_t wide_value{0}; // MIDI 2.0 value scaled to 32 bits, to narrow differently
+      bool is_midi1{false};
+   };
+
+   [[nodiscard]] constexpr std::size_t UmpWords(std::uint32_t first_word) noexcept
+   {
+      constexpr std::array<std::size_t, 16> kWords{1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+      return kWords.at(first_word >> 28);
+   }
+
+   // nullopt if the packet isn't a channel voice message or is shorter than its type needs
+   [[nodiscard]] std::optional<UmpMessage> ParseUmp(gsl::span<const std::uint32_t> packet);
+   // value gets the top bits of wide_value and fraction the rest
+   void SetUmpValue(MidiMessage& message, std::uint32_t wide_value, int bits) noexcept;
+   // a stream to try MIDI 2.0 input without MIDI 2.0 hardware. Each of steps steps, interval
+   // apart, sends on channel: CC 16, pitch bend, RPN 1 and NRPN 129 at the step's point along
+   // their full 32-bit range, note 60 on and off with a 16-bit velocity, and CC 17 as a MIDI 1.0
+   // packet. Needs at least two steps.
+   [[nodiscard]] std::vector<UmpPacket> SyntheticUmpStream(
+       int steps, std::chrono::microseconds interval, short channel = 0);
+} // namespace rsj
+
+#endif // MIDI2LR_UMP_H_INCLUDED